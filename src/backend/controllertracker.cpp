@@ -0,0 +1,97 @@
+#include "controllertracker.h"
+#include <chrono>
+#include <cmath>
+
+void ControllerTracker::setController(int newChannel, int newControl)
+{
+    channel.store(newChannel, std::memory_order_relaxed);
+    control.store(newControl, std::memory_order_relaxed);
+}
+
+bool ControllerTracker::process(const libremidi::message& message)
+{
+    const int cc = control.load(std::memory_order_relaxed);
+    if (cc < 0 || message.size() != 3 || (message[0] & 0xF0) != 0xB0)
+        return false;
+    if ((message[0] & 0x0F) + 1 != channel.load(std::memory_order_relaxed) || message[1] != cc)
+        return false;
+
+    const int64_t now = message.timestamp;
+    const double value = message[2] / 127.0;
+    if (rt.timeNs == 0)
+    {
+        // First value, nothing to smooth from
+        rt.smoothed = value;
+    }
+    else
+    {
+        rt.smoothed = advance(rt, now);
+    }
+    rt.target = value;
+    rt.timeNs = now;
+
+    publish(rt);
+    count.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+// Exponential approach to the last raw value. Being a function of elapsed
+// time, it gives the same curve whether the pedal sends ten or a thousand
+// messages per second, and keeps converging after the pedal stops.
+double ControllerTracker::advance(const State& state, int64_t nanoseconds)
+{
+    const double elapsedMs = double(nanoseconds - state.timeNs) / 1e6;
+    if (elapsedMs <= 0.0)
+        return state.smoothed;
+    const double remaining = std::exp(-elapsedMs / SMOOTHING_MS);
+    return state.target + (state.smoothed - state.target) * remaining;
+}
+
+void ControllerTracker::publish(const State& state)
+{
+    const uint32_t s = sequence.load(std::memory_order_relaxed);
+    sequence.store(s + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    target.store(state.target, std::memory_order_relaxed);
+    smoothed.store(state.smoothed, std::memory_order_relaxed);
+    timeNs.store(state.timeNs, std::memory_order_relaxed);
+
+    sequence.store(s + 2, std::memory_order_release);
+}
+
+ControllerTracker::State ControllerTracker::read() const
+{
+    State state;
+    uint32_t before, after;
+    do
+    {
+        before = sequence.load(std::memory_order_acquire);
+        state.target = target.load(std::memory_order_relaxed);
+        state.smoothed = smoothed.load(std::memory_order_relaxed);
+        state.timeNs = timeNs.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        after = sequence.load(std::memory_order_relaxed);
+    } while (before != after || (before & 1));
+    return state;
+}
+
+double ControllerTracker::valueAt(int64_t nanoseconds) const
+{
+    const State state = read();
+    if (state.timeNs == 0)
+        return 0.0;
+    return advance(state, nanoseconds);
+}
+
+double ControllerTracker::valueNow() const
+{
+    const auto now = std::chrono::steady_clock::now().time_since_epoch();
+    return valueAt(std::chrono::duration_cast<std::chrono::nanoseconds>(now).count());
+}
+
+bool ControllerTracker::isActive() const
+{
+    return control.load(std::memory_order_relaxed) >= 0
+           && timeNs.load(std::memory_order_relaxed) != 0;
+}
@@ -0,0 +1,62 @@
+#ifndef CONTROLLERTRACKER_H
+#define CONTROLLERTRACKER_H
+
+#include <libremidi/message.hpp>
+#include <atomic>
+#include <cstdint>
+
+// Follows one continuous controller (an expression pedal on CC 11 by
+// default). process() runs in the JACK process callback: it consumes the
+// matching control changes and keeps a one-pole smoothed value without
+// emitting anything, so a dense controller stream costs the GUI thread
+// nothing. The GUI reads the latest value once per frame with valueNow().
+class ControllerTracker
+{
+public:
+    // The channel MidiClient listens on until the setting is applied
+    static constexpr int DEFAULT_CHANNEL = 1;
+
+    // channel 1-16, control 0-127; a negative control disables tracking
+    void setController(int channel, int control);
+
+    // Returns true for the control changes it consumes
+    bool process(const libremidi::message& message);
+
+    // Smoothed value in [0, 1], advanced to the given steady clock time
+    double valueAt(int64_t nanoseconds) const;
+    double valueNow() const;
+    bool isActive() const;
+
+    // Control changes consumed since start, for statistics
+    uint64_t received() const { return count.load(std::memory_order_relaxed); }
+
+    static constexpr double SMOOTHING_MS = 30.0;
+
+private:
+    struct State
+    {
+        double target = 0.0;   // Last raw value
+        double smoothed = 0.0; // Smoothed value at timeNs
+        int64_t timeNs = 0;    // 0 until the first message
+    };
+
+    static double advance(const State& state, int64_t nanoseconds);
+    State read() const;
+    void publish(const State& state);
+
+    std::atomic<int> channel{DEFAULT_CHANNEL};
+    std::atomic<int> control{-1};
+
+    // Only touched by the realtime thread
+    State rt;
+
+    // Published copy of rt
+    std::atomic<uint32_t> sequence{0};
+    std::atomic<double> target{0.0};
+    std::atomic<double> smoothed{0.0};
+    std::atomic<int64_t> timeNs{0};
+
+    std::atomic<uint64_t> count{0};
+};
+
+#endif // CONTROLLERTRACKER_H
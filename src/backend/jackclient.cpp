@@ -1,14 +1,17 @@
 #include "jackclient.h"
+#include <utils/metrics.h>
 #include <QDebug>
+#include <algorithm>
+#include <chrono>
+
+// Registered up front, the process callback only bumps them
+static Metrics::Counter& eventsMetric = Metrics::counter("midi.events");
+static Metrics::Counter& overflowMetric = Metrics::counter("midi.pendingOverflows");
+static Metrics::Counter& longEventsMetric = Metrics::counter("midi.longEvents");
+
 JackClient::JackClient(QObject *parent)
-    : QObject{parent}, midiin(nullptr),midiout(nullptr)
+    : QObject{parent}, midiout(nullptr)
 {
-    auto callback = [&](int port, const libremidi::message& message) {
-        // qDebug() << message;
-        emit midiMessageReceived(message);
-        //  midiout[port].send_message(message);
-    };
-
     // Create a JACK client which will be shared across objects
     jack_status_t status{};
     handle.reset(jack_client_open("SpiritSheetPDF", JackNoStartServer, &status));
@@ -33,34 +36,38 @@ JackClient::JackClient(QObject *parent)
 
     // Create an observer using the configuration
     observer = libremidi::observer{conf, libremidi::jack_observer_configuration{.context = handle.get()}};
-    jack_set_process_callback(handle.get(), jack_callback, this);
-    jack_activate(handle.get());
 
+    for (int slot = 0; slot < MAX_INPUTS; ++slot) {
+        auto api_input_config = libremidi::jack_input_configuration{
+            .context = handle.get(),
+            .set_process_func = [this, slot](libremidi::jack_callback cb) {
+                inputs[slot].callback = std::move(cb);
+            }
+        };
 
-    // Create our configuration
-    auto api_input_config = libremidi::jack_input_configuration{
-        .context = handle.get(),
-        .set_process_func = [this](libremidi::jack_callback cb) {
-            midiin_callback = std::move(cb);
-        }
-    };
+        inputs[slot].midiin = std::make_unique<libremidi::midi_in>(
+            libremidi::input_configuration{
+                .on_message = [this, slot](const libremidi::message& msg) { collect(slot, msg); },
+                .ignore_sysex = false,
+                .ignore_timing = false,
+                // Same clock as std::chrono::steady_clock, so the GUI can
+                // extrapolate the beat position between clock ticks, and
+                // events of different inputs can be ordered
+                .timestamps = libremidi::timestamp_mode::SystemMonotonic
+            },
+            api_input_config
+            );
+    }
 
     auto api_output_config = libremidi::jack_output_configuration{
         .context = handle.get(),
         .set_process_func = [this](libremidi::jack_callback cb) {
             midiout_callback = std::move(cb);
-        }
-    };
-
-
-    midiin = std::make_unique<libremidi::midi_in>(
-        libremidi::input_configuration{
-            .on_message = [=](const libremidi::message& msg) { callback(0, msg); },
-            .ignore_sysex = false
         },
-        api_input_config
-        );
-    // midiin->open_virtual_port("Input: 1");
+        // Messages are written straight into the port buffer, from
+        // jack_callback only (see MidiOutputQueue)
+        .direct = true
+    };
 
     midiout = std::make_unique<libremidi::midi_out>(
         libremidi::output_configuration{},
@@ -68,6 +75,13 @@ JackClient::JackClient(QObject *parent)
         );
 
     //  midiout->open_virtual_port("Output: 1");
+
+    // Preallocated so the process callback doesn't
+    dispatched.bytes.reserve(PENDING_BYTES);
+
+    // Only now that every callback above is in place
+    jack_set_process_callback(handle.get(), jack_callback, this);
+    jack_activate(handle.get());
 }
 
 
@@ -75,18 +89,248 @@ int JackClient::jack_callback(jack_nframes_t cnt, void *ctx)
 {
     auto& self = *(JackClient*)ctx;
 
-    // Process the midi input
-    self.midiin_callback.callback(cnt);
-    // Process the midi output
+    // Process the midi inputs, their events are collected and then
+    // dispatched together in timestamp order
+    self.pendingCount = 0;
+    for (Input& input : self.inputs) {
+        if (input.callback.callback)
+            input.callback.callback(cnt);
+    }
+    self.dispatchPending();
+
+    // Send what the GUI queued; a message waiting longer than two periods
+    // missed the cycle it was meant for. Without an open output it is
+    // dropped: stale bank and program changes mustn't all go out at once
+    // when a port opens later.
+    if (!self.midiout || !self.midiout->is_port_open() || !self.midiout_callback.callback) {
+        self.output.discard();
+        return 0;
+    }
+    // Prepares the output port buffer for the period
     self.midiout_callback.callback(cnt);
+
+    const auto now = std::chrono::steady_clock::now().time_since_epoch();
+    const int64_t periodNs = int64_t(cnt) * 1000000000 / jack_get_sample_rate(self.handle.get());
+    self.output.drain(*self.midiout,
+                      std::chrono::duration_cast<std::chrono::nanoseconds>(now).count(),
+                      2 * periodNs);
     return 0;
 }
-void JackClient::sendMidiMessage(int port, const libremidi::message& message)
+
+bool JackClient::accepts(const Input& input, const libremidi::message& message)
+{
+    const uint8_t status = message[0];
+    uint32_t type;
+    if (status == 0xF0)
+        type = SysEx;
+    else if (status >= 0xF8)
+        type = Realtime;
+    else if (status >= 0xF0)
+        type = OtherChannel; // System common, rare enough to go with it
+    else {
+        switch (status & 0xF0) {
+        case 0x80: case 0x90: case 0xA0: type = Notes; break;
+        case 0xB0: type = ControlChanges; break;
+        case 0xC0: type = ProgramChanges; break;
+        default: type = OtherChannel; break;
+        }
+        const uint32_t channel = 1u << (status & 0x0F);
+        if (!(input.channelMask.load(std::memory_order_relaxed) & channel))
+            return false;
+    }
+    return input.typeMask.load(std::memory_order_relaxed) & type;
+}
+
+// Called from the inputs' process callbacks, a message at a time. Each
+// input delivers in order, so a new event almost always belongs at the end
+// and the insertion below stays constant time per message however many
+// inputs are open.
+void JackClient::collect(int slot, const libremidi::message& message)
+{
+    Input& input = inputs[slot];
+    input.received.fetch_add(1, std::memory_order_relaxed);
+    eventsMetric.add();
+    if (message.empty() || !accepts(input, message)) {
+        input.filtered.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    if (pendingCount == MAX_PENDING) {
+        // Extremely dense period, keep going in arrival order
+        overflowMetric.add();
+        dispatch(message);
+        return;
+    }
+    if (message.size() > PENDING_BYTES) {
+        // Long SysEx doesn't fit inline; it goes out as it arrives, ahead
+        // of the period's other events, rather than be copied
+        longEventsMetric.add();
+        dispatch(message);
+        return;
+    }
+
+    const int index = pendingCount++;
+    PendingEvent& event = pending[index];
+    event.size = uint16_t(message.size());
+    std::copy(message.bytes.begin(), message.bytes.end(), event.bytes);
+    event.timestamp = message.timestamp;
+
+    int at = index;
+    while (at > 0 && pending[pendingOrder[at - 1]].timestamp > message.timestamp) {
+        pendingOrder[at] = pendingOrder[at - 1];
+        --at;
+    }
+    pendingOrder[at] = uint16_t(index);
+    if (at != index)
+        reordered.fetch_add(1, std::memory_order_relaxed);
+}
+
+void JackClient::dispatchPending()
+{
+    for (int i = 0; i < pendingCount; ++i) {
+        const PendingEvent& event = pending[pendingOrder[i]];
+        // Within the reserved capacity, no allocation
+        dispatched.bytes.assign(event.bytes, event.bytes + event.size);
+        dispatched.timestamp = event.timestamp;
+        dispatch(dispatched);
+    }
+    pendingCount = 0;
+}
+
+void JackClient::dispatch(const libremidi::message& message)
+{
+    // qDebug() << message;
+    monitor.push(message);
+    // Clock, transport and the expression controller stay on the
+    // realtime thread, the GUI polls them once per frame
+    if (tempo.process(message) || expression.process(message))
+        return;
+    // Everything else is only for the monitor, which reads the ring
+    if (isPageControl(message))
+        emit midiMessageReceived(message);
+}
+
+bool JackClient::isPageControl(const libremidi::message& message) const
 {
-    midiout->send_message(message);
+    if (message.size() != 3 || (message[0] & 0xF0) != 0xB0
+        || (message[0] & 0x0F) + 1 != pageChannel.load(std::memory_order_relaxed))
+        return false;
+    return message[1] == nextPageControl.load(std::memory_order_relaxed)
+        || message[1] == prevPageControl.load(std::memory_order_relaxed);
+}
+
+void JackClient::setPageControls(int channel, int nextControl, int prevControl)
+{
+    pageChannel.store(channel, std::memory_order_relaxed);
+    nextPageControl.store(nextControl, std::memory_order_relaxed);
+    prevPageControl.store(prevControl, std::memory_order_relaxed);
+}
+
+int JackClient::openInput(const libremidi::input_port& port)
+{
+    const QString name = QString::fromStdString(port.port_name);
+    int freeSlot = -1;
+    for (int slot = 0; slot < MAX_INPUTS; ++slot) {
+        if (isInputOpen(slot)) {
+            if (inputs[slot].name == name)
+                return slot;
+        } else if (freeSlot < 0) {
+            freeSlot = slot;
+        }
+    }
+    if (freeSlot < 0)
+        return -1;
+
+    Input& input = inputs[freeSlot];
+    input.typeMask.store(AllTypes, std::memory_order_relaxed);
+    input.channelMask.store(ALL_CHANNELS, std::memory_order_relaxed);
+    input.received.store(0, std::memory_order_relaxed);
+    input.filtered.store(0, std::memory_order_relaxed);
+    input.midiin->open_port(port, QStringLiteral("In %1").arg(freeSlot + 1).toStdString());
+    input.name = name;
+    return freeSlot;
+}
+
+void JackClient::closeInput(int slot)
+{
+    if (slot < 0 || slot >= MAX_INPUTS)
+        return;
+    inputs[slot].midiin->close_port();
+    inputs[slot].name.clear();
+}
+
+void JackClient::closeAllInputs()
+{
+    for (int slot = 0; slot < MAX_INPUTS; ++slot)
+        closeInput(slot);
+}
+
+bool JackClient::isInputOpen(int slot) const
+{
+    return slot >= 0 && slot < MAX_INPUTS && inputs[slot].midiin->is_port_open();
+}
+
+bool JackClient::isInputConnected(int slot) const
+{
+    return slot >= 0 && slot < MAX_INPUTS && inputs[slot].midiin->is_port_connected();
+}
+
+QString JackClient::inputName(int slot) const
+{
+    return isInputOpen(slot) ? inputs[slot].name : QString();
+}
+
+int JackClient::connectedInputCount() const
+{
+    int count = 0;
+    for (int slot = 0; slot < MAX_INPUTS; ++slot)
+        count += isInputConnected(slot);
+    return count;
+}
+
+void JackClient::setInputFilter(int slot, uint32_t typeMask, uint32_t channelMask)
+{
+    if (slot < 0 || slot >= MAX_INPUTS)
+        return;
+    inputs[slot].typeMask.store(typeMask, std::memory_order_relaxed);
+    inputs[slot].channelMask.store(channelMask, std::memory_order_relaxed);
+}
+
+uint32_t JackClient::inputTypeFilter(int slot) const
+{
+    if (slot < 0 || slot >= MAX_INPUTS)
+        return 0;
+    return inputs[slot].typeMask.load(std::memory_order_relaxed);
+}
+
+JackClient::InputStats JackClient::inputStats(int slot) const
+{
+    if (slot < 0 || slot >= MAX_INPUTS)
+        return {};
+    return {inputs[slot].received.load(std::memory_order_relaxed),
+            inputs[slot].filtered.load(std::memory_order_relaxed)};
+}
+
+bool JackClient::sendMidiMessage(int port, const libremidi::message& message)
+{
+    if (output.pushBytes(message.bytes.data(), message.size()))
+        return true;
+    if (message.size() > MidiOutputQueue::LONG_BYTES)
+        qWarning() << "MIDI message of" << message.size() << "bytes is longer than the output queue allows, dropped";
+    else
+        qWarning() << "MIDI output queue full, dropped a message of" << message.size() << "bytes";
+    return false;
 }
 void JackClient::send_MidiMessage(const libremidi::message message)
 {
-    midiout->send_message(message);
+    sendMidiMessage(0, message);
+}
+bool JackClient::sendMidiBatch(const MidiOutputQueue::Message* messages, size_t count)
+{
+    if (!output.push(messages, count)) {
+        qWarning() << "MIDI output queue full, dropped a batch of" << count << "messages";
+        return false;
+    }
+    return true;
 }
 
@@ -2,37 +2,136 @@
 #define JACKCLIENT_H
 
 #include <QObject>
+#include <QString>
 #include <libremidi/configurations.hpp>
 #include <libremidi/detail/memory.hpp>
 #include <libremidi/libremidi.hpp>
 #include <libremidi/message.hpp>
 #include <jack/jack.h>
+#include <backend/tempotracker.h>
+#include <backend/controllertracker.h>
+#include <backend/midioutputqueue.h>
+#include <backend/midieventring.h>
+#include <array>
+#include <atomic>
 
 
 class JackClient : public QObject
 {
     Q_OBJECT
 public:
+    // Kinds of messages an input lets through, see setInputFilter()
+    enum MessageType {
+        Notes = 0x01,           // Note on/off, polyphonic aftertouch
+        ControlChanges = 0x02,
+        ProgramChanges = 0x04,
+        OtherChannel = 0x08,    // Channel pressure, pitch bend
+        Realtime = 0x10,        // Clock, start/stop, active sensing
+        SysEx = 0x20,
+        AllTypes = 0x3F
+    };
+    static constexpr int MAX_INPUTS = 8;
+    static constexpr uint32_t ALL_CHANNELS = 0xFFFF;
+
+    struct InputStats
+    {
+        uint64_t received = 0;
+        uint64_t filtered = 0;
+    };
+
     explicit JackClient(QObject *parent = nullptr);
     static int jack_callback(jack_nframes_t cnt, void* ctx);
     std::optional<libremidi::observer> observer;
 
-    std::unique_ptr<libremidi::midi_in> midiin;
     std::unique_ptr<libremidi::midi_out> midiout;
 
+    // Inputs are opened side by side in fixed slots, their events are
+    // merged by timestamp in the process callback. Returns the slot, or -1
+    // when all of them are in use; throws like libremidi::midi_in::open_port
+    int openInput(const libremidi::input_port& port);
+    void closeInput(int slot);
+    void closeAllInputs();
+    bool isInputOpen(int slot) const;
+    bool isInputConnected(int slot) const;
+    QString inputName(int slot) const;
+    int connectedInputCount() const;
+
+    // typeMask of MessageType, channelMask bit n for channel n + 1
+    void setInputFilter(int slot, uint32_t typeMask, uint32_t channelMask = ALL_CHANNELS);
+    uint32_t inputTypeFilter(int slot) const;
+    InputStats inputStats(int slot) const;
+    // Events that arrived out of timestamp order across inputs in a period
+    uint64_t reorderedCount() const { return reordered.load(std::memory_order_relaxed); }
+    // The only messages that reach the GUI thread one by one: control
+    // changes on channel (1-16) with one of the page turn controls
+    void setPageControls(int channel, int nextControl, int prevControl);
+
+    // Fed with MIDI clock from the JACK process callback
+    TempoTracker tempo;
+    // Continuous controller used for expression pedal scrolling
+    ControllerTracker expression;
+    // Outgoing messages, sent from the JACK process callback
+    MidiOutputQueue output;
+    // Copy of the incoming channel messages for the MIDI monitor, pedal
+    // included, recorded only while the monitor is shown
+    MidiEventRing monitor;
+
 signals:
+    // Page turn control changes only, see setPageControls
     void midiMessageReceived(const libremidi::message& message);
 public slots:
-    void sendMidiMessage(int port, const libremidi::message& message);
+    // False, with a warning, if it was dropped
+    bool sendMidiMessage(int port, const libremidi::message& message);
     void send_MidiMessage(const libremidi::message message);
+    // Delivered contiguously within one JACK period
+    bool sendMidiBatch(const MidiOutputQueue::Message* messages, size_t count);
 private:
+    struct Input
+    {
+        std::unique_ptr<libremidi::midi_in> midiin;
+        libremidi::jack_callback callback;
+        QString name; // GUI thread only
+
+        std::atomic<uint32_t> typeMask{AllTypes};
+        std::atomic<uint32_t> channelMask{ALL_CHANNELS};
+        std::atomic<uint64_t> received{0};
+        std::atomic<uint64_t> filtered{0};
+    };
+
+    static constexpr int MAX_PENDING = 256;
+    static constexpr size_t PENDING_BYTES = 64; // Stored inline per event
+
+    struct PendingEvent
+    {
+        int64_t timestamp = 0;
+        uint16_t size = 0;
+        uint8_t bytes[PENDING_BYTES];
+    };
+
+    void collect(int slot, const libremidi::message& message);
+    void dispatchPending();
+    void dispatch(const libremidi::message& message);
+    static bool accepts(const Input& input, const libremidi::message& message);
+    bool isPageControl(const libremidi::message& message) const;
+
     libremidi::unique_handle<jack_client_t, jack_client_close> handle;
 
-    libremidi::jack_callback midiin_callback;
+    std::array<Input, MAX_INPUTS> inputs;
     libremidi::jack_callback midiout_callback;
 
+    // Events of one period, dispatched in timestamp order once every input
+    // has been read. Only touched by the realtime thread.
+    std::array<PendingEvent, MAX_PENDING> pending;
+    // Reused to dispatch a pending event, reserved to PENDING_BYTES up front
+    libremidi::message dispatched;
+    std::array<uint16_t, MAX_PENDING> pendingOrder;
+    int pendingCount = 0;
 
+    std::atomic<uint64_t> reordered{0};
 
+    std::atomic<int> pageChannel{ControllerTracker::DEFAULT_CHANNEL};
+    std::atomic<int> nextPageControl{-1};
+    std::atomic<int> prevPageControl{-1};
 };
 
 #endif // JACKCLIENT_H
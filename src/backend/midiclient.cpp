@@ -1,31 +1,120 @@
 #include "midiclient.h"
+#include <array>
 
 MidiClient::MidiClient(QObject *parent)
     : QObject(parent)
     , m_bankNumber(0)
     , m_inputPorts(new MidiPortModel(this))    // Initialize here
     , m_outputPorts(new MidiPortModel(this))   // Initialize here
+    , m_monitor(new MidiMonitor(this))
 {
-    jackClient = new JackClient;
-    connect(jackClient, &JackClient::midiMessageReceived, this, &MidiClient::handleMidiMessage);
-    getIOPorts();
+    m_startupTimer.start();
+
+    m_retryTimer = new QTimer(this);
+    m_retryTimer->setSingleShot(true);
+    connect(m_retryTimer, &QTimer::timeout, this, &MidiClient::start);
+
     QTimer *connectionCheckTimer = new QTimer(this);
     connect(connectionCheckTimer, &QTimer::timeout, this, &MidiClient::checkOutputPortConnection);
     connectionCheckTimer->start(1000); // Check every second
 
+    QTimer *clockCheckTimer = new QTimer(this);
+    connect(clockCheckTimer, &QTimer::timeout, this, &MidiClient::checkClock);
+    clockCheckTimer->start(250);
+
+}
+
+MidiClient::~MidiClient()
+{
+    if (m_initThread)
+        m_initThread->wait();
+    m_monitor->setSource(nullptr);
+    delete jackClient;
+}
+
+void MidiClient::start()
+{
+    if (jackClient || m_initThread)
+        return;
+
+    m_retryTimer->stop();
+    ++m_initAttempts;
+    if (m_midiState != Starting) {
+        m_midiState = Starting;
+        emit midiStateChanged();
+    }
+
+    // jack_client_open, port creation and activation take a while and can
+    // fail, none of it needs the GUI thread
+    QThread *guiThread = thread();
+    m_initThread = QThread::create([this, guiThread] {
+        QElapsedTimer timer;
+        timer.start();
+        JackClient *client = nullptr;
+        QString message;
+        try {
+            client = new JackClient;
+            client->moveToThread(guiThread);
+        } catch (const std::exception& e) {
+            message = QString::fromUtf8(e.what());
+        }
+        const qint64 elapsedMs = timer.elapsed();
+        QMetaObject::invokeMethod(this, [this, client, message, elapsedMs] {
+            jackStarted(client, message, elapsedMs);
+        }, Qt::QueuedConnection);
+    });
+    connect(m_initThread, &QThread::finished, m_initThread, &QObject::deleteLater);
+    m_initThread->start();
+}
+
+void MidiClient::jackStarted(JackClient *client, const QString &message, qint64 elapsedMs)
+{
+    m_lastAttemptMs = elapsedMs;
+
+    if (!client) {
+        // Nothing tells us when the server comes up, keep polling, less
+        // and less often
+        const int delay = qMin(RETRY_MAX_MS, RETRY_MIN_MS << qMin(m_initAttempts - 1, 4));
+        qWarning() << "MIDI unavailable:" << message << "- retrying in" << delay << "ms";
+        m_midiError = message;
+        m_midiState = Failed;
+        emit midiStateChanged();
+        m_retryTimer->start(delay);
+        return;
+    }
+
+    jackClient = client;
+    connect(jackClient, &JackClient::midiMessageReceived, this, &MidiClient::handleMidiMessage);
+    applyControllers();
+    m_monitor->setSource(&jackClient->monitor);
+    getIOPorts();
+
+    m_readyAfterMs = m_startupTimer.elapsed();
+    qDebug() << "MIDI ready" << m_readyAfterMs << "ms after startup, JACK client opened in"
+             << elapsedMs << "ms, attempt" << m_initAttempts;
+    m_midiError.clear();
+    m_midiState = Ready;
+    emit midiStateChanged();
+    emit connectionStatusChanged();
+}
+
+QVariantMap MidiClient::startupStats() const
+{
+    QVariantMap stats;
+    stats["state"] = m_midiState;
+    stats["attempts"] = m_initAttempts;
+    stats["lastAttemptMs"] = m_lastAttemptMs;
+    stats["readyAfterMs"] = m_readyAfterMs;
+    return stats;
 }
 void MidiClient::handleMidiMessage(const libremidi::message& message)
 {
-    qDebug() << "MIDI Control received";
+    // Only page turn controls get here, JackClient keeps the rest on the
+    // JACK thread and the monitor reads them from its ring
     if (!message.empty()) {
-        qDebug() << "MIDI Control received 1 ";
         int statusByte = message[0];
         int channel = statusByte & 0x0F; // Mask the lowest 4 bits
 
-        // Emit the MIDI message for monitoring
-        if (message.size() >= 3) {
-            emit midiMessageReceived(channel + 1 , message[1], message[2]);
-        }
         // Check if message is on our configured MIDI channel
         if (channel + 1  == m_midiChannel) {
 
@@ -55,29 +144,48 @@ bool MidiClient::itsNote(const libremidi::message& message)
 }
 void MidiClient::sendControlChange(int channel, int control, int value)
 {
-    jackClient->sendMidiMessage(0, libremidi::channel_events::control_change(channel, control, value));
+    if (!jackClient)
+        return;
+    const auto message = MidiOutputQueue::Message::controlChange(channel, control, value);
+    jackClient->sendMidiBatch(&message, 1);
 }
 
 
 void MidiClient::sendRawMessage(const libremidi::message& message)
 {
-    jackClient->sendMidiMessage(0, message);
+    if (!jackClient)
+        return;
+    if (!jackClient->sendMidiMessage(0, message))
+        emit outputMessageDropped(int(message.size()));
 }
 
 
 void MidiClient::sendAllNotesOff()
 {
-    // Send the "All Notes Off" message for the specified channel
+    if (!jackClient)
+        return;
+
+    // Send the "All Notes Off" message on every channel, in the same period
+    std::array<MidiOutputQueue::Message, 16> messages;
     for(int i=1;i<=16;i++){
-        jackClient->sendMidiMessage(0, libremidi::channel_events::control_change(i, 123, 0));    }
+        messages[i - 1] = MidiOutputQueue::Message::controlChange(i, 123, 0);
+    }
+    jackClient->sendMidiBatch(messages.data(), messages.size());
 }
 void MidiClient::sendNotesOff(int channel)
 {
+    if (!jackClient)
+        return;
+
     // Send the "Notes Off" message for the specified channel
-    jackClient->sendMidiMessage(0, libremidi::channel_events::control_change(channel+1, 123, 0));
+    const auto message = MidiOutputQueue::Message::controlChange(channel+1, 123, 0);
+    jackClient->sendMidiBatch(&message, 1);
 }
 void MidiClient::sendMsbLsbPc(int channel, int msb, int lsb, int pc)
 {
+    if (!jackClient)
+        return;
+
     // Ensure the channel is in the valid range (1-16 in MIDI, but 0-15 in some APIs)
     if (channel < 0 || (channel > 15))
         return;
@@ -88,14 +196,20 @@ void MidiClient::sendMsbLsbPc(int channel, int msb, int lsb, int pc)
     pc = qBound(0, pc, 127);
 
 
-    // Send the MSB, LSB, and PC messages
-    jackClient->sendMidiMessage(0, libremidi::channel_events::control_change(channel+1, 0x00, msb));  // MSB (0x00)
-    jackClient->sendMidiMessage(0, libremidi::channel_events::control_change(channel+1, 0x20, lsb));  // LSB (0x20)
-    jackClient->sendMidiMessage(0, libremidi::channel_events::program_change(channel+1, pc));         // PC
+    // Send the MSB, LSB, and PC messages as one batch, so the program change
+    // can't reach the instrument in a later period than its bank select
+    const std::array<MidiOutputQueue::Message, 3> messages{
+        MidiOutputQueue::Message::controlChange(channel+1, 0x00, msb),  // MSB (0x00)
+        MidiOutputQueue::Message::controlChange(channel+1, 0x20, lsb),  // LSB (0x20)
+        MidiOutputQueue::Message::programChange(channel+1, pc)          // PC
+    };
+    jackClient->sendMidiBatch(messages.data(), messages.size());
     qDebug() << "Sent MSB:" << msb << "LSB:" << lsb << "PC:" << pc<< "on channel:" << channel;
 }
 
 void MidiClient::getIOPorts() {
+    if (!jackClient)
+        return;
     if (jackClient->observer.has_value()) {
         qDebug() << "Clearing input ports";
         m_inputPorts->clear();
@@ -111,18 +225,20 @@ void MidiClient::getIOPorts() {
 
 
 void MidiClient::makeConnection(QVariant inputPort, QVariant outputPort) {
+    if (!jackClient) {
+        qWarning() << "MIDI isn't ready, can't connect";
+        return;
+    }
     try {
-        // Close any existing connections first
-        if (jackClient->midiin) {
-            jackClient->midiin->close_port();
-        }
-
-        // Connect to the input port if provided
+        // Connect to the input port if provided, next to the ones already open
         if (inputPort.isValid() && inputPort.canConvert<libremidi::input_port>()) {
             try {
                 libremidi::input_port selectedInputPort = inputPort.value<libremidi::input_port>();
-                jackClient->midiin->open_port(selectedInputPort, "In");
-                qDebug() << "Input port connected successfully";
+                const int slot = jackClient->openInput(selectedInputPort);
+                if (slot < 0)
+                    qWarning() << "All" << JackClient::MAX_INPUTS << "MIDI inputs are in use";
+                else
+                    qDebug() << "Input port connected successfully on input" << slot + 1;
             } catch (const std::exception& e) {
                 qWarning() << "Error connecting to input port:" << e.what();
             }
@@ -137,14 +253,47 @@ void MidiClient::makeConnection(QVariant inputPort, QVariant outputPort) {
 }
 
 void MidiClient::makeDisconnect() {
-    if (jackClient->midiin) {
-        jackClient->midiin->close_port();
-    }
+    if (!jackClient)
+        return;
+    jackClient->closeAllInputs();
 
     // Handle case when no port is selected
     emit connectionStatusChanged();  // Use the new signal name
     qDebug() << "Disconnected";
 }
+void MidiClient::disconnectInput(int slot) {
+    if (!jackClient)
+        return;
+    jackClient->closeInput(slot);
+    emit connectionStatusChanged();
+}
+
+void MidiClient::setInputFilter(int slot, int types, int channels) {
+    if (!jackClient)
+        return;
+    jackClient->setInputFilter(slot, uint32_t(types), uint32_t(channels));
+}
+
+QVariantList MidiClient::inputStats() const {
+    QVariantList result;
+    if (!jackClient)
+        return result;
+    for (int slot = 0; slot < JackClient::MAX_INPUTS; ++slot) {
+        if (!jackClient->isInputOpen(slot))
+            continue;
+        const JackClient::InputStats stats = jackClient->inputStats(slot);
+        QVariantMap input;
+        input["slot"] = slot;
+        input["name"] = jackClient->inputName(slot);
+        input["connected"] = jackClient->isInputConnected(slot);
+        input["types"] = int(jackClient->inputTypeFilter(slot));
+        input["received"] = qulonglong(stats.received);
+        input["filtered"] = qulonglong(stats.filtered);
+        result.append(input);
+    }
+    return result;
+}
+
 void MidiClient::checkOutputPortConnection() {
     // Rename this to checkConnectionStatus()
     bool currentInputStatus = isInputPortConnected();
@@ -160,6 +309,70 @@ void MidiClient::checkOutputPortConnection() {
     }
 }
 
+void MidiClient::checkClock() {
+    if (!jackClient)
+        return;
+
+    // Tempo display only, scrolling reads clockBeats() every frame
+    const double currentTempo = qRound(jackClient->tempo.bpm() * 10) / 10.0;
+    const bool currentRunning = jackClient->tempo.isRunning();
+
+    if (currentTempo != m_tempo || currentRunning != m_clockRunning) {
+        m_tempo = currentTempo;
+        m_clockRunning = currentRunning;
+        emit clockChanged();
+    }
+}
+
+double MidiClient::clockBeats() const {
+    if (!jackClient)
+        return 0.0;
+    return jackClient->tempo.beatsNow();
+}
+
+double MidiClient::expressionValue() const {
+    if (!jackClient)
+        return 0.0;
+    return jackClient->expression.valueNow();
+}
+
+QVariantMap MidiClient::expressionStats() const {
+    QVariantMap stats;
+    if (!jackClient)
+        return stats;
+    stats["control"] = m_expressionControl;
+    stats["active"] = jackClient->expression.isActive();
+    stats["value"] = jackClient->expression.valueNow();
+    stats["received"] = qulonglong(jackClient->expression.received());
+    return stats;
+}
+
+QVariantMap MidiClient::outputStats() const {
+    QVariantMap stats;
+    if (!jackClient)
+        return stats;
+    stats["queueDepth"] = qulonglong(jackClient->output.depth());
+    stats["peakQueueDepth"] = qulonglong(jackClient->output.peakDepth());
+    stats["sent"] = qulonglong(jackClient->output.sentCount());
+    stats["late"] = qulonglong(jackClient->output.lateCount());
+    stats["dropped"] = qulonglong(jackClient->output.droppedCount());
+    stats["oversized"] = qulonglong(jackClient->output.oversizedCount());
+    stats["maxLatencyMs"] = jackClient->output.maxLatencyMs();
+    return stats;
+}
+
+QVariantMap MidiClient::clockStats() const {
+    QVariantMap stats;
+    if (!jackClient)
+        return stats;
+    stats["tempo"] = jackClient->tempo.bpm();
+    stats["running"] = jackClient->tempo.isRunning();
+    stats["beats"] = jackClient->tempo.beatsNow();
+    stats["jitterMs"] = jackClient->tempo.jitterMs();
+    stats["maxJitterMs"] = jackClient->tempo.maxJitterMs();
+    return stats;
+}
+
 void MidiClient::setCc(bool cc) {
     if (m_cc != cc) {
         m_cc = cc;
@@ -303,14 +516,42 @@ void MidiClient::setMidiChannel(int channel)
 {
     if (m_midiChannel != channel) {
         m_midiChannel = channel;
+        applyControllers();
         emit midiChannelChanged(channel);
     }
 }
 
+void MidiClient::setExpressionControl(int control)
+{
+    if (m_expressionControl != control) {
+        m_expressionControl = control;
+        applyControllers();
+        emit expressionControlChanged(control);
+    }
+}
+
+// The tracker consumes its controller on the JACK thread, a page turn
+// bound to the same control would never fire: page turns win
+void MidiClient::applyControllers()
+{
+    if (!jackClient)
+        return;
+
+    jackClient->setPageControls(m_midiChannel, m_nextPageControl, m_prevPageControl);
+
+    int control = m_expressionControl;
+    if (control >= 0 && (control == m_nextPageControl || control == m_prevPageControl)) {
+        qWarning() << "Expression control" << control << "is also a page turn control, not tracking it";
+        control = -1;
+    }
+    jackClient->expression.setController(m_midiChannel, control);
+}
+
 void MidiClient::setNextPageControl(int control)
 {
     if (m_nextPageControl != control) {
         m_nextPageControl = control;
+        applyControllers();
         emit nextPageControlChanged(control);
     }
 }
@@ -319,6 +560,7 @@ void MidiClient::setPrevPageControl(int control)
 {
     if (m_prevPageControl != control) {
         m_prevPageControl = control;
+        applyControllers();
         emit prevPageControlChanged(control);
     }
 }
@@ -1,17 +1,23 @@
 #ifndef MIDICLIENT_H
 #define MIDICLIENT_H
 
+#include <QElapsedTimer>
 #include <QObject>
+#include <QPointer>
+#include <QThread>
 #include <QTimer>
 #include <backend/jackclient.h>
 #include <backend/midiutils.h>
 #include <backend/midiportmodel.h>
+#include <backend/midimonitor.h>
 
 class MidiClient  : public QObject
 {
     Q_OBJECT
     Q_PROPERTY(MidiPortModel* inputPorts READ inputPorts CONSTANT)
     Q_PROPERTY(MidiPortModel* outputPorts READ outputPorts CONSTANT)
+    // Incoming messages per controller, for the settings page
+    Q_PROPERTY(MidiMonitor* monitor READ monitor CONSTANT)
     Q_PROPERTY(bool isOutputPortConnected READ isOutputPortConnected NOTIFY connectionStatusChanged)
     Q_PROPERTY(bool isInputPortConnected READ isInputPortConnected NOTIFY connectionStatusChanged)
     Q_PROPERTY(bool cc READ cc WRITE setCc NOTIFY ccChanged)
@@ -23,18 +29,34 @@ class MidiClient  : public QObject
     Q_PROPERTY(int nextPageControl READ nextPageControl WRITE setNextPageControl NOTIFY nextPageControlChanged)
     Q_PROPERTY(int prevPageControl READ prevPageControl WRITE setPrevPageControl NOTIFY prevPageControlChanged)
     Q_PROPERTY(QString currentMidiDevice READ currentMidiDevice WRITE setCurrentMidiDevice NOTIFY currentMidiDeviceChanged)
+    Q_PROPERTY(double tempo READ tempo NOTIFY clockChanged)
+    Q_PROPERTY(bool clockRunning READ clockRunning NOTIFY clockChanged)
+    Q_PROPERTY(int expressionControl READ expressionControl WRITE setExpressionControl NOTIFY expressionControlChanged)
+    // JACK is brought up in the background, see start()
+    Q_PROPERTY(int midiState READ midiState NOTIFY midiStateChanged)
+    Q_PROPERTY(bool midiReady READ midiReady NOTIFY midiStateChanged)
+    Q_PROPERTY(QString midiError READ midiError NOTIFY midiStateChanged)
 
 
 
 public:
+    enum MidiState {
+        Starting,
+        Ready,
+        Failed  // Retried with backoff until the JACK server shows up
+    };
+    Q_ENUM(MidiState)
+
     explicit MidiClient(QObject *parent = nullptr);
+    ~MidiClient();
     MidiPortModel* inputPorts() const { return m_inputPorts; }
     MidiPortModel* outputPorts() const { return m_outputPorts; }
+    MidiMonitor* monitor() const { return m_monitor; }
     bool isOutputPortConnected() const {
         return jackClient && jackClient->midiout && jackClient->midiout->is_port_connected();
     }
     bool isInputPortConnected() const {
-         return jackClient && jackClient->midiin && jackClient->midiin->is_port_connected();
+         return jackClient && jackClient->connectedInputCount() > 0;
      }
     bool cc() const;
     bool pc() const;
@@ -46,12 +68,36 @@ public:
     int nextPageControl() const { return m_nextPageControl; }
     int prevPageControl() const { return m_prevPageControl; }
     QString currentMidiDevice() const { return m_currentMidiDevice; }
+    double tempo() const { return m_tempo; }
+    int midiState() const { return m_midiState; }
+    bool midiReady() const { return m_midiState == Ready; }
+    QString midiError() const { return m_midiError; }
+    bool clockRunning() const { return m_clockRunning; }
+
+    // Beat position of the incoming MIDI clock, meant to be read once per frame
+    Q_INVOKABLE double clockBeats() const;
+    Q_INVOKABLE QVariantMap clockStats() const;
+
+    // Smoothed expression controller value in [0, 1], read once per frame
+    int expressionControl() const { return m_expressionControl; }
+    Q_INVOKABLE double expressionValue() const;
+    Q_INVOKABLE QVariantMap expressionStats() const;
+
+    // Output queue depth and delivery counters
+    Q_INVOKABLE QVariantMap outputStats() const;
+
+    // Open inputs as { slot, name, connected, types, received, filtered }
+    Q_INVOKABLE QVariantList inputStats() const;
+
+    // { state, attempts, lastAttemptMs, readyAfterMs }
+    Q_INVOKABLE QVariantMap startupStats() const;
 
     // Add setters
     void setMidiChannel(int channel);
     void setNextPageControl(int control);
     void setPrevPageControl(int control);
     void setCurrentMidiDevice(const QString &device);
+    void setExpressionControl(int control);
 
 
 
@@ -70,13 +116,20 @@ signals:
     void nextPageControlChanged(int control);
     void prevPageControlChanged(int control);
     void currentMidiDeviceChanged(QString device);
+    void clockChanged();
+    void expressionControlChanged(int control);
+    void midiStateChanged();
 
     void goToNextPage();
     void goToPreviousPage();
 
-    void midiMessageReceived(int channel, int control, int value);
+    // A message given to sendRawMessage() didn't fit in the output queue
+    void outputMessageDropped(int size);
 
 public slots:
+    // Opens the JACK client on a background thread, so the window doesn't
+    // wait for it; the state goes to Ready or Failed when done
+    Q_INVOKABLE void start();
     Q_INVOKABLE void sendControlChange(int channel, int control, int value);
     Q_INVOKABLE void sendRawMessage(const libremidi::message& message);
     Q_INVOKABLE void sendAllNotesOff();
@@ -85,7 +138,11 @@ public slots:
     Q_INVOKABLE void getIOPorts();
     Q_INVOKABLE void makeConnection(QVariant inputPorts, QVariant outputPorts);
     Q_INVOKABLE void makeDisconnect();
+    Q_INVOKABLE void disconnectInput(int slot);
+    // types: JackClient::MessageType flags, channels: bit n for channel n + 1
+    Q_INVOKABLE void setInputFilter(int slot, int types, int channels = 0xFFFF);
     void checkOutputPortConnection();
+    void checkClock();
     void setCc(bool cc);
     void setPc(bool pc);
     void setBankNumber(int newBankNumber);
@@ -95,7 +152,20 @@ private slots:
     void handleMidiMessage(const libremidi::message& message);
 
 private:
-    JackClient *jackClient;
+    void jackStarted(JackClient *client, const QString &message, qint64 elapsedMs);
+    void applyControllers();
+
+    JackClient *jackClient = nullptr;
+    QPointer<QThread> m_initThread;
+    QTimer *m_retryTimer;
+    QElapsedTimer m_startupTimer;
+    int m_midiState = Starting;
+    QString m_midiError;
+    int m_initAttempts = 0;
+    qint64 m_lastAttemptMs = 0;
+    qint64 m_readyAfterMs = -1;
+    static const int RETRY_MIN_MS = 1000;
+    static const int RETRY_MAX_MS = 10000;
     bool itsNote(const libremidi::message& message);
     bool itsVolumeCC(const libremidi::message& message);
     bool isNextPagesCC(const libremidi::message& message);
@@ -104,6 +174,7 @@ private:
     QString noteNumberToName(int noteNumber) const;
     MidiPortModel *m_inputPorts;
     MidiPortModel *m_outputPorts;
+    MidiMonitor *m_monitor;
     bool m_lastInputPortStatus = false;
     bool m_lastOutputPortStatus = false;
     bool m_cc;
@@ -113,10 +184,13 @@ private:
 
 
 
-    int m_midiChannel = 0;
+    int m_midiChannel = ControllerTracker::DEFAULT_CHANNEL;
     int m_nextPageControl = 64;  // Default to sustain pedal
     int m_prevPageControl = 67;  // Default to soft pedal
     QString m_currentMidiDevice;
+    double m_tempo = 0.0;
+    bool m_clockRunning = false;
+    int m_expressionControl = -1; // Disabled
 
 
 };
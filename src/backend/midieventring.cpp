@@ -0,0 +1,45 @@
+#include "midieventring.h"
+#include <algorithm>
+#include <chrono>
+
+static_assert((MidiEventRing::CAPACITY & (MidiEventRing::CAPACITY - 1)) == 0,
+              "MidiEventRing::CAPACITY must be a power of two");
+
+void MidiEventRing::setEnabled(bool enable)
+{
+    if (enable && !isEnabled())
+        readIndex.store(writeIndex.load(std::memory_order_acquire), std::memory_order_release);
+    enabled.store(enable, std::memory_order_relaxed);
+}
+
+void MidiEventRing::push(const libremidi::message& message)
+{
+    if (!enabled.load(std::memory_order_relaxed) || message.size() < 2 || message[0] < 0x80 || message[0] >= 0xF0)
+        return;
+
+    const uint64_t write = writeIndex.load(std::memory_order_relaxed);
+    if (write - readIndex.load(std::memory_order_acquire) >= CAPACITY)
+    {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    Event& event = slots[write & (CAPACITY - 1)];
+    const auto now = std::chrono::steady_clock::now().time_since_epoch();
+    event.timeNs = std::chrono::duration_cast<std::chrono::nanoseconds>(now).count();
+    event.status = message[0];
+    event.data1 = message[1];
+    event.data2 = message.size() > 2 ? message[2] : 0;
+    writeIndex.store(write + 1, std::memory_order_release);
+}
+
+size_t MidiEventRing::drain(Event* events, size_t maxCount)
+{
+    const uint64_t read = readIndex.load(std::memory_order_relaxed);
+    const uint64_t write = writeIndex.load(std::memory_order_acquire);
+    const size_t count = size_t(std::min<uint64_t>(write - read, maxCount));
+    for (size_t i = 0; i < count; ++i)
+        events[i] = slots[(read + i) & (CAPACITY - 1)];
+    readIndex.store(read + count, std::memory_order_release);
+    return count;
+}
@@ -0,0 +1,49 @@
+#ifndef MIDIEVENTRING_H
+#define MIDIEVENTRING_H
+
+#include <libremidi/message.hpp>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Recent incoming channel messages for the MIDI monitor (see MidiMonitor).
+// The JACK process callback pushes, the GUI thread drains once per frame,
+// so however dense the input the GUI handles a batch per frame instead of
+// a queued signal per message. Nothing is recorded until it is enabled;
+// when the GUI falls behind new events are dropped and counted.
+class MidiEventRing
+{
+public:
+    static constexpr size_t CAPACITY = 1024; // Power of two
+
+    struct Event
+    {
+        int64_t timeNs = 0; // Steady clock
+        uint8_t status = 0;
+        uint8_t data1 = 0;
+        uint8_t data2 = 0;
+    };
+
+    // GUI thread; enabling discards whatever is left from before
+    void setEnabled(bool enable);
+    bool isEnabled() const { return enabled.load(std::memory_order_relaxed); }
+
+    // Realtime thread. Channel messages only, clock and SysEx are skipped.
+    void push(const libremidi::message& message);
+
+    // GUI thread: copies up to maxCount events, oldest first, and returns
+    // how many
+    size_t drain(Event* events, size_t maxCount);
+
+    uint64_t droppedCount() const { return dropped.load(std::memory_order_relaxed); }
+
+private:
+    std::array<Event, CAPACITY> slots;
+    std::atomic<uint64_t> writeIndex{0};
+    std::atomic<uint64_t> readIndex{0};
+    std::atomic<bool> enabled{false};
+    std::atomic<uint64_t> dropped{0};
+};
+
+#endif // MIDIEVENTRING_H
@@ -0,0 +1,190 @@
+#include "midimonitor.h"
+
+MidiMonitor::MidiMonitor(QObject *parent)
+    : QAbstractListModel{parent}
+{}
+
+int MidiMonitor::rowCount(const QModelIndex &parent) const
+{
+    if (parent.isValid())
+        return 0;
+    return m_rows.count();
+}
+
+QVariant MidiMonitor::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() >= m_rows.size())
+        return QVariant();
+
+    const Controller &row = m_rows[index.row()];
+    switch (role) {
+    case ChannelRole:
+        return row.channel;
+    case TypeRole:
+        return typeName(row.type);
+    case NumberRole:
+        return row.number;
+    case ValueRole:
+        return row.value;
+    case CountRole:
+        return row.count;
+    case RateRole:
+        return row.rate;
+    default:
+        return QVariant();
+    }
+}
+
+QHash<int, QByteArray> MidiMonitor::roleNames() const
+{
+    QHash<int, QByteArray> roles;
+    roles[ChannelRole] = "channel";
+    roles[TypeRole] = "type";
+    roles[NumberRole] = "number";
+    roles[ValueRole] = "value";
+    roles[CountRole] = "count";
+    roles[RateRole] = "rate";
+    return roles;
+}
+
+void MidiMonitor::setSource(MidiEventRing *ring)
+{
+    if (m_source)
+        m_source->setEnabled(false);
+    m_source = ring;
+    if (m_source)
+        m_source->setEnabled(m_active);
+    emit statsChanged();
+}
+
+void MidiMonitor::setActive(bool active)
+{
+    if (m_active == active)
+        return;
+
+    m_active = active;
+    if (m_source)
+        m_source->setEnabled(active);
+    m_rateTimer.start();
+    m_eventCountAtRate = m_eventCount;
+    for (Controller &row : m_rows)
+        row.countAtRate = row.count;
+    emit activeChanged();
+}
+
+QString MidiMonitor::typeName(int type)
+{
+    switch (type) {
+    case 0x80:
+    case 0x90:
+        return QStringLiteral("note");
+    case 0xA0:
+        return QStringLiteral("polyPressure");
+    case 0xB0:
+        return QStringLiteral("cc");
+    case 0xC0:
+        return QStringLiteral("program");
+    case 0xD0:
+        return QStringLiteral("pressure");
+    case 0xE0:
+        return QStringLiteral("bend");
+    default:
+        return QString();
+    }
+}
+
+MidiMonitor::Controller MidiMonitor::fromEvent(const MidiEventRing::Event &event)
+{
+    Controller controller;
+    controller.channel = (event.status & 0x0F) + 1;
+    controller.type = event.status & 0xF0;
+    switch (controller.type) {
+    case 0x80:
+        // Note off is the same key as note on, with a zero velocity
+        controller.type = 0x90;
+        controller.number = event.data1;
+        controller.value = 0;
+        break;
+    case 0x90:
+    case 0xA0:
+    case 0xB0:
+        controller.number = event.data1;
+        controller.value = event.data2;
+        break;
+    case 0xE0:
+        controller.value = (event.data2 << 7) | event.data1;
+        break;
+    default:
+        controller.value = event.data1;
+        break;
+    }
+    return controller;
+}
+
+void MidiMonitor::update()
+{
+    if (!m_source || !m_active)
+        return;
+
+    const size_t count = m_source->drain(m_batch.data(), m_batch.size());
+    int firstChanged = m_rows.size();
+    int lastChanged = -1;
+    for (size_t i = 0; i < count; ++i) {
+        const Controller event = fromEvent(m_batch[i]);
+        const quint32 key = quint32(event.type) << 16 | quint32(event.channel) << 8 | quint32(event.number & 0xFF);
+
+        auto found = m_rowByKey.constFind(key);
+        if (found == m_rowByKey.cend()) {
+            const int row = m_rows.size();
+            beginInsertRows(QModelIndex(), row, row);
+            m_rows.append(event);
+            m_rows.last().count = 1;
+            m_rowByKey.insert(key, row);
+            endInsertRows();
+        } else {
+            Controller &row = m_rows[found.value()];
+            row.value = event.value;
+            ++row.count;
+            firstChanged = qMin(firstChanged, found.value());
+            lastChanged = qMax(lastChanged, found.value());
+        }
+        m_last = event;
+    }
+
+    if (count > 0) {
+        m_eventCount += count;
+        if (lastChanged >= firstChanged)
+            emit dataChanged(index(firstChanged), index(lastChanged), {ValueRole, CountRole});
+        emit lastEventChanged();
+    }
+
+    if (m_rateTimer.elapsed() < RATE_INTERVAL_MS)
+        return;
+
+    const double seconds = m_rateTimer.restart() / 1000.0;
+    for (Controller &row : m_rows) {
+        row.rate = (row.count - row.countAtRate) / seconds;
+        row.countAtRate = row.count;
+    }
+    if (!m_rows.isEmpty())
+        emit dataChanged(index(0), index(m_rows.size() - 1), {RateRole});
+    m_eventsPerSecond = (m_eventCount - m_eventCountAtRate) / seconds;
+    m_eventCountAtRate = m_eventCount;
+    emit statsChanged();
+}
+
+void MidiMonitor::clear()
+{
+    beginResetModel();
+    m_rows.clear();
+    m_rowByKey.clear();
+    endResetModel();
+
+    m_last = Controller();
+    m_eventCount = 0;
+    m_eventCountAtRate = 0;
+    m_eventsPerSecond = 0.0;
+    m_rateTimer.start();
+    emit lastEventChanged();
+    emit statsChanged();
+}
@@ -0,0 +1,96 @@
+#ifndef MIDIMONITOR_H
+#define MIDIMONITOR_H
+
+#include <QAbstractListModel>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QList>
+#include <QObject>
+#include <backend/midieventring.h>
+
+// What the MIDI inputs are sending, one row per controller (or note,
+// program change, pitch bend... per channel) with its last value, count
+// and rate. Events reach it through a MidiEventRing filled by the JACK
+// thread; update() drains the ring and is meant to be called once per
+// frame (a FrameAnimation), so a controller streaming at 1000 messages
+// per second costs one batch of row updates per frame. Rates are
+// refreshed every RATE_INTERVAL_MS.
+class MidiMonitor : public QAbstractListModel
+{
+    Q_OBJECT
+    Q_PROPERTY(bool active READ isActive WRITE setActive NOTIFY activeChanged)
+    Q_PROPERTY(int lastChannel READ lastChannel NOTIFY lastEventChanged)
+    Q_PROPERTY(QString lastType READ lastType NOTIFY lastEventChanged)
+    Q_PROPERTY(int lastNumber READ lastNumber NOTIFY lastEventChanged)
+    Q_PROPERTY(int lastValue READ lastValue NOTIFY lastEventChanged)
+    Q_PROPERTY(double eventsPerSecond READ eventsPerSecond NOTIFY statsChanged)
+    Q_PROPERTY(qulonglong eventCount READ eventCount NOTIFY statsChanged)
+    Q_PROPERTY(qulonglong dropped READ dropped NOTIFY statsChanged)
+
+public:
+    explicit MidiMonitor(QObject *parent = nullptr);
+
+    enum Roles {
+        ChannelRole = Qt::UserRole + 1,
+        TypeRole,   // "cc", "note", "polyPressure", "program", "pressure", "bend"
+        NumberRole, // Controller or note number, -1 for the others
+        ValueRole,  // Pitch bend is 0-16383, the rest 0-127
+        CountRole,
+        RateRole    // Messages per second
+    };
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QHash<int, QByteArray> roleNames() const override;
+
+    // Set once JACK is up; nullptr detaches
+    void setSource(MidiEventRing *ring);
+
+    // Recording only happens while active
+    bool isActive() const { return m_active; }
+    void setActive(bool active);
+
+    int lastChannel() const { return m_last.channel; }
+    QString lastType() const { return typeName(m_last.type); }
+    int lastNumber() const { return m_last.number; }
+    int lastValue() const { return m_last.value; }
+    double eventsPerSecond() const { return m_eventsPerSecond; }
+    qulonglong eventCount() const { return m_eventCount; }
+    qulonglong dropped() const { return m_source ? m_source->droppedCount() : 0; }
+
+    Q_INVOKABLE void update();
+    Q_INVOKABLE void clear();
+
+    static constexpr int RATE_INTERVAL_MS = 1000;
+
+signals:
+    void activeChanged();
+    void lastEventChanged();
+    void statsChanged();
+
+private:
+    struct Controller {
+        int channel = 0;  // 1-16
+        int type = 0;     // Status nibble, 0x80-0xE0
+        int number = -1;
+        int value = 0;
+        quint64 count = 0;
+        quint64 countAtRate = 0;
+        double rate = 0.0;
+    };
+
+    static QString typeName(int type);
+    static Controller fromEvent(const MidiEventRing::Event &event);
+
+    MidiEventRing *m_source = nullptr;
+    bool m_active = false;
+    QList<Controller> m_rows;
+    QHash<quint32, int> m_rowByKey;
+    Controller m_last;
+    quint64 m_eventCount = 0;
+    quint64 m_eventCountAtRate = 0;
+    double m_eventsPerSecond = 0.0;
+    QElapsedTimer m_rateTimer;
+    std::array<MidiEventRing::Event, MidiEventRing::CAPACITY> m_batch;
+};
+
+#endif // MIDIMONITOR_H
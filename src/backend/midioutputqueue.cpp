@@ -0,0 +1,211 @@
+#include "midioutputqueue.h"
+#include <utils/metrics.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+static_assert((MidiOutputQueue::CAPACITY & (MidiOutputQueue::CAPACITY - 1)) == 0,
+              "MidiOutputQueue::CAPACITY must be a power of two");
+
+MidiOutputQueue::Message MidiOutputQueue::Message::controlChange(int channel, int control, int value)
+{
+    Message message;
+    message.size = 3;
+    message.bytes[0] = uint8_t(0xB0 | ((channel - 1) & 0x0F));
+    message.bytes[1] = uint8_t(control & 0x7F);
+    message.bytes[2] = uint8_t(value & 0x7F);
+    return message;
+}
+
+MidiOutputQueue::Message MidiOutputQueue::Message::programChange(int channel, int program)
+{
+    Message message;
+    message.size = 2;
+    message.bytes[0] = uint8_t(0xC0 | ((channel - 1) & 0x0F));
+    message.bytes[1] = uint8_t(program & 0x7F);
+    return message;
+}
+
+MidiOutputQueue::Message MidiOutputQueue::Message::fromBytes(const unsigned char* data, size_t count)
+{
+    Message message;
+    if (count == 0 || count > MAX_MESSAGE_SIZE)
+        return message;
+    message.size = uint8_t(count);
+    std::memcpy(message.bytes, data, count);
+    return message;
+}
+
+static int64_t steadyNowNs()
+{
+    const auto now = std::chrono::steady_clock::now().time_since_epoch();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(now).count();
+}
+
+static Metrics::Counter& droppedMetric = Metrics::counter("midi.outputDropped");
+static Metrics::Counter& lateMetric = Metrics::counter("midi.outputLate");
+
+void MidiOutputQueue::countDropped(size_t count)
+{
+    dropped.fetch_add(count, std::memory_order_relaxed);
+    droppedMetric.add(count);
+}
+
+bool MidiOutputQueue::push(const Message* messages, size_t count)
+{
+    if (count == 0)
+        return true;
+    if (count > CAPACITY || std::any_of(messages, messages + count, [](const Message& m) { return m.size == 0; }))
+    {
+        countDropped(count);
+        return false;
+    }
+
+    // Producers are GUI-side and rare; the consumer never takes this
+    while (producerLock.test_and_set(std::memory_order_acquire))
+        ;
+
+    const uint64_t write = writeIndex.load(std::memory_order_relaxed);
+    const uint64_t used = write - readIndex.load(std::memory_order_acquire);
+    if (used + count > CAPACITY)
+    {
+        producerLock.clear(std::memory_order_release);
+        countDropped(count);
+        return false;
+    }
+
+    const int64_t now = steadyNowNs();
+    for (size_t i = 0; i < count; ++i)
+    {
+        Slot& slot = slots[(write + i) & (CAPACITY - 1)];
+        slot.message = messages[i];
+        slot.longSize = 0;
+        slot.queuedNs = now;
+    }
+    // Publishes the whole batch at once
+    writeIndex.store(write + count, std::memory_order_release);
+    producerLock.clear(std::memory_order_release);
+
+    const size_t newDepth = size_t(used + count);
+    size_t oldPeak = peak.load(std::memory_order_relaxed);
+    while (newDepth > oldPeak && !peak.compare_exchange_weak(oldPeak, newDepth, std::memory_order_relaxed))
+        ;
+    return true;
+}
+
+bool MidiOutputQueue::pushBytes(const unsigned char* data, size_t count)
+{
+    if (count > 0 && count <= MAX_MESSAGE_SIZE)
+        return push(Message::fromBytes(data, count));
+    if (count == 0 || count > LONG_BYTES)
+    {
+        if (count > LONG_BYTES)
+            oversized.fetch_add(1, std::memory_order_relaxed);
+        countDropped(1);
+        return false;
+    }
+
+    while (producerLock.test_and_set(std::memory_order_acquire))
+        ;
+
+    const uint64_t write = writeIndex.load(std::memory_order_relaxed);
+    const uint64_t used = write - readIndex.load(std::memory_order_acquire);
+
+    // Skip the tail of the ring rather than splitting the message
+    uint64_t start = longWrite;
+    if (start % LONG_BYTES + count > LONG_BYTES)
+        start += LONG_BYTES - start % LONG_BYTES;
+    const uint64_t end = start + count;
+    if (used + 1 > CAPACITY || end - longRead.load(std::memory_order_acquire) > LONG_BYTES)
+    {
+        producerLock.clear(std::memory_order_release);
+        countDropped(1);
+        return false;
+    }
+
+    Slot& slot = slots[write & (CAPACITY - 1)];
+    slot.message = Message();
+    slot.longOffset = uint32_t(start % LONG_BYTES);
+    slot.longSize = uint32_t(count);
+    slot.longEnd = end;
+    slot.queuedNs = steadyNowNs();
+    std::memcpy(longData.data() + slot.longOffset, data, count);
+    longWrite = end;
+    writeIndex.store(write + 1, std::memory_order_release);
+    producerLock.clear(std::memory_order_release);
+
+    size_t oldPeak = peak.load(std::memory_order_relaxed);
+    while (used + 1 > oldPeak && !peak.compare_exchange_weak(oldPeak, size_t(used + 1), std::memory_order_relaxed))
+        ;
+    return true;
+}
+
+void MidiOutputQueue::drain(libremidi::midi_out& out, int64_t nowNs, int64_t lateNs)
+{
+    const uint64_t first = readIndex.load(std::memory_order_relaxed);
+    const uint64_t write = writeIndex.load(std::memory_order_acquire);
+    if (first == write)
+        return;
+
+    uint64_t lateMessages = 0;
+    int64_t worstLatency = 0;
+    uint64_t longEnd = 0;
+    for (uint64_t read = first; read != write; ++read)
+    {
+        const Slot& slot = slots[read & (CAPACITY - 1)];
+        if (slot.longSize)
+        {
+            out.send_message(longData.data() + slot.longOffset, slot.longSize);
+            longEnd = slot.longEnd;
+        }
+        else
+        {
+            out.send_message(slot.message.bytes, slot.message.size);
+        }
+
+        const int64_t latency = nowNs - slot.queuedNs;
+        worstLatency = std::max(worstLatency, latency);
+        if (latency > lateNs)
+            ++lateMessages;
+    }
+    // Bytes first, a producer that sees the slots free also sees their bytes free
+    if (longEnd)
+        longRead.store(longEnd, std::memory_order_release);
+    readIndex.store(write, std::memory_order_release);
+
+    sent.fetch_add(write - first, std::memory_order_relaxed);
+    if (lateMessages)
+    {
+        late.fetch_add(lateMessages, std::memory_order_relaxed);
+        lateMetric.add(lateMessages);
+    }
+    if (worstLatency > maxLatencyNs.load(std::memory_order_relaxed))
+        maxLatencyNs.store(worstLatency, std::memory_order_relaxed);
+}
+
+void MidiOutputQueue::discard()
+{
+    const uint64_t first = readIndex.load(std::memory_order_relaxed);
+    const uint64_t write = writeIndex.load(std::memory_order_acquire);
+    if (first == write)
+        return;
+
+    uint64_t longEnd = 0;
+    for (uint64_t read = first; read != write; ++read)
+    {
+        const Slot& slot = slots[read & (CAPACITY - 1)];
+        if (slot.longSize)
+            longEnd = slot.longEnd;
+    }
+    if (longEnd)
+        longRead.store(longEnd, std::memory_order_release);
+    readIndex.store(write, std::memory_order_release);
+    countDropped(write - first);
+}
+
+size_t MidiOutputQueue::depth() const
+{
+    // Read index first, it can only move towards the write index
+    const uint64_t read = readIndex.load(std::memory_order_acquire);
+    return size_t(writeIndex.load(std::memory_order_acquire) - read);
+}
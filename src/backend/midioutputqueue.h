@@ -0,0 +1,92 @@
+#ifndef MIDIOUTPUTQUEUE_H
+#define MIDIOUTPUTQUEUE_H
+
+#include <libremidi/libremidi.hpp>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Preallocated ring of outgoing MIDI messages, drained by the JACK process
+// callback. A batch is published with a single store of the write index, so
+// the callback sees either all of its messages or none of them and sends
+// them contiguously in the same period (bank select + program change reach
+// the instrument together). Nothing here allocates; the callback side never
+// blocks, producers only serialize among themselves. Messages longer than
+// a slot (SysEx dumps) are copied into a preallocated byte ring of their
+// own and keep their place in the message order.
+class MidiOutputQueue
+{
+public:
+    static constexpr size_t MAX_MESSAGE_SIZE = 16; // Inline in a slot
+    static constexpr size_t CAPACITY = 1024;       // Power of two
+    static constexpr size_t LONG_BYTES = 64 * 1024; // Longest SysEx that can be queued
+
+    struct Message
+    {
+        uint8_t size = 0;
+        uint8_t bytes[MAX_MESSAGE_SIZE] = {};
+
+        // channel 1-16
+        static Message controlChange(int channel, int control, int value);
+        static Message programChange(int channel, int program);
+        // Invalid (size 0) when longer than MAX_MESSAGE_SIZE, see pushBytes()
+        static Message fromBytes(const unsigned char* data, size_t count);
+    };
+
+    // All or nothing: returns false, and counts the batch as dropped, when
+    // it doesn't fit in the free space or contains an invalid message
+    bool push(const Message* messages, size_t count);
+    bool push(const Message& message) { return push(&message, 1); }
+    // Any length up to LONG_BYTES. Returns false, and counts it as dropped
+    // (or oversized when longer than LONG_BYTES), when it doesn't fit.
+    bool pushBytes(const unsigned char* data, size_t count);
+
+    // Called from the JACK process callback, after the output port buffer
+    // has been prepared for the period. Messages queued more than lateNs ago
+    // are still sent, but counted as late.
+    void drain(libremidi::midi_out& out, int64_t nowNs, int64_t lateNs);
+    // From the process callback while no output port is open: what's queued
+    // is counted as dropped rather than sent in a burst once one opens
+    void discard();
+
+    size_t depth() const;
+    size_t peakDepth() const { return peak.load(std::memory_order_relaxed); }
+    uint64_t sentCount() const { return sent.load(std::memory_order_relaxed); }
+    uint64_t lateCount() const { return late.load(std::memory_order_relaxed); }
+    uint64_t droppedCount() const { return dropped.load(std::memory_order_relaxed); }
+    uint64_t oversizedCount() const { return oversized.load(std::memory_order_relaxed); }
+    double maxLatencyMs() const { return maxLatencyNs.load(std::memory_order_relaxed) / 1e6; }
+
+private:
+    struct Slot
+    {
+        Message message;
+        // Long messages: bytes at longOffset in longData, message.size is 0
+        uint32_t longSize = 0;
+        uint32_t longOffset = 0;
+        uint64_t longEnd = 0; // longWrite after this message
+        int64_t queuedNs = 0;
+    };
+
+    void countDropped(size_t count);
+
+    std::array<Slot, CAPACITY> slots;
+    std::atomic<uint64_t> writeIndex{0};
+    std::atomic<uint64_t> readIndex{0};
+    std::atomic_flag producerLock = ATOMIC_FLAG_INIT;
+
+    // Running byte counts, a message never wraps around the end
+    std::array<uint8_t, LONG_BYTES> longData;
+    uint64_t longWrite = 0; // Under producerLock
+    std::atomic<uint64_t> longRead{0};
+
+    std::atomic<size_t> peak{0};
+    std::atomic<uint64_t> sent{0};
+    std::atomic<uint64_t> late{0};
+    std::atomic<uint64_t> dropped{0};
+    std::atomic<uint64_t> oversized{0};
+    std::atomic<int64_t> maxLatencyNs{0};
+};
+
+#endif // MIDIOUTPUTQUEUE_H
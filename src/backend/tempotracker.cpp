@@ -0,0 +1,146 @@
+#include "tempotracker.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+// Weight of a new tick in the smoothed period; about a beat of averaging
+static constexpr double PERIOD_SMOOTHING = 0.08;
+static constexpr double JITTER_SMOOTHING = 0.05;
+// A tick further off than this restarts the tempo estimate (tempo jump,
+// dropout, clock source change)
+static constexpr double MAX_PERIOD_RATIO = 1.5;
+
+bool TempoTracker::process(const libremidi::message& message)
+{
+    if (message.size() != 1)
+        return false;
+
+    switch (message[0])
+    {
+    case 0xF8: // Timing Clock
+    {
+        const int64_t now = message.timestamp;
+        if (rt.lastTickNs > 0)
+        {
+            const int64_t interval = now - rt.lastTickNs;
+            if (rt.periodNs <= 0
+                || interval > rt.periodNs * MAX_PERIOD_RATIO
+                || interval * MAX_PERIOD_RATIO < rt.periodNs)
+            {
+                rt.periodNs = interval;
+            }
+            else
+            {
+                const double error = double(interval - rt.periodNs);
+                jitterSquaresNs += (error * error - jitterSquaresNs) * JITTER_SMOOTHING;
+                jitterRmsNs.store(int64_t(std::sqrt(jitterSquaresNs)), std::memory_order_relaxed);
+                if (std::abs(error) > maxJitterNs.load(std::memory_order_relaxed))
+                    maxJitterNs.store(int64_t(std::abs(error)), std::memory_order_relaxed);
+
+                rt.periodNs += int64_t(error * PERIOD_SMOOTHING);
+            }
+        }
+        rt.lastTickNs = now;
+        if (rt.running)
+            ++rt.ticks;
+        break;
+    }
+    case 0xFA: // Start
+        rt.ticks = -1;
+        rt.running = true;
+        break;
+    case 0xFB: // Continue
+        rt.running = true;
+        break;
+    case 0xFC: // Stop
+        rt.running = false;
+        break;
+    default:
+        return false;
+    }
+
+    publish(rt);
+    return true;
+}
+
+void TempoTracker::publish(const State& state)
+{
+    const uint32_t s = sequence.load(std::memory_order_relaxed);
+    sequence.store(s + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    ticks.store(state.ticks, std::memory_order_relaxed);
+    lastTickNs.store(state.lastTickNs, std::memory_order_relaxed);
+    periodNs.store(state.periodNs, std::memory_order_relaxed);
+    running.store(state.running, std::memory_order_relaxed);
+
+    sequence.store(s + 2, std::memory_order_release);
+}
+
+TempoTracker::State TempoTracker::read() const
+{
+    State state;
+    uint32_t before, after;
+    do
+    {
+        before = sequence.load(std::memory_order_acquire);
+        state.ticks = ticks.load(std::memory_order_relaxed);
+        state.lastTickNs = lastTickNs.load(std::memory_order_relaxed);
+        state.periodNs = periodNs.load(std::memory_order_relaxed);
+        state.running = running.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        after = sequence.load(std::memory_order_relaxed);
+    } while (before != after || (before & 1));
+    return state;
+}
+
+bool TempoTracker::isRunning() const
+{
+    return read().running;
+}
+
+double TempoTracker::bpm() const
+{
+    const State state = read();
+    if (state.periodNs <= 0)
+        return 0.0;
+    return 60e9 / (double(state.periodNs) * TICKS_PER_BEAT);
+}
+
+double TempoTracker::beatsAt(int64_t nanoseconds) const
+{
+    const State state = read();
+    if (state.ticks < 0)
+        return 0.0;
+
+    double tick = double(state.ticks);
+    if (state.running && state.periodNs > 0)
+    {
+        // Never run more than one tick ahead of the clock, so a stalled
+        // clock stops the position instead of letting it drift
+        const double sinceTick = double(nanoseconds - state.lastTickNs) / double(state.periodNs);
+        tick += std::clamp(sinceTick, 0.0, 1.0);
+    }
+    return tick / TICKS_PER_BEAT;
+}
+
+double TempoTracker::beatsNow() const
+{
+    const auto now = std::chrono::steady_clock::now().time_since_epoch();
+    return beatsAt(std::chrono::duration_cast<std::chrono::nanoseconds>(now).count());
+}
+
+double TempoTracker::jitterMs() const
+{
+    return jitterRmsNs.load(std::memory_order_relaxed) / 1e6;
+}
+
+double TempoTracker::maxJitterMs() const
+{
+    return maxJitterNs.load(std::memory_order_relaxed) / 1e6;
+}
+
+void TempoTracker::resetJitter()
+{
+    maxJitterNs.store(0, std::memory_order_relaxed);
+}
@@ -0,0 +1,59 @@
+#ifndef TEMPOTRACKER_H
+#define TEMPOTRACKER_H
+
+#include <libremidi/message.hpp>
+#include <atomic>
+#include <cstdint>
+
+// Follows MIDI clock (24 ticks per beat) and start/stop/continue.
+// process() runs in the JACK process callback and never blocks or
+// allocates; it publishes its state through a sequence lock so the GUI can
+// read a consistent beat position from any thread, once per frame.
+class TempoTracker
+{
+public:
+    // Returns true for the realtime messages it consumes, which are then
+    // not forwarded to the GUI thread
+    bool process(const libremidi::message& message);
+
+    bool isRunning() const;
+    double bpm() const;
+    // Beat position, extrapolated between clock ticks (steady clock ns)
+    double beatsAt(int64_t nanoseconds) const;
+    double beatsNow() const;
+
+    // Deviation of clock ticks from the smoothed tempo
+    double jitterMs() const;
+    double maxJitterMs() const;
+    void resetJitter();
+
+    static constexpr int TICKS_PER_BEAT = 24;
+
+private:
+    struct State
+    {
+        int64_t ticks = -1;       // Tick count since start, -1 before the first one
+        int64_t lastTickNs = 0;
+        int64_t periodNs = 0;     // Smoothed tick period
+        bool running = false;
+    };
+
+    State read() const;
+    void publish(const State& state);
+
+    // Only touched by the realtime thread
+    State rt;
+    double jitterSquaresNs = 0.0;
+
+    // Published copy of rt
+    std::atomic<uint32_t> sequence{0};
+    std::atomic<int64_t> ticks{-1};
+    std::atomic<int64_t> lastTickNs{0};
+    std::atomic<int64_t> periodNs{0};
+    std::atomic<bool> running{false};
+
+    std::atomic<int64_t> jitterRmsNs{0};
+    std::atomic<int64_t> maxJitterNs{0};
+};
+
+#endif // TEMPOTRACKER_H
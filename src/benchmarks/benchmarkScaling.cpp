@@ -0,0 +1,15 @@
+#include <QGuiApplication>
+
+#include "scalingBenchmark.h"
+
+// Measures how loading scales with the page count, no UI:
+//   benchmarkScaling [--pages 100,1000,10000]
+int main(int argc, char *argv[])
+{
+    QGuiApplication app(argc, argv);
+    QCoreApplication::setOrganizationName(QStringLiteral("SpiritMusic"));
+    QCoreApplication::setOrganizationDomain(QStringLiteral("Spiritmusic.com"));
+    QCoreApplication::setApplicationName(QStringLiteral("SpiritSheet"));
+
+    return ScalingBenchmark::run(app.arguments());
+}
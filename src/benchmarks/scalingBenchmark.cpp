@@ -0,0 +1,383 @@
+// scalingBenchmark.cpp
+#include "scalingBenchmark.h"
+#include <utils/documentRegistry.h>
+#include <utils/pdfModel.h>
+#include <utils/songIndex.h>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFile>
+#include <QQmlContext>
+#include <QQmlEngine>
+#include <QQuickImageProvider>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <QTimer>
+#include <QDebug>
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <limits>
+#include <memory>
+
+const QList<int> ScalingBenchmark::DEFAULT_SIZES = {100, 300, 1000, 3000, 10000};
+
+// A4 at 150 dpi, about what a page fills on a tablet in portrait
+static const QSize FIRST_PAGE_SIZE(1240, 1754);
+static const int FIRST_PAGE_TIMEOUT_MS = 30000;
+static const int SONG_INDEX_TIMEOUT_MS = 30000;
+// Fastest of, per key, against the scheduler picking another thread
+static const int SONG_SEARCH_RUNS = 5;
+
+// Below these the slope is noise, not scaling
+static const double NOISE_FLOOR_MS = 2.0;
+static const qint64 NOISE_FLOOR_BYTES = 1024 * 1024;
+
+static qint64 residentBytes()
+{
+    QFile status("/proc/self/status");
+    if (!status.open(QIODevice::ReadOnly | QIODevice::Text))
+        return -1;
+
+    for (QByteArray line = status.readLine(); !line.isEmpty(); line = status.readLine())
+    {
+        if (line.startsWith("VmRSS:"))
+            return line.mid(6).trimmed().split(' ').constFirst().toLongLong() * 1024;
+    }
+    return -1;
+}
+
+static double elapsedMs(const QElapsedTimer& timer)
+{
+    return timer.nsecsElapsed() / 1e6;
+}
+
+bool ScalingBenchmark::writeDocument(const QString& fileName, int pageCount, bool linked)
+{
+    // Objects: catalog, page tree, font, outline root, then a page, its
+    // content and its link for every page, then the outline entries
+    const int songCount = linked ? (pageCount + OUTLINE_SPACING - 1) / OUTLINE_SPACING : 0;
+    const int objectCount = 4 + 3 * pageCount + songCount;
+    const auto pageObject = [](int page) { return 5 + 3 * page; };
+    const auto songObject = [pageCount](int song) { return 5 + 3 * pageCount + song; };
+
+    QByteArray pdf = "%PDF-1.4\n";
+    QList<qint64> offsets(objectCount + 1, 0);
+    const auto addObject = [&](int number, const QByteArray& body) {
+        offsets[number] = pdf.size();
+        pdf += QByteArray::number(number) + " 0 obj\n" + body + "\nendobj\n";
+    };
+    const auto reference = [](int number) { return QByteArray::number(number) + " 0 R"; };
+
+    addObject(1, "<< /Type /Catalog /Pages 2 0 R"
+                     + QByteArray(linked ? " /Outlines 4 0 R /PageMode /UseOutlines" : "") + " >>");
+
+    QByteArray kids;
+    for (int page = 0; page < pageCount; ++page)
+        kids += reference(pageObject(page)) + ' ';
+    addObject(2, "<< /Type /Pages /Count " + QByteArray::number(pageCount) + " /Kids [" + kids + "] >>");
+    addObject(3, "<< /Type /Font /Subtype /Type1 /BaseFont /Helvetica >>");
+    if (songCount > 0)
+        addObject(4, "<< /Type /Outlines /First " + reference(songObject(0)) + " /Last "
+                         + reference(songObject(songCount - 1)) + " /Count " + QByteArray::number(songCount) + " >>");
+    else
+        addObject(4, "<< /Type /Outlines /Count 0 >>");
+
+    for (int page = 0; page < pageCount; ++page)
+    {
+        const int song = page / OUTLINE_SPACING + 1;
+        QByteArray content = "BT /F1 20 Tf 72 780 Td (Song " + QByteArray::number(song) + ") Tj ET\n"
+                             "BT /F1 11 Tf 72 756 Td (Page " + QByteArray::number(page + 1) + " of "
+                             + QByteArray::number(pageCount) + ", measure 1 to 16) Tj ET\n0.6 w\n";
+        for (int staff = 0; staff < 6; ++staff)
+        {
+            for (int line = 0; line < 5; ++line)
+            {
+                const QByteArray y = QByteArray::number(700 - staff * 110 - line * 8);
+                content += "72 " + y + " m 523 " + y + " l S\n";
+            }
+        }
+
+        QByteArray body = "<< /Type /Page /Parent 2 0 R /MediaBox [0 0 595 842]"
+                          " /Resources << /Font << /F1 3 0 R >> >> /Contents "
+                          + reference(pageObject(page) + 1);
+        if (linked)
+            body += " /Annots [" + reference(pageObject(page) + 2) + "]";
+        addObject(pageObject(page), body + " >>");
+        addObject(pageObject(page) + 1, "<< /Length " + QByteArray::number(content.size()) + " >>\nstream\n"
+                                            + content + "endstream");
+        if (linked)
+            addObject(pageObject(page) + 2, "<< /Type /Annot /Subtype /Link /Rect [450 770 523 790] /Border [0 0 0]"
+                                                " /Dest [" + reference(pageObject((page + 1) % pageCount))
+                                                + " /XYZ 0 842 null] >>");
+    }
+
+    for (int song = 0; song < songCount; ++song)
+    {
+        QByteArray body = "<< /Title (Song " + QByteArray::number(song + 1) + ") /Parent 4 0 R /Dest ["
+                          + reference(pageObject(song * OUTLINE_SPACING)) + " /XYZ 0 842 null]";
+        if (song > 0)
+            body += " /Prev " + reference(songObject(song - 1));
+        if (song < songCount - 1)
+            body += " /Next " + reference(songObject(song + 1));
+        addObject(songObject(song), body + " >>");
+    }
+
+    const qint64 xref = pdf.size();
+    pdf += "xref\n0 " + QByteArray::number(objectCount + 1) + "\n0000000000 65535 f \n";
+    for (int number = 1; number <= objectCount; ++number)
+        pdf += QByteArray::number(offsets[number]).rightJustified(10, '0') + " 00000 n \n";
+    pdf += "trailer\n<< /Size " + QByteArray::number(objectCount + 1) + " /Root 1 0 R >>\nstartxref\n"
+           + QByteArray::number(xref) + "\n%%EOF\n";
+
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+    file.write(pdf);
+    return file.commit();
+}
+
+ScalingBenchmark::Sample ScalingBenchmark::measure(QQmlEngine* engine, const QString& fileName,
+                                                   int pageCount, bool linked)
+{
+    Sample sample;
+    sample.pages = pageCount;
+
+    PdfModel model;
+    QQmlEngine::setContextForObject(&model, engine->rootContext());
+
+    const qint64 residentBefore = residentBytes();
+    QElapsedTimer timer;
+    timer.start();
+    QString path = fileName;
+    model.setPath(path);
+    sample.loadMs = elapsedMs(timer);
+    if (!model.getLoaded() || model.getPages().size() != pageCount)
+    {
+        qWarning() << "Benchmark document didn't load:" << fileName;
+        return sample;
+    }
+    const qint64 residentAfter = residentBytes();
+    if (residentBefore >= 0 && residentAfter >= 0)
+        sample.residentBytes = residentAfter - residentBefore;
+
+    // The thumbnail generator would compete with what's measured below for
+    // the CPU, more so on small machines running the whole test suite
+    QString error;
+    if (const std::shared_ptr<SharedDocument> document = DocumentRegistry::acquire(path, &error))
+        document->thumbnails->stop();
+
+    // The first page the way an Image asks for it, the provider is the
+    // image://<name>/<id> part of its URL
+    const QString url = model.getPages().constFirst().toMap().value("image").toString();
+    auto* provider = static_cast<QQuickAsyncImageProvider*>(engine->imageProvider(url.section('/', 2, 2)));
+    if (!provider)
+    {
+        qWarning() << "No image provider for" << url;
+        return sample;
+    }
+
+    bool delivered = false;
+    QEventLoop loop;
+    QTimer::singleShot(FIRST_PAGE_TIMEOUT_MS, &loop, &QEventLoop::quit);
+    timer.restart();
+    std::unique_ptr<QQuickImageResponse> response(provider->requestImageResponse(url.section('/', 3), FIRST_PAGE_SIZE));
+    QObject::connect(response.get(), &QQuickImageResponse::finished, &loop, [&] {
+        delivered = true;
+        loop.quit();
+    });
+    loop.exec();
+    sample.firstPageMs = elapsedMs(timer);
+    if (!delivered)
+    {
+        response->cancel();
+        qWarning() << "First page of" << fileName << "not delivered in" << FIRST_PAGE_TIMEOUT_MS << "ms";
+        return sample;
+    }
+    if (!response->errorString().isEmpty())
+        qWarning() << response->errorString();
+
+    // Every page, the way the search bar looks for the next match
+    timer.restart();
+    int matches = 0;
+    for (int page = 0; page < pageCount; ++page)
+        matches += model.search(page, "measure", Qt::CaseInsensitive).size();
+    sample.searchMs = elapsedMs(timer);
+    if (matches != pageCount)
+        qWarning() << "Search found" << matches << "matches in" << pageCount << "pages";
+
+    // The index is built in the background, wait for it
+    if (linked)
+    {
+        if (model.getSongCount() == 0)
+        {
+            QEventLoop indexLoop;
+            QTimer::singleShot(SONG_INDEX_TIMEOUT_MS, &indexLoop, &QEventLoop::quit);
+            QObject::connect(&model, &PdfModel::songIndexChanged, &indexLoop, &QEventLoop::quit);
+            indexLoop.exec();
+        }
+        if (model.getSongCount() == 0)
+        {
+            qWarning() << "Song index of" << fileName << "not built in" << SONG_INDEX_TIMEOUT_MS << "ms";
+            return sample;
+        }
+        // Misspelled, as typed on stage, so it takes the fuzzy path
+        const int lastSong = (pageCount - 1) / OUTLINE_SPACING + 1;
+        timer.restart();
+        model.findSongs("Sogn " + QString::number(lastSong));
+        sample.songSearchMs = elapsedMs(timer);
+    }
+
+    sample.ok = true;
+    return sample;
+}
+
+bool ScalingBenchmark::checkScaling(const QString& series, const QList<Sample>& samples)
+{
+    QTextStream out(stdout);
+    bool ok = true;
+    for (qsizetype i = 1; i < samples.size(); ++i)
+    {
+        const Sample& from = samples[i - 1];
+        const Sample& to = samples[i];
+        const double size = std::log(double(to.pages) / from.pages);
+        const QString step = series + ' ' + QString::number(from.pages) + " to " + QString::number(to.pages);
+        const auto check = [&](const char* name, double before, double after, double floor) {
+            if (after < floor || before <= 0)
+            {
+                out << step << ' ' << name << ": below the noise floor, not checked\n";
+                return;
+            }
+            // A measurement under the floor is noise, the slope is taken from the floor
+            const double slope = std::log(after / qMax(before, floor)) / size;
+            const bool linear = slope <= MAX_SLOPE;
+            out << step << ' ' << name << ": slope " << QString::number(slope, 'f', 2)
+                << (linear ? "" : " FAILED, grows faster than the page count") << '\n';
+            ok = ok && linear;
+        };
+
+        check("load", from.loadMs, to.loadMs, NOISE_FLOOR_MS);
+        if (from.residentBytes >= 0 && to.residentBytes >= 0)
+            check("memory", from.residentBytes, to.residentBytes, NOISE_FLOOR_BYTES);
+        check("first page", from.firstPageMs, to.firstPageMs, NOISE_FLOOR_MS);
+        check("search", from.searchMs, to.searchMs, NOISE_FLOOR_MS);
+        check("song search", from.songSearchMs, to.songSearchMs, NOISE_FLOOR_MS);
+    }
+    return ok;
+}
+
+bool ScalingBenchmark::checkSongSearch()
+{
+    // Titles like a fake book's, built from a few word lists so that many
+    // of them share words and prefixes
+    static const char* const FIRST[] = {"All", "Autumn", "Blue", "Body", "Days", "Fly", "Georgia",
+                                        "Just", "Lady", "Love", "Moon", "My", "Night", "Round",
+                                        "Stella", "Summer", "Sweet", "Take", "There", "What"};
+    static const char* const SECOND[] = {"and", "by", "for", "in", "is", "of", "on", "to", "with", "without"};
+    static const char* const THIRD[] = {"Blues", "Dreams", "Heart", "Love", "Me", "Midnight", "Rain",
+                                        "Soul", "Starlight", "Sunday", "the Moon", "You"};
+    QList<OutlineEntry> outline;
+    for (int i = 0; i < SONG_SEARCH_TITLES; ++i)
+    {
+        OutlineEntry entry;
+        entry.title = QString(FIRST[i % std::size(FIRST)]) + ' ' + SECOND[i / std::size(FIRST) % std::size(SECOND)]
+                      + ' ' + THIRD[i / 7 % std::size(THIRD)];
+        if (i >= int(std::size(FIRST) * std::size(SECOND)))
+            entry.title += ' ' + QString::number(i);
+        entry.page = i;
+        outline.append(entry);
+    }
+    SongIndex index;
+    index.build(outline);
+
+    // Misspelled, a key at a time, with the limit the search field uses
+    const QString query = "Stela by Starlihgt";
+    double worstMs = 0;
+    for (qsizetype length = 1; length <= query.size(); ++length)
+    {
+        double fastestMs = std::numeric_limits<double>::max();
+        for (int run = 0; run < SONG_SEARCH_RUNS; ++run)
+        {
+            QElapsedTimer timer;
+            timer.start();
+            index.search(query.left(length), 20);
+            fastestMs = qMin(fastestMs, elapsedMs(timer));
+        }
+        worstMs = qMax(worstMs, fastestMs);
+    }
+
+    const bool fast = worstMs <= MAX_SONG_SEARCH_MS;
+    QTextStream out(stdout);
+    out << "
+song search in " << index.size() << " titles: slowest key " << QString::number(worstMs, 'f', 3)
+        << " ms" << (fast ? "" : " FAILED, slower than typing") << '\n';
+    return fast;
+}
+
+int ScalingBenchmark::run(const QStringList& arguments)
+{
+    QList<int> sizes = DEFAULT_SIZES;
+    const int pagesArgument = arguments.indexOf("--pages");
+    if (pagesArgument >= 0 && pagesArgument + 1 < arguments.size())
+    {
+        sizes.clear();
+        for (const QString& size : arguments[pagesArgument + 1].split(',', Qt::SkipEmptyParts))
+        {
+            if (size.toInt() > 0)
+                sizes.append(size.toInt());
+        }
+        std::sort(sizes.begin(), sizes.end());
+        sizes.erase(std::unique(sizes.begin(), sizes.end()), sizes.end());
+    }
+
+    // Sidecars and thumbnails of the synthetic documents don't belong in
+    // the user's cache
+    QStandardPaths::setTestModeEnabled(true);
+
+    QTemporaryDir directory;
+    if (!directory.isValid())
+    {
+        qWarning() << "Can't create a folder for the benchmark documents";
+        return 1;
+    }
+
+    QQmlEngine engine;
+    QTextStream out(stdout);
+    bool ok = true;
+    for (const bool linked : {false, true})
+    {
+        const QString series = linked ? "linked" : "plain";
+        out << "\n" << series << " documents\n"
+            << "pages\tload ms\tRSS KiB\tfirst page ms\tsearch ms\tsong search ms\n";
+        out.flush();
+
+        QList<Sample> samples;
+        for (int pageCount : std::as_const(sizes))
+        {
+            const QString fileName = directory.filePath(series + "-" + QString::number(pageCount) + ".pdf");
+            if (!writeDocument(fileName, pageCount, linked))
+            {
+                qWarning() << "Can't write" << fileName;
+                return 1;
+            }
+
+            const Sample sample = measure(&engine, fileName, pageCount, linked);
+            if (!sample.ok)
+                return 1;
+            samples.append(sample);
+            out << sample.pages << '\t' << QString::number(sample.loadMs, 'f', 1) << '\t'
+                << (sample.residentBytes >= 0 ? QString::number(sample.residentBytes / 1024) : QString("-")) << '\t'
+                << QString::number(sample.firstPageMs, 'f', 1) << '\t' << QString::number(sample.searchMs, 'f', 2)
+                << '\t' << QString::number(sample.songSearchMs, 'f', 2) << '\n';
+            out.flush();
+        }
+        ok = checkScaling(series, samples) && ok;
+    }
+
+    ok = checkSongSearch() && ok;
+
+    out << (ok ? "\nScaling is linear or better, song search keeps up with typing\n"
+              : "\nScaling or song search check failed\n");
+    return ok ? 0 : 1;
+}
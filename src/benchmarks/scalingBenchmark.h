@@ -0,0 +1,60 @@
+// scalingBenchmark.h
+#ifndef SCALINGBENCHMARK_H
+#define SCALINGBENCHMARK_H
+
+#include <QList>
+#include <QString>
+#include <QStringList>
+
+class QQmlEngine;
+
+// How document handling scales with the page count, the benchmarkScaling
+// executable (and its ctest, with small documents). Synthetic documents of
+// growing size are written to a temporary folder, plain and with a link
+// on every page and an outline entry every few pages like a compilation,
+// and opened through PdfModel the way the view does, with the thumbnail
+// generator stopped so it doesn't skew the timings. For each it measures
+// the load (setPath), resident memory added by it, the first page image
+// delivered by the image provider, a text search through every page and
+// a song lookup in the outline.
+//
+// Exits non-zero when any of them grows faster than linearly between two
+// consecutive sizes (log-log slope above MAX_SLOPE), so it can gate a
+// change that makes large compilations slow again. It also checks that
+// the song search keeps up with typing: a misspelled title typed one key
+// at a time into an index of SONG_SEARCH_TITLES titles has to answer every
+// key within MAX_SONG_SEARCH_MS.
+class ScalingBenchmark
+{
+public:
+    static int run(const QStringList& arguments);
+
+    // A minimal PDF: a font, a few lines of text and staff lines per page,
+    // optionally a link to the next page on every page and an outline entry
+    // every OUTLINE_SPACING pages
+    static bool writeDocument(const QString& fileName, int pageCount, bool linked);
+
+    static const QList<int> DEFAULT_SIZES;
+    static constexpr double MAX_SLOPE = 1.2;
+    static const int OUTLINE_SPACING = 4;
+    static const int SONG_SEARCH_TITLES = 5000;
+    static constexpr double MAX_SONG_SEARCH_MS = 1.0;
+
+private:
+    struct Sample
+    {
+        int pages = 0;
+        double loadMs = 0;
+        qint64 residentBytes = -1;
+        double firstPageMs = 0;
+        double searchMs = 0;
+        double songSearchMs = 0;
+        bool ok = false;
+    };
+
+    static Sample measure(QQmlEngine* engine, const QString& fileName, int pageCount, bool linked);
+    static bool checkScaling(const QString& series, const QList<Sample>& samples);
+    static bool checkSongSearch();
+};
+
+#endif // SCALINGBENCHMARK_H
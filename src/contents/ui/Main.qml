@@ -16,11 +16,75 @@ Kirigami.ApplicationWindow {
 
     property bool pdfLoaded: false
     property real zoomValue: 100  // Add this property
-    property int viewMode: 0  // 0: Scroll, 1: Single Page, 2: Book View
+    property int viewMode: 0  // 0: Scroll, 1: Single Page, 2: Book View, 3: Half Page Turns
+    property bool showOverview: false
+    property bool showFrameStats: false
+    property bool showMetrics: false
+
+    // Session restore, the document is already loading (see main.cpp)
+    Component.onCompleted: {
+        if (settings.autoOpenLast && settings.lastDocument !== "") {
+            root.viewMode = settings.lastViewMode
+            root.zoomValue = settings.lastZoom
+            pdfView.zoom = settings.lastZoom / 100
+            pdfView.renderZoom = pdfView.zoom
+            pdfView.path = settings.lastDocument
+            if (pdfView.loaded) {
+                root.pdfLoaded = true
+                Qt.callLater(pdfView.goToPage, settings.lastPage)
+            }
+        }
+    }
+
+    // Remembered for the next launch once they stop changing, every
+    // setting written is a sync to disk and a pinch changes zoom per frame
+    onZoomValueChanged: sessionSaveTimer.restart()
+    onViewModeChanged: sessionSaveTimer.restart()
+    Connections {
+        target: pdfView
+        function onCurrentPageChanged() { sessionSaveTimer.restart() }
+    }
+    Timer {
+        id: sessionSaveTimer
+        interval: 1000
+        onTriggered: {
+            settings.lastZoom = Math.round(root.zoomValue)
+            settings.lastViewMode = root.viewMode
+            if (root.pdfLoaded)
+                settings.lastPage = pdfView.currentPage
+        }
+    }
+    onClosing: {
+        if (sessionSaveTimer.running) {
+            sessionSaveTimer.stop()
+            sessionSaveTimer.triggered()
+        }
+    }
+    function openDocument(path, page) {
+        pdfView.path = path
+        root.pdfLoaded = true
+        settings.lastDocument = path
+        settings.lastPage = page
+        if (page > 0)
+            Qt.callLater(pdfView.goToPage, page)
+        console.log("Loading PDF:", path)
+    }
+
+    Binding {
+        target: library
+        property: "folders"
+        value: settings.libraryFolders
+    }
+
     pageStack.initialPage: Kirigami.Page {
         id: mainPage
         padding: 0
         actions: [
+            Kirigami.Action {
+                icon.name: "folder-library"
+                text: i18n("Library")
+                onTriggered: libraryBrowser.open()
+            },
             Kirigami.Action {
                 icon.name: "configure"
                 text: i18n("Settings")
@@ -32,13 +96,20 @@ Kirigami.ApplicationWindow {
             id: pdfView
             anchors.fill: parent
             visible: root.pdfLoaded
-            property real rotation: 0
             clip:true
-            transform: Rotation {
-                angle: pdfView.rotation
-                origin.x: pdfView.width/2
-                origin.y: pdfView.height/2
-            }
+            renderMode: settings.renderMode
+            invertColors: settings.nightMode
+            contrast: settings.contrastBoost
+            trimMargins: settings.trimMargins
+            autoTuneRendering: settings.autoTuneRendering
+            clock: midiClient
+            autoScroll: settings.autoScrollEnabled
+            barsPerPage: settings.barsPerPage
+            beatsPerBar: settings.beatsPerBar
+            expression: midiClient
+            expressionMode: settings.expressionMode
+            expressionSpeed: settings.expressionSpeed
+            profiler: frameProfiler
             // add: Transition {
             //     NumberAnimation { properties: "x"; from: isHorizontal ? width : 0; duration: 200 }
             // }
@@ -52,6 +123,67 @@ Kirigami.ApplicationWindow {
             }
         }
 
+        // Page overview
+        Rectangle {
+            id: overviewPanel
+            anchors {
+                left: parent.left
+                top: parent.top
+                bottom: parent.bottom
+            }
+            width: Kirigami.Units.gridUnit * 7
+            visible: root.pdfLoaded && root.showOverview
+            z: 50
+            color: Kirigami.Theme.backgroundColor
+
+            OverviewStrip {
+                anchors.fill: parent
+                pages: pdfView.poppler.pages
+                currentPage: pdfView.currentPage
+                onPageSelected: function(page) {
+                    pdfView.goToPage(page)
+                }
+            }
+        }
+
+        FrameStats {
+            anchors {
+                top: parent.top
+                right: parent.right
+                margins: Kirigami.Units.largeSpacing
+            }
+            z: 200
+            visible: root.showFrameStats
+            profiler: frameProfiler
+        }
+
+        MetricsOverlay {
+            anchors {
+                top: parent.top
+                left: parent.left
+                margins: Kirigami.Units.largeSpacing
+            }
+            z: 200
+            visible: root.showMetrics
+            registry: metrics
+        }
+
+        LibraryBrowser {
+            id: libraryBrowser
+            libraryIndex: library
+            onDocumentSelected: function(path, page) {
+                root.openDocument(path, page)
+            }
+        }
+
+        SongSearch {
+            id: songSearch
+            poppler: pdfView.poppler
+            onSongSelected: function(page) {
+                pdfView.goToPage(page)
+            }
+        }
+
         // Floating Toolbar
         KirigamiAddons.FloatingToolBar {
             id: toolBar
@@ -76,6 +208,16 @@ Kirigami.ApplicationWindow {
 
                     Kirigami.Action { separator: true },
 
+                    Kirigami.Action {
+                        icon.name: "view-preview"
+                        text: i18n("Overview")
+                        displayHint: Kirigami.DisplayHint.IconOnly
+                        tooltip: i18n("Show Page Overview")
+                        checkable: true
+                        checked: root.showOverview
+                        onTriggered: root.showOverview = checked
+                    },
+
                     // Navigation
                     Kirigami.Action {
                         icon.name: "go-first"
@@ -194,14 +336,14 @@ Kirigami.ApplicationWindow {
                         text: i18n("Rotate Left")
                         displayHint: Kirigami.DisplayHint.IconOnly
                         tooltip: i18n("Rotate Left 90°")
-                        onTriggered: pdfView.rotation = (pdfView.rotation - 90) % 360
+                        onTriggered: pdfView.pageRotation = (pdfView.pageRotation + 270) % 360
                     },
                     Kirigami.Action {
                         icon.name: "object-rotate-right"
                         text: i18n("Rotate Right")
                         displayHint: Kirigami.DisplayHint.IconOnly
                         tooltip: i18n("Rotate Right 90°")
-                        onTriggered: pdfView.rotation = (pdfView.rotation + 90) % 360
+                        onTriggered: pdfView.pageRotation = (pdfView.pageRotation + 90) % 360
                     },
 
                     Kirigami.Action { separator: true },
@@ -235,9 +377,44 @@ Kirigami.ApplicationWindow {
                                 checkable: true
                                 checked: root.viewMode === 2
                                 onTriggered: root.viewMode = 2
+                            },
+                            Kirigami.Action {
+                                icon.name: "view-split-top-bottom"
+                                text: i18n("Half Page Turns")
+                                checkable: true
+                                checked: root.viewMode === 3
+                                onTriggered: root.viewMode = 3
                             }
                         ]
                     },
+                    Kirigami.Action {
+                        icon.name: "media-playback-start"
+                        text: i18n("Follow MIDI Clock")
+                        displayHint: Kirigami.DisplayHint.IconOnly
+                        tooltip: midiClient.clockRunning ?
+                                     i18n("Auto-scroll with MIDI clock (%1 BPM)", midiClient.tempo) :
+                                     i18n("Auto-scroll with MIDI clock")
+                        checkable: true
+                        checked: settings.autoScrollEnabled
+                        onTriggered: settings.autoScrollEnabled = checked
+                    },
+                    Kirigami.Action {
+                        icon.name: "weather-clear-night"
+                        text: i18n("Night Mode")
+                        displayHint: Kirigami.DisplayHint.IconOnly
+                        tooltip: i18n("Show pages light on dark")
+                        checkable: true
+                        checked: settings.nightMode
+                        onTriggered: settings.nightMode = checked
+                    },
+                    Kirigami.Action {
+                        icon.name: "view-media-playlist"
+                        text: i18n("Songs")
+                        displayHint: Kirigami.DisplayHint.IconOnly
+                        tooltip: i18n("Jump to Song")
+                        visible: pdfView.poppler.songCount > 0
+                        onTriggered: songSearch.open()
+                    },
                     // Search
                     Kirigami.Action {
                         displayComponent: QQC2.TextField {
@@ -285,9 +462,7 @@ Kirigami.ApplicationWindow {
             var path = selectedFile.toString()
             path = path.replace(/^(file:\/{2})/,"")
             path = decodeURIComponent(path)
-            pdfView.path = path
-            root.pdfLoaded = true
-            console.log("Loading PDF:", path)
+            root.openDocument(path, 0)
         }
     }
 
@@ -297,6 +472,32 @@ Kirigami.ApplicationWindow {
         onActivated: fileDialog.open()
     }
 
+    // Frame profiler: live view and dump to a file
+    Shortcut {
+        sequence: "Ctrl+Shift+F"
+        onActivated: root.showFrameStats = !root.showFrameStats
+    }
+
+    Shortcut {
+        sequence: "Ctrl+Shift+D"
+        onActivated: {
+            var file = frameProfiler.dump()
+            showPassiveNotification(file !== "" ? i18n("Frame profile saved to %1", file) :
+                                                  i18n("Failed to save the frame profile"))
+        }
+    }
+
+    // Runtime metrics, also logged to a file while the app runs
+    Shortcut {
+        sequence: "Ctrl+Shift+M"
+        onActivated: root.showMetrics = !root.showMetrics
+    }
+
+    Shortcut {
+        sequence: "Ctrl+L"
+        onActivated: libraryBrowser.open()
+    }
+
     Shortcut {
         sequence: StandardKey.ZoomIn
         onActivated: zoomSpinBox.value = Math.min(zoomSpinBox.value + zoomSpinBox.stepSize, zoomSpinBox.to)
@@ -312,6 +513,12 @@ Kirigami.ApplicationWindow {
         onActivated: zoomSpinBox.value = 100
     }
 
+    Shortcut {
+        sequence: "Ctrl+J"
+        enabled: pdfView.poppler.songCount > 0
+        onActivated: songSearch.open()
+    }
+
     Shortcut {
         sequence: StandardKey.Find
         onActivated: searchField.forceActiveFocus()
@@ -335,6 +542,11 @@ Kirigami.ApplicationWindow {
             pdfView.goToPreviousPage()
         }
     }
+    Binding {
+        target: midiClient
+        property: "expressionControl"
+        value: settings.expressionMode > 0 ? settings.expressionControl : -1
+    }
     KirigamiSettings.ConfigurationView {
         id: settingsView
 
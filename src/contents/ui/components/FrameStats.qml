@@ -0,0 +1,57 @@
+import QtQuick
+import QtQuick.Layouts
+import QtQuick.Controls as QQC2
+import org.kde.kirigami as Kirigami
+
+// Live frame timings from the frame profiler, with the last page turn
+// or scroll it recorded
+Rectangle {
+    id: frameStats
+
+    property var profiler
+    readonly property var summary: profiler ? profiler.summary : ({})
+    readonly property var lastSpan: summary.lastSpan || ({})
+
+    implicitWidth: layout.implicitWidth + Kirigami.Units.largeSpacing * 2
+    implicitHeight: layout.implicitHeight + Kirigami.Units.largeSpacing * 2
+    radius: Kirigami.Units.smallSpacing
+    color: Qt.rgba(0, 0, 0, 0.7)
+
+    onVisibleChanged: if (profiler) profiler.live = visible
+    Component.onCompleted: if (profiler) profiler.live = visible
+
+    ColumnLayout {
+        id: layout
+        anchors.centerIn: parent
+        spacing: 0
+
+        QQC2.Label {
+            color: "white"
+            font.family: "monospace"
+            text: i18n("%1 fps @ %2 Hz, worst %3 ms, %4 missed",
+                       frameStats.summary.fps || 0, frameStats.summary.refreshHz || 0,
+                       (frameStats.summary.worstFrameMs || 0).toFixed(1), frameStats.summary.missed || 0)
+        }
+        QQC2.Label {
+            color: "white"
+            font.family: "monospace"
+            text: i18n("GUI %1  sync %2  render %3  swap %4 ms",
+                       (frameStats.summary.animateMs || 0).toFixed(1), (frameStats.summary.syncMs || 0).toFixed(1),
+                       (frameStats.summary.renderMs || 0).toFixed(1), (frameStats.summary.swapMs || 0).toFixed(1))
+        }
+        QQC2.Label {
+            color: "white"
+            font.family: "monospace"
+            visible: frameStats.lastSpan.kind !== undefined
+            text: i18n("Last %1: %2 frames, %3 missed, worst %4 ms, %5 uploads (%6 KiB)",
+                       frameStats.lastSpan.kind, frameStats.lastSpan.frames, frameStats.lastSpan.missed,
+                       (frameStats.lastSpan.worstFrameMs || 0).toFixed(1), frameStats.lastSpan.uploads,
+                       frameStats.lastSpan.uploadKiB)
+        }
+        QQC2.Label {
+            color: "white"
+            font.family: "monospace"
+            text: i18n("%1 vsyncs missed in %2 animations", frameStats.summary.spanMissed || 0, frameStats.summary.spans || 0)
+        }
+    }
+}
@@ -0,0 +1,131 @@
+import QtQuick
+
+// Half-page turns, for reading ahead: from page p, the first turn
+// replaces the top half, already played, with the top of page p + 1 while
+// the bottom of p stays; the second turn completes it to page p + 1.
+//
+// Each state is composited from the page rasters the rest of the view
+// uses, every half is a PageImage clipped to it, so a state needs no
+// rendering of its own. Three states are kept loaded and in the scene
+// graph, the one on screen on top and the ones a turn away either way
+// below it; a turn only changes which one is on top. The hidden ones are
+// nearly, not fully, transparent: the renderer skips a subtree at zero
+// opacity and would only upload its textures on the turn.
+Item {
+    id: halfTurnView
+
+    property var pages: []
+    property real zoom: 1.0
+    property real renderZoom: zoom
+    property bool trimmed: false
+    // 2p: page p, 2p + 1: top of p + 1 over the bottom of p
+    property int step: 0
+    readonly property int maxStep: Math.max(0, pages.length * 2 - 2)
+    // The page being read, its bottom half is still on screen
+    readonly property int currentPage: Math.floor(step / 2)
+
+    // Low enough not to show around a narrower page on top
+    readonly property real hiddenOpacity: 0.01
+
+    signal turned()
+
+    // A new document, or a reloaded one with fewer pages
+    onMaxStepChanged: if (step > maxStep) step = maxStep
+
+    function next() {
+        if (step < maxStep) {
+            step++
+            turned()
+        }
+    }
+
+    function previous() {
+        if (step > 0) {
+            step--
+            turned()
+        }
+    }
+
+    function goToPage(page) {
+        step = Math.max(0, Math.min(page * 2, maxStep))
+    }
+
+    TapHandler {
+        onTapped: function(eventPoint) {
+            if (eventPoint.position.x >= halfTurnView.width / 2)
+                halfTurnView.next()
+            else
+                halfTurnView.previous()
+        }
+    }
+
+    // State i holds the step that is i modulo 3 around the current one, so
+    // a turn forward leaves two of them as they are and reloads the third
+    // with the step after the new one
+    Repeater {
+        model: 3
+        delegate: Item {
+            id: composite
+
+            readonly property int offset: ((index - halfTurnView.step) % 3 + 3) % 3
+            readonly property int compositeStep: halfTurnView.step + (offset === 2 ? -1 : offset)
+            readonly property bool valid: halfTurnView.pages.length > 0 &&
+                                          compositeStep >= 0 && compositeStep <= halfTurnView.maxStep
+            readonly property int bottomPage: Math.floor(compositeStep / 2)
+            readonly property int topPage: bottomPage + compositeStep % 2
+
+            anchors.fill: parent
+            visible: valid
+            opacity: offset === 0 ? 1 : halfTurnView.hiddenOpacity
+            z: offset === 0 ? 1 : 0
+
+            Item {
+                id: topHalf
+                anchors.horizontalCenter: parent.horizontalCenter
+                width: topImage.width
+                height: Math.round(topImage.height / 2)
+                clip: true
+
+                PageImage {
+                    id: topImage
+                    readonly property var pageData: composite.valid ? halfTurnView.pages[composite.topPage] : null
+                    pageSize: pageData ? pageData.size : Qt.size(0, 0)
+                    zoom: halfTurnView.zoom
+                    renderZoom: halfTurnView.renderZoom
+                    trimmed: halfTurnView.trimmed
+                    source: pageData ? pageData.image : ""
+                }
+            }
+
+            Item {
+                id: bottomHalf
+                anchors.horizontalCenter: parent.horizontalCenter
+                y: topHalf.height
+                width: bottomImage.width
+                height: bottomImage.height - Math.round(bottomImage.height / 2)
+                clip: true
+
+                PageImage {
+                    id: bottomImage
+                    y: -Math.round(height / 2)
+                    readonly property var pageData: composite.valid ? halfTurnView.pages[composite.bottomPage] : null
+                    pageSize: pageData ? pageData.size : Qt.size(0, 0)
+                    zoom: halfTurnView.zoom
+                    renderZoom: halfTurnView.renderZoom
+                    trimmed: halfTurnView.trimmed
+                    source: pageData ? pageData.image : ""
+                }
+            }
+
+            // Where the next page ends
+            Rectangle {
+                visible: composite.topPage !== composite.bottomPage
+                anchors.horizontalCenter: parent.horizontalCenter
+                y: topHalf.height - 1
+                width: Math.max(topHalf.width, bottomHalf.width)
+                height: 2
+                color: Qt.rgba(0, 0, 0, 0.4)
+            }
+        }
+    }
+}
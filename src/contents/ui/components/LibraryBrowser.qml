@@ -0,0 +1,136 @@
+import QtQuick
+import QtQuick.Layouts
+import QtQuick.Controls as QQC2
+import org.kde.kirigami as Kirigami
+
+// Finds a chart in the library folders by file name, title or song,
+// filtered as-you-type; the whole library by title without a query
+QQC2.Popup {
+    id: libraryBrowser
+
+    property var libraryIndex
+    property var results: []
+
+    signal documentSelected(string path, int page)
+
+    modal: true
+    focus: true
+    padding: Kirigami.Units.largeSpacing
+    width: Math.min(parent.width - Kirigami.Units.gridUnit * 2, Kirigami.Units.gridUnit * 36)
+    height: Math.min(parent.height - Kirigami.Units.gridUnit * 2, Kirigami.Units.gridUnit * 30)
+    x: Math.round((parent.width - width) / 2)
+    y: Kirigami.Units.gridUnit
+
+    onOpened: {
+        queryField.text = ""
+        __update()
+        queryField.forceActiveFocus()
+    }
+
+    // New documents found while the browser is open
+    Connections {
+        target: libraryBrowser.libraryIndex
+        function onDocumentsChanged() {
+            if (libraryBrowser.opened)
+                libraryBrowser.__update()
+        }
+    }
+
+    function __update() {
+        if (!libraryIndex) {
+            results = []
+        } else if (queryField.text.length > 0) {
+            results = libraryIndex.search(queryField.text, 50)
+        } else {
+            results = libraryIndex.documents()
+        }
+        resultsView.currentIndex = 0
+    }
+
+    function __select(index) {
+        if (index < 0 || index >= results.length) return
+        documentSelected(results[index].path, results[index].page)
+        close()
+    }
+
+    contentItem: ColumnLayout {
+        spacing: Kirigami.Units.smallSpacing
+
+        Kirigami.SearchField {
+            id: queryField
+            Layout.fillWidth: true
+            placeholderText: i18n("Search %1 documents...", libraryBrowser.libraryIndex ? libraryBrowser.libraryIndex.documentCount : 0)
+            onTextChanged: libraryBrowser.__update()
+            onAccepted: libraryBrowser.__select(resultsView.currentIndex)
+            Keys.onDownPressed: resultsView.incrementCurrentIndex()
+            Keys.onUpPressed: resultsView.decrementCurrentIndex()
+        }
+
+        QQC2.Label {
+            Layout.fillWidth: true
+            visible: libraryBrowser.libraryIndex && libraryBrowser.libraryIndex.scanning
+            text: i18n("Scanning library, %1 files left...", libraryBrowser.libraryIndex ? libraryBrowser.libraryIndex.pendingFiles : 0)
+            opacity: 0.7
+        }
+
+        ListView {
+            id: resultsView
+            Layout.fillWidth: true
+            Layout.fillHeight: true
+            clip: true
+            model: libraryBrowser.results
+            highlightMoveDuration: 0
+            reuseItems: true
+
+            delegate: QQC2.ItemDelegate {
+                id: resultDelegate
+                width: ListView.view.width
+                highlighted: ListView.isCurrentItem
+                onClicked: libraryBrowser.__select(index)
+
+                contentItem: RowLayout {
+                    spacing: Kirigami.Units.largeSpacing
+
+                    Image {
+                        Layout.preferredWidth: Kirigami.Units.gridUnit * 2
+                        Layout.preferredHeight: Kirigami.Units.gridUnit * 2.5
+                        source: modelData.thumbnail
+                        sourceSize.width: Kirigami.Units.gridUnit * 2
+                        fillMode: Image.PreserveAspectFit
+                        asynchronous: true
+                    }
+
+                    ColumnLayout {
+                        Layout.fillWidth: true
+                        spacing: 0
+
+                        QQC2.Label {
+                            Layout.fillWidth: true
+                            text: modelData.song !== "" ? modelData.song : modelData.title
+                            elide: Text.ElideRight
+                        }
+                        QQC2.Label {
+                            Layout.fillWidth: true
+                            text: modelData.song !== "" ?
+                                      i18n("%1, p. %2", modelData.title, modelData.page + 1) :
+                                      i18np("%1 page", "%1 pages", modelData.pageCount)
+                            elide: Text.ElideMiddle
+                            font: Kirigami.Theme.smallFont
+                            opacity: 0.7
+                        }
+                    }
+                }
+            }
+
+            Kirigami.PlaceholderMessage {
+                anchors.centerIn: parent
+                width: parent.width - Kirigami.Units.largeSpacing * 4
+                visible: resultsView.count === 0
+                text: queryField.text.length > 0 ? i18n("No matching documents") :
+                      libraryBrowser.libraryIndex && libraryBrowser.libraryIndex.folders.length > 0 ?
+                          i18n("No PDF files found in the library folders") :
+                          i18n("Add library folders in the settings")
+            }
+        }
+    }
+}
@@ -0,0 +1,68 @@
+import QtQuick
+import QtQuick.Layouts
+import QtQuick.Controls as QQC2
+import org.kde.kirigami as Kirigami
+
+// Live counters and gauges from the metrics registry: rendering, cache,
+// document loads, MIDI traffic and settings writes
+Rectangle {
+    id: metricsOverlay
+
+    property var registry
+    readonly property var values: registry ? registry.values : ({})
+
+    function __mib(bytes) {
+        return ((bytes || 0) / (1024 * 1024)).toFixed(1)
+    }
+
+    function __rate(name) {
+        return (values[name + ".perSecond"] || 0).toFixed(1)
+    }
+
+    implicitWidth: layout.implicitWidth + Kirigami.Units.largeSpacing * 2
+    implicitHeight: layout.implicitHeight + Kirigami.Units.largeSpacing * 2
+    radius: Kirigami.Units.smallSpacing
+    color: Qt.rgba(0, 0, 0, 0.7)
+
+    onVisibleChanged: if (registry) registry.live = visible
+    Component.onCompleted: if (registry) registry.live = visible
+
+    ColumnLayout {
+        id: layout
+        anchors.centerIn: parent
+        spacing: 0
+
+        QQC2.Label {
+            color: "white"
+            font.family: "monospace"
+            text: i18n("Renders: %1 in flight, %2 queued, %3/s",
+                       metricsOverlay.values["render.inFlight"] || 0, metricsOverlay.values["render.queueDepth"] || 0,
+                       metricsOverlay.__rate("render.completed"))
+        }
+        QQC2.Label {
+            color: "white"
+            font.family: "monospace"
+            text: i18n("Cache: %1 MiB, %2% hits",
+                       metricsOverlay.__mib(metricsOverlay.values["cache.bytes"]),
+                       Math.round((metricsOverlay.values["cache.hitRate"] || 0) * 100))
+        }
+        QQC2.Label {
+            color: "white"
+            font.family: "monospace"
+            text: i18n("Documents: %1 loaded, last in %2 ms",
+                       metricsOverlay.values["document.loads"] || 0, metricsOverlay.values["document.lastLoadMs"] || 0)
+        }
+        QQC2.Label {
+            color: "white"
+            font.family: "monospace"
+            text: i18n("MIDI: %1 events/s, %2 overflows, %3 dropped, %4 late",
+                       metricsOverlay.__rate("midi.events"), metricsOverlay.values["midi.pendingOverflows"] || 0,
+                       metricsOverlay.values["midi.outputDropped"] || 0, metricsOverlay.values["midi.outputLate"] || 0)
+        }
+        QQC2.Label {
+            color: "white"
+            font.family: "monospace"
+            text: i18n("Settings: %1 writes", metricsOverlay.values["settings.flushes"] || 0)
+        }
+    }
+}
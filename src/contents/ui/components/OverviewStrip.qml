@@ -0,0 +1,51 @@
+import QtQuick
+import QtQuick.Controls as QQC2
+import org.kde.kirigami as Kirigami
+
+// Scrollable strip of page thumbnails, for getting around long documents
+// in one glance and one tap
+ListView {
+    id: strip
+
+    property var pages: []
+    property int currentPage: 0
+
+    signal pageSelected(int page)
+
+    clip: true
+    spacing: Kirigami.Units.smallSpacing
+    model: pages.length
+    currentIndex: currentPage
+    highlightFollowsCurrentItem: true
+    highlightMoveDuration: 0
+    cacheBuffer: height
+
+    QQC2.ScrollBar.vertical: QQC2.ScrollBar {}
+
+    delegate: QQC2.ItemDelegate {
+        id: thumbnailDelegate
+        width: ListView.view.width
+        highlighted: index === strip.currentPage
+        padding: Kirigami.Units.smallSpacing
+
+        contentItem: Column {
+            spacing: Kirigami.Units.smallSpacing
+
+            Image {
+                anchors.horizontalCenter: parent.horizontalCenter
+                width: 80
+                height: 104
+                fillMode: Image.PreserveAspectFit
+                asynchronous: true
+                source: strip.pages[index] ? strip.pages[index].thumbnail : ""
+            }
+
+            QQC2.Label {
+                anchors.horizontalCenter: parent.horizontalCenter
+                text: index + 1
+            }
+        }
+
+        onClicked: strip.pageSelected(index)
+    }
+}
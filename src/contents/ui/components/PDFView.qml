@@ -1,4 +1,4 @@
-import QtQuick 2.9
+import QtQuick
 import com.SpiritMusic.Poppler 1.0
 
 ListView {
@@ -7,7 +7,18 @@ ListView {
     property alias path: poppler.path
     property alias loaded: poppler.loaded
     property real zoom: 1.0
+    // Zoom the pages are rasterized at. Lags behind zoom until zooming
+    // settles, meanwhile the existing rasters are scaled on the GPU.
+    property real renderZoom: 1.0
+    property int zoomSettleDelay: 250
     property alias poppler: poppler
+    property alias renderMode: poppler.renderMode
+    property alias invertColors: poppler.invertColors
+    property alias contrast: poppler.contrast
+    property alias trimMargins: poppler.trimMargins
+    property alias autoTuneRendering: poppler.autoTuneRendering
+    // Clockwise, in degrees. Applied by the renderer, not by transforming the view.
+    property alias pageRotation: poppler.rotation
     property int count: poppler.pages.length
     property int currentPage: currentIndex
     property color searchHighlightColor: Qt.rgba(1, 1, .2, .4)
@@ -20,8 +31,25 @@ ListView {
     property int viewMode: root.viewMode
     property bool isHorizontal: viewMode > 0
     property bool isBookMode: viewMode === 2
+    // Pages turned half at a time, shown by halfTurnView instead of the list
+    property bool isHalfTurn: viewMode === 3
     property bool animatingScroll: false
     property int scrollDuration: 200
+    // MIDI clock following: the view advances one page every
+    // barsPerPage * beatsPerBar beats while the clock is running
+    property var clock: null
+    property bool autoScroll: false
+    property int barsPerPage: 8
+    property int beatsPerBar: 4
+    readonly property bool autoScrolling: autoScroll && clock !== null && clock.clockRunning && poppler.loaded
+    // Expression pedal: 0 off, 1 pedal sets the position in the document,
+    // 2 pedal sets the scroll speed (expressionSpeed % of the view height per second)
+    property var expression: null
+    property int expressionMode: 0
+    property int expressionSpeed: 50
+    readonly property bool expressionScrolling: expressionMode > 0 && expression !== null && poppler.loaded && !isHorizontal
+    // Frame profiler the page turn and scroll animations are reported to
+    property var profiler: null
     // ListView properties
     clip: true
     spacing: isHorizontal ? 0 : 20
@@ -31,7 +59,7 @@ ListView {
   flickableDirection: Flickable.VerticalFlick  // Only allow vertical flicking
 interactive: !isHorizontal  // Disable ListView's default interaction in horizontal mode
 boundsBehavior: isHorizontal ? Flickable.StopAtBounds : Flickable.DragAndOvershootBounds
-    model: poppler.loaded ? (isBookMode ? Math.ceil(poppler.pages.length / 2) : poppler.pages.length) : 0
+    model: poppler.loaded && !isHalfTurn ? (isBookMode ? Math.ceil(poppler.pages.length / 2) : poppler.pages.length) : 0
     //reuseItems: true
     displayMarginBeginning: isHorizontal ? width : height
     displayMarginEnd: isHorizontal ? width : height
@@ -69,11 +97,65 @@ boundsBehavior: isHorizontal ? Flickable.StopAtBounds : Flickable.DragAndOversho
         }
     }
 
+    onZoomChanged: zoomSettleTimer.restart()
+
+    Timer {
+        id: zoomSettleTimer
+        interval: pagesView.zoomSettleDelay
+        repeat: false
+        onTriggered: pagesView.renderZoom = pagesView.zoom
+    }
+
+    // Reads the beat position once per frame; the clock itself is tracked
+    // in the JACK thread, so the frame rate only affects smoothness
+    FrameAnimation {
+        running: pagesView.autoScrolling
+        onRunningChanged: pagesView.__lastBeats = -1
+        onTriggered: pagesView.__followClock()
+    }
+
+    // Same for the expression pedal, smoothed on the JACK thread
+    FrameAnimation {
+        running: pagesView.expressionScrolling
+        onRunningChanged: pagesView.__lastExpression = -1
+        onTriggered: pagesView.__followExpression(frameTime)
+    }
+
     onViewModeChanged: {
+        if (isHalfTurn) {
+            __wasHalfTurn = true
+            halfTurnView.goToPage(Math.max(0, currentPage))
+            __updateViewport()
+            return
+        }
+        // The list was empty, it is repopulated after this
+        if (__wasHalfTurn) {
+            __wasHalfTurn = false
+            Qt.callLater(goToPage, halfTurnView.currentPage)
+        }
         currentIndex = Math.floor(currentPage / (isBookMode ? 2 : 1))
         contentX = 0
         contentY = 0
     }
+    property bool __wasHalfTurn: false
+
+    // Over the list rather than in its content, it doesn't scroll
+    HalfTurnView {
+        id: halfTurnView
+        parent: pagesView
+        anchors.fill: parent
+        visible: pagesView.isHalfTurn
+        pages: poppler.pages
+        zoom: pagesView.zoom
+        renderZoom: pagesView.renderZoom
+        trimmed: pagesView.trimMargins
+        onCurrentPageChanged: {
+            if (!pagesView.isHalfTurn) return
+            pagesView.currentPage = currentPage
+            pagesView.__updateViewport()
+        }
+        onTurned: pagesView.__updateViewport()
+    }
     // Define signals
     signal errorOccurred(string message)
     signal searchNotFound
@@ -130,10 +212,91 @@ boundsBehavior: isHorizontal ? Flickable.StopAtBounds : Flickable.DragAndOversho
         onError: function(errorMessage) {
             pagesView.errorOccurred(errorMessage)
         }
+        onAboutToReload: pagesView.__pageBeforeReload = pagesView.currentPage
+        onReloaded: function(unchangedPages) {
+            // Same page count: the view didn't move. Otherwise the list was
+            // rebuilt, go back to where the reader was.
+            if (pagesView.currentPage !== pagesView.__pageBeforeReload)
+                pagesView.goToPage(Math.min(pagesView.__pageBeforeReload, pagesView.count - 1))
+            pagesView.__updateViewport()
+        }
     }
+    property int __pageBeforeReload: 0
 
     // Private functions
+    property int __viewportFirstPage: 0
+    property int __readingDirection: 1
+
+    // Lets the render scheduler serve visible pages first, then the ones
+    // the reader is heading towards
+    function __updateViewport() {
+        if (!poppler.loaded) return
+
+        var first, last
+        if (isHalfTurn) {
+            // Both pages of the state on screen; the next page is part of
+            // the next state, so it is ready before the turn
+            first = halfTurnView.currentPage
+            last = Math.min(first + 1, count - 1)
+        } else if (isHorizontal) {
+            first = isBookMode ? currentIndex * 2 : currentIndex
+            last = isBookMode ? first + 1 : first
+        } else {
+            first = pagesView.indexAt(pagesView.width / 2, pagesView.contentY + 1)
+            last = pagesView.indexAt(pagesView.width / 2, pagesView.contentY + pagesView.height - 1)
+            if (first === -1) first = currentPage
+            if (last === -1) last = first
+        }
+
+        if (first !== __viewportFirstPage)
+            __readingDirection = first > __viewportFirstPage ? 1 : -1
+        __viewportFirstPage = first
+        poppler.setViewport(first, last, __readingDirection)
+    }
+
+    property real __lastBeats: -1
+
+    function __followClock() {
+        var beats = clock.clockBeats()
+        var last = __lastBeats
+        __lastBeats = beats
+        // First frame, or the clock was restarted
+        if (last < 0 || beats < last) return
+
+        var beatsPerPage = Math.max(1, barsPerPage * beatsPerBar)
+        if (isHorizontal) {
+            var beatsPerView = isBookMode ? beatsPerPage * 2 : isHalfTurn ? beatsPerPage / 2 : beatsPerPage
+            if (Math.floor(beats / beatsPerView) > Math.floor(last / beatsPerView))
+                goToNextPage()
+        } else if (currentPage >= 0 && currentPage < poppler.pages.length) {
+            var pageStep = poppler.pages[currentPage].size.height * zoom + spacing
+            var bottom = originY + contentHeight - height
+            contentY = Math.min(contentY + (beats - last) * pageStep / beatsPerPage, Math.max(bottom, contentY))
+        }
+    }
+
+    property real __lastExpression: -1
+    readonly property real __expressionDeadZone: 0.05
+
+    function __followExpression(frameTime) {
+        var value = expression.expressionValue()
+        var bottom = Math.max(originY, originY + contentHeight - height)
+        if (expressionMode === 1) {
+            // Leave the view alone while the pedal rests, so it can still be scrolled by hand
+            if (Math.abs(value - __lastExpression) < 0.001) return
+            __lastExpression = value
+            contentY = originY + value * (bottom - originY)
+        } else if (value > __expressionDeadZone) {
+            var speed = (value - __expressionDeadZone) / (1 - __expressionDeadZone) * expressionSpeed / 100 * height
+            contentY = Math.min(contentY + speed * frameTime, Math.max(bottom, contentY))
+        }
+    }
+
     function __updateCurrentPage() {
+        if (isHalfTurn) {
+            currentPage = halfTurnView.currentPage
+            return
+        }
         var p = pagesView.indexAt(pagesView.width / 2, pagesView.contentY + pagesView.height / 2)
         if (p === -1)
             p = pagesView.indexAt(pagesView.width / 2, pagesView.contentY + pagesView.height / 2 + pagesView.spacing)
@@ -186,6 +349,10 @@ boundsBehavior: isHorizontal ? Flickable.StopAtBounds : Flickable.DragAndOversho
     }
 
     function __goTo(destination) {
+        if (isHalfTurn) {
+            goToPage(destination.page)
+            return
+        }
         pagesView.positionViewAtIndex(destination.page, ListView.Beginning)
         var pageHeight = poppler.pages[destination.page].size.height * zoom
         var scroll = Math.round(destination.top * pageHeight)
@@ -193,6 +360,10 @@ boundsBehavior: isHorizontal ? Flickable.StopAtBounds : Flickable.DragAndOversho
     }
 
     function __scrollTo(destination) {
+        if (isHalfTurn) {
+            goToPage(destination.page)
+            return
+        }
         if (destination.page !== currentPage) {
             pagesView.positionViewAtIndex(destination.page, ListView.Beginning)
         }
@@ -224,6 +395,7 @@ boundsBehavior: isHorizontal ? Flickable.StopAtBounds : Flickable.DragAndOversho
         target: pagesView
         function onContentYChanged() {
             __updateCurrentPage()
+            __updateViewport()
         }
     }
 
@@ -241,24 +413,23 @@ boundsBehavior: isHorizontal ? Flickable.StopAtBounds : Flickable.DragAndOversho
                                          (singlePage.implicitHeight || 0)
 
         // Single page mode
-        Image {
+        PageImage {
             id: singlePage
             visible: !isBookMode
             anchors.horizontalCenter: parent.horizontalCenter
-            cache: false
-            smooth: false
-            fillMode: isHorizontal ? Image.PreserveAspectFit : Image.Pad
 
             // Use the correct model data based on mode
             property var pageData: !isBookMode ? poppler.pages[index] : null
 
-            sourceSize.width: pageData ? Math.round(pageData.size.width * zoom) : 0
-            sourceSize.height: pageData ? Math.round(pageData.size.height * zoom) : 0
+            pageSize: pageData ? pageData.size : Qt.size(0, 0)
+            zoom: pagesView.zoom
+            renderZoom: pagesView.renderZoom
+            trimmed: pagesView.trimMargins
             source: pageData ? pageData.image : ""
 
-            // Links for single page
+            // Links for single page, their rects are relative to the untrimmed page
             Repeater {
-                model: singlePage.pageData ? singlePage.pageData.links : null
+                model: singlePage.pageData && !pagesView.trimMargins ? singlePage.pageData.links : null
                 delegate: MouseArea {
                     x: Math.round(modelData.rect.x * parent.width)
                     y: Math.round(modelData.rect.y * parent.height)
@@ -271,44 +442,48 @@ boundsBehavior: isHorizontal ? Flickable.StopAtBounds : Flickable.DragAndOversho
         }
 
         // Book mode (two pages)
-        Image {
+        PageImage {
             id: leftPage
             visible: isBookMode
             anchors.left: parent.left
             anchors.verticalCenter: parent.verticalCenter
             width: parent.width / 2
-            cache: false
-            smooth: false
             fillMode: Image.PreserveAspectFit
 
             property var pageData: isBookMode && (index * 2) < poppler.pages.length ?
                                        poppler.pages[index * 2] : null
 
-            sourceSize.width: pageData ? Math.round(pageData.size.width * zoom) : 0
-            sourceSize.height: pageData ? Math.round(pageData.size.height * zoom) : 0
+            pageSize: pageData ? pageData.size : Qt.size(0, 0)
+            zoom: pagesView.zoom
+            renderZoom: pagesView.renderZoom
+            trimmed: pagesView.trimMargins
             source: pageData ? pageData.image : ""
         }
 
-        Image {
+        PageImage {
             id: rightPage
             visible: isBookMode && (index * 2 + 1) < poppler.pages.length
             anchors.right: parent.right
             anchors.verticalCenter: parent.verticalCenter
             width: parent.width / 2
-            cache: false
-            smooth: false
             fillMode: Image.PreserveAspectFit
 
             property var pageData: isBookMode && (index * 2 + 1) < poppler.pages.length ?
                                        poppler.pages[index * 2 + 1] : null
 
-            sourceSize.width: pageData ? Math.round(pageData.size.width * zoom) : 0
-            sourceSize.height: pageData ? Math.round(pageData.size.height * zoom) : 0
+            pageSize: pageData ? pageData.size : Qt.size(0, 0)
+            zoom: pagesView.zoom
+            renderZoom: pagesView.renderZoom
+            trimmed: pagesView.trimMargins
             source: pageData ? pageData.image : ""
         }
     }
     // Navigation functions
     function goToNextPage() {
+         if (isHalfTurn) {
+             halfTurnView.next()
+             return
+         }
          if (currentIndex < count - 1) {
              if (isHorizontal) {
                  currentIndex = currentIndex + 1
@@ -322,6 +497,10 @@ boundsBehavior: isHorizontal ? Flickable.StopAtBounds : Flickable.DragAndOversho
 
 
     function goToPreviousPage() {
+         if (isHalfTurn) {
+             halfTurnView.previous()
+             return
+         }
          if (currentIndex > 0) {
              if (isHorizontal) {
                  currentIndex = currentIndex - 1
@@ -335,6 +514,10 @@ boundsBehavior: isHorizontal ? Flickable.StopAtBounds : Flickable.DragAndOversho
 
     function positionViewAtIndex(index, mode) {
            if (index < 0 || index >= count) return
+           if (isHalfTurn) {
+               halfTurnView.goToPage(index)
+               return
+           }
 
            currentIndex = index
            if (isHorizontal) {
@@ -347,36 +530,54 @@ boundsBehavior: isHorizontal ? Flickable.StopAtBounds : Flickable.DragAndOversho
 
 
     function goToPage(pageNumber) {
+        if (isHalfTurn) {
+            halfTurnView.goToPage(pageNumber)
+            return
+        }
         var targetIndex = isBookMode ? Math.floor(pageNumber / 2) : pageNumber
         if (targetIndex >= 0 && targetIndex < count) {
             positionViewAtIndex(targetIndex, ListView.Beginning)
         }
     }
     onCurrentIndexChanged: {
+        // The list is empty then, the page comes from halfTurnView
+        if (viewMode === 3) return
         if (isBookMode) {
             currentPage = currentIndex * 2
         } else {
             currentPage = currentIndex
         }
+        __updateViewport()
     }
     Behavior on contentX {
         enabled: isHorizontal
         SmoothedAnimation {
             duration: 200
             easing.type: Easing.OutCubic
+            onRunningChanged: pagesView.__profileSpan("pageTurn", running)
         }
     }
 
     Behavior on contentY {
-        enabled: !isHorizontal
+        enabled: !isHorizontal && !autoScrolling && !expressionScrolling
         SmoothedAnimation {
             duration: scrollDuration
             easing.type: Easing.OutCubic
+            onRunningChanged: pagesView.__profileSpan("scroll", running)
         }
     }
+    onMovingChanged: __profileSpan("flick", moving)
+
+    function __profileSpan(kind, running) {
+        if (!profiler) return
+        if (running)
+            profiler.beginSpan(kind)
+        else
+            profiler.endSpan(kind)
+    }
     MouseArea {
            anchors.fill: parent
-           enabled: isHorizontal
+           enabled: isHorizontal && !isHalfTurn
            z: 1000
            preventStealing: true
            propagateComposedEvents: false
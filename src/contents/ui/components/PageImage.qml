@@ -0,0 +1,76 @@
+import QtQuick 2.9
+
+// A page raster that follows zoom instantly by scaling the image it already
+// has, and swaps in a sharp render at renderZoom once that one is ready.
+// Two Images alternate as front/back buffer so the page never goes blank
+// while the new resolution is being rendered.
+Item {
+    id: pageImage
+
+    property string source
+    property size pageSize
+    property real zoom: 1.0
+    property real renderZoom: zoom
+    property int fillMode: Image.Stretch
+    // Margins are cut off by the renderer: the width stays, the height
+    // follows the aspect of the trimmed raster once there is one
+    property bool trimmed: false
+    property bool __frontIsA: true
+    readonly property Image __front: __frontIsA ? imageA : imageB
+    readonly property Image __back: __frontIsA ? imageB : imageA
+    readonly property int status: __front.status
+
+    implicitWidth: Math.round(pageSize.width * zoom)
+    implicitHeight: trimmed && __front.status === Image.Ready && __front.implicitWidth > 0 ?
+                        Math.round(implicitWidth * __front.implicitHeight / __front.implicitWidth) :
+                        Math.round(pageSize.height * zoom)
+
+    // New render mode, effects or a reloaded document: keep showing the
+    // old raster until the new one is there
+    onSourceChanged: __reload()
+    onRenderZoomChanged: __reload()
+
+    function __reload() {
+        if (__front.status === Image.Ready)
+            __load(__back)
+        else
+            __load(__front)
+    }
+
+    function __load(image) {
+        image.sourceSize = Qt.size(Math.round(pageSize.width * renderZoom),
+                                   Math.round(pageSize.height * renderZoom))
+        image.source = pageImage.source
+    }
+
+    function __swapIfReady(image) {
+        if (image === __back && image.status === Image.Ready) {
+            __frontIsA = !__frontIsA
+            __back.source = ""
+        }
+    }
+
+    Component.onCompleted: __load(__front)
+
+    Image {
+        id: imageA
+        anchors.fill: parent
+        fillMode: pageImage.fillMode
+        visible: pageImage.__front === imageA
+        asynchronous: true
+        cache: false
+        smooth: true
+        onStatusChanged: pageImage.__swapIfReady(imageA)
+    }
+
+    Image {
+        id: imageB
+        anchors.fill: parent
+        fillMode: pageImage.fillMode
+        visible: pageImage.__front === imageB
+        asynchronous: true
+        cache: false
+        smooth: true
+        onStatusChanged: pageImage.__swapIfReady(imageB)
+    }
+}
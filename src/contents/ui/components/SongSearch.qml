@@ -0,0 +1,82 @@
+import QtQuick
+import QtQuick.Layouts
+import QtQuick.Controls as QQC2
+import org.kde.kirigami as Kirigami
+
+// Jump-to-song search over the document outline, ranked as-you-type
+QQC2.Popup {
+    id: songSearch
+
+    property var poppler
+    property var results: []
+
+    signal songSelected(int page)
+
+    modal: true
+    focus: true
+    padding: Kirigami.Units.largeSpacing
+    width: Math.min(parent.width - Kirigami.Units.gridUnit * 2, Kirigami.Units.gridUnit * 30)
+    height: Math.min(parent.height - Kirigami.Units.gridUnit * 2, Kirigami.Units.gridUnit * 24)
+    x: Math.round((parent.width - width) / 2)
+    y: Kirigami.Units.gridUnit
+
+    onOpened: {
+        queryField.text = ""
+        results = []
+        queryField.forceActiveFocus()
+    }
+
+    function __select(index) {
+        if (index < 0 || index >= results.length) return
+        songSelected(results[index].page)
+        close()
+    }
+
+    contentItem: ColumnLayout {
+        spacing: Kirigami.Units.smallSpacing
+
+        Kirigami.SearchField {
+            id: queryField
+            Layout.fillWidth: true
+            placeholderText: i18n("Search %1 songs...", songSearch.poppler ? songSearch.poppler.songCount : 0)
+            onTextChanged: {
+                songSearch.results = songSearch.poppler ? songSearch.poppler.findSongs(text, 50) : []
+                resultsView.currentIndex = 0
+            }
+            onAccepted: songSearch.__select(resultsView.currentIndex)
+            Keys.onDownPressed: resultsView.incrementCurrentIndex()
+            Keys.onUpPressed: resultsView.decrementCurrentIndex()
+        }
+
+        ListView {
+            id: resultsView
+            Layout.fillWidth: true
+            Layout.fillHeight: true
+            clip: true
+            model: songSearch.results
+            highlightMoveDuration: 0
+
+            delegate: QQC2.ItemDelegate {
+                width: ListView.view.width
+                highlighted: ListView.isCurrentItem
+                text: modelData.title
+                onClicked: songSearch.__select(index)
+
+                QQC2.Label {
+                    anchors.right: parent.right
+                    anchors.rightMargin: Kirigami.Units.largeSpacing
+                    anchors.verticalCenter: parent.verticalCenter
+                    text: i18n("p. %1", modelData.page + 1)
+                    opacity: 0.7
+                }
+            }
+
+            Kirigami.PlaceholderMessage {
+                anchors.centerIn: parent
+                width: parent.width - Kirigami.Units.largeSpacing * 4
+                visible: resultsView.count === 0 && queryField.text.length > 0
+                text: i18n("No matching songs")
+            }
+        }
+    }
+}
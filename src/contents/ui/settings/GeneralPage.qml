@@ -2,6 +2,7 @@
 import QtQuick
 import QtQuick.Controls as QQC2
 import QtQuick.Layouts
+import QtQuick.Dialogs
 import org.kde.kirigami as Kirigami
 import org.kde.kirigamiaddons.formcard as FormCard
 
@@ -41,10 +42,90 @@ FormCard.FormCardPage {
 
                 FormCard.FormComboBoxDelegate {
                     text: i18n("Default view mode")
-                    model: [i18n("Scroll View"), i18n("Single Page"), i18n("Book View")]
+                    model: [i18n("Scroll View"), i18n("Single Page"), i18n("Book View"), i18n("Half Page Turns")]
                     currentIndex: settings.defaultViewMode
                     onCurrentIndexChanged: settings.defaultViewMode = currentIndex
                 }
+
+                FormCard.FormComboBoxDelegate {
+                    text: i18n("Page colors")
+                    description: i18n("Grayscale and black & white pages take 4 and 32 times less memory")
+                    model: [i18n("Color"), i18n("Grayscale"), i18n("Black & White")]
+                    currentIndex: settings.renderMode
+                    onActivated: settings.renderMode = currentIndex
+                }
+
+                FormCard.FormCheckDelegate {
+                    text: i18n("Night mode")
+                    description: i18n("Invert page colors for dark stages")
+                    checked: settings.nightMode
+                    onCheckedChanged: settings.nightMode = checked
+                }
+
+                FormCard.FormSpinBoxDelegate {
+                    label: i18n("Contrast boost")
+                    value: settings.contrastBoost
+                    onValueChanged: settings.contrastBoost = value
+                    from: 0
+                    to: 100
+                    stepSize: 10
+                }
+
+                FormCard.FormCheckDelegate {
+                    text: i18n("Trim margins")
+                    description: i18n("Cut off white page margins so the notation is shown larger")
+                    checked: settings.trimMargins
+                    onCheckedChanged: settings.trimMargins = checked
+                }
+
+                FormCard.FormCheckDelegate {
+                    text: i18n("Tune rendering per document")
+                    description: i18n("Try the available renderers on a few pages of each new document and keep the fastest that looks the same")
+                    checked: settings.autoTuneRendering
+                    onCheckedChanged: settings.autoTuneRendering = checked
+                }
+            }
+
+            FormCard.FormCard {
+                Layout.fillWidth: true
+                Layout.topMargin: Kirigami.Units.largeSpacing
+
+                FormCard.FormHeader {
+                    title: i18n("Library")
+                }
+
+                FormCard.FormTextDelegate {
+                    text: i18n("Indexed documents")
+                    description: library.scanning ?
+                                     i18n("Scanning, %1 files left", library.pendingFiles) :
+                                     i18n("%1 documents", library.documentCount)
+                }
+
+                Repeater {
+                    model: settings.libraryFolders
+
+                    FormCard.FormTextDelegate {
+                        required property string modelData
+                        required property int index
+                        text: modelData
+                        trailing: QQC2.Button {
+                            icon.name: "list-remove"
+                            text: i18n("Remove")
+                            display: QQC2.AbstractButton.IconOnly
+                            onClicked: {
+                                var folders = settings.libraryFolders.slice()
+                                folders.splice(index, 1)
+                                settings.libraryFolders = folders
+                            }
+                        }
+                    }
+                }
+
+                FormCard.FormButtonDelegate {
+                    icon.name: "folder-add"
+                    text: i18n("Add folder...")
+                    onClicked: folderDialog.open()
+                }
             }
 
             // Add spacing at the bottom
@@ -54,4 +135,14 @@ FormCard.FormCardPage {
             }
         }
     }
+
+    FolderDialog {
+        id: folderDialog
+        title: i18n("Choose a folder with PDF files")
+        onAccepted: {
+            var path = decodeURIComponent(selectedFolder.toString().replace(/^(file:\/{2})/, ""))
+            if (settings.libraryFolders.indexOf(path) < 0)
+                settings.libraryFolders = settings.libraryFolders.concat([path])
+        }
+    }
 }
@@ -57,6 +57,19 @@ FormCard.FormCardPage {
                     }
                 }
 
+                // JACK is opened in the background and retried until the server is up
+                FormCard.FormTextDelegate {
+                    visible: !midiClient.midiReady
+                    text: midiClient.midiState === 0 ? i18n("Starting JACK…") : i18n("JACK unavailable")
+                    description: midiClient.midiState === 0 ? "" :
+                                     i18n("%1. Retrying until the JACK server is running.", midiClient.midiError)
+                    trailing: QQC2.Button {
+                        text: i18n("Retry Now")
+                        visible: midiClient.midiState !== 0
+                        onClicked: midiClient.start()
+                    }
+                }
+
                 // Connection status display
                 FormCard.AbstractFormDelegate {
                     background: Item {}
@@ -100,38 +113,105 @@ FormCard.FormCardPage {
                     }
                 }
 
-                // Connect/Disconnect button
+                // Connect button, inputs are added next to the ones already open
                 FormCard.FormButtonDelegate {
-                    text: midiClient.isInputPortConnected ? i18n("Disconnect") : i18n("Connect")
-                    icon.name: midiClient.isInputPortConnected ? "network-disconnect" : "network-connect"
-                    enabled: comboBox.currentIndex >= 0 || midiClient.isInputPortConnected
+                    text: i18n("Connect")
+                    icon.name: "network-connect"
+                    enabled: midiClient.midiReady && comboBox.currentIndex >= 0
 
                     onClicked: {
-                        if (midiClient.isInputPortConnected) {
-                            // Disconnect if currently connected
-                            midiClient.makeDisconnect();
-                        } else if (comboBox.currentIndex >= 0) {
-                            // First disconnect (just to be safe)
-                            midiClient.makeDisconnect();
-
-                            // Small delay before connecting
-                            connectionTimer.start();
-                        }
+                        var inputPort = comboBox.model.data(
+                            comboBox.model.index(comboBox.currentIndex, 0),
+                            Qt.UserRole + 2);
+                        midiClient.makeConnection(inputPort, null);
+                        openInputs.refresh();
                     }
+                }
 
-                    Timer {
-                        id: connectionTimer
-                        interval: 100  // Short delay to allow disconnection to complete
-                        repeat: false
-                        onTriggered: {
-                            var inputPort = comboBox.model.data(
-                                comboBox.model.index(comboBox.currentIndex, 0),
-                                Qt.UserRole + 2);
-                            midiClient.makeConnection(inputPort, null);
+                // Open inputs, merged into one stream
+                Repeater {
+                    id: openInputs
+                    model: []
+
+                    function refresh() {
+                        model = midiClient.inputStats()
+                    }
+
+                    Component.onCompleted: refresh()
+
+                    delegate: FormCard.AbstractFormDelegate {
+                        id: inputDelegate
+                        required property var modelData
+                        background: Item {}
+                        contentItem: ColumnLayout {
+                            spacing: Kirigami.Units.smallSpacing
+
+                            RowLayout {
+                                QQC2.Label {
+                                    text: inputDelegate.modelData.name
+                                    elide: Text.ElideRight
+                                    font.bold: true
+                                    Layout.fillWidth: true
+                                }
+                                QQC2.Label {
+                                    text: i18n("%1 received, %2 filtered",
+                                               inputDelegate.modelData.received,
+                                               inputDelegate.modelData.filtered)
+                                    opacity: 0.7
+                                }
+                                QQC2.ToolButton {
+                                    icon.name: "network-disconnect"
+                                    text: i18n("Disconnect")
+                                    display: QQC2.AbstractButton.IconOnly
+                                    onClicked: {
+                                        midiClient.disconnectInput(inputDelegate.modelData.slot)
+                                        openInputs.refresh()
+                                    }
+                                }
+                            }
+
+                            // Message kinds let through, JackClient::MessageType
+                            RowLayout {
+                                Repeater {
+                                    model: [
+                                        { flag: 0x01, label: i18n("Notes") },
+                                        { flag: 0x02, label: i18n("Controllers") },
+                                        { flag: 0x04, label: i18n("Programs") },
+                                        { flag: 0x10, label: i18n("Clock") }
+                                    ]
+                                    delegate: QQC2.CheckBox {
+                                        text: modelData.label
+                                        checked: inputDelegate.modelData.types & modelData.flag
+                                        onToggled: {
+                                            var types = inputDelegate.modelData.types
+                                            types = checked ? (types | modelData.flag) : (types & ~modelData.flag)
+                                            midiClient.setInputFilter(inputDelegate.modelData.slot, types)
+                                            openInputs.refresh()
+                                        }
+                                    }
+                                }
+                            }
                         }
                     }
                 }
 
+                Timer {
+                    interval: 1000
+                    repeat: true
+                    running: openInputs.count > 0
+                    onTriggered: openInputs.refresh()
+                }
+
+                FormCard.FormButtonDelegate {
+                    text: i18n("Disconnect All")
+                    icon.name: "network-disconnect"
+                    visible: midiClient.isInputPortConnected
+                    onClicked: {
+                        midiClient.makeDisconnect();
+                        openInputs.refresh();
+                    }
+                }
+
                 // Refresh MIDI ports button
                 FormCard.FormButtonDelegate {
                     text: i18n("Refresh MIDI Ports")
@@ -184,6 +264,101 @@ FormCard.FormCardPage {
                 }
             }
 
+            FormCard.FormCard {
+                Layout.fillWidth: true
+                Layout.topMargin: Kirigami.Units.largeSpacing
+
+                FormCard.FormHeader {
+                    title: i18n("Auto-scroll")
+                }
+
+                FormCard.FormCheckDelegate {
+                    text: i18n("Follow MIDI clock")
+                    description: i18n("Scroll along with the clock of a sequencer or drum machine, starting and stopping with it")
+                    checked: settings.autoScrollEnabled
+                    onToggled: settings.autoScrollEnabled = checked
+                }
+
+                FormCard.FormSpinBoxDelegate {
+                    label: i18n("Bars per Page")
+                    value: settings.barsPerPage
+                    onValueChanged: settings.barsPerPage = value
+                    from: 1
+                    to: 64
+                }
+
+                FormCard.FormSpinBoxDelegate {
+                    label: i18n("Beats per Bar")
+                    value: settings.beatsPerBar
+                    onValueChanged: settings.beatsPerBar = value
+                    from: 1
+                    to: 16
+                }
+
+                FormCard.FormTextDelegate {
+                    text: i18n("MIDI Clock")
+                    description: midiClient.clockRunning ?
+                                     i18n("Running at %1 BPM", midiClient.tempo) :
+                                     i18n("Stopped")
+                }
+            }
+
+            FormCard.FormCard {
+                Layout.fillWidth: true
+                Layout.topMargin: Kirigami.Units.largeSpacing
+
+                FormCard.FormHeader {
+                    title: i18n("Expression Pedal")
+                }
+
+                FormCard.FormComboBoxDelegate {
+                    text: i18n("Pedal Controls")
+                    model: [i18n("Nothing"), i18n("Scroll Position"), i18n("Scroll Speed")]
+                    currentIndex: settings.expressionMode
+                    onActivated: settings.expressionMode = currentIndex
+                }
+
+                FormCard.FormSpinBoxDelegate {
+                    label: i18n("Expression Control")
+                    text: i18n("MIDI Control Number of the pedal (default: 11 - Expression)")
+                    enabled: settings.expressionMode > 0
+                    value: settings.expressionControl
+                    onValueChanged: settings.expressionControl = value
+                    from: 0
+                    to: 127
+                }
+
+                FormCard.FormSpinBoxDelegate {
+                    label: i18n("Maximum Speed")
+                    text: i18n("Percent of the view height scrolled per second with the pedal fully down")
+                    visible: settings.expressionMode === 2
+                    value: settings.expressionSpeed
+                    onValueChanged: settings.expressionSpeed = value
+                    from: 5
+                    to: 400
+                    stepSize: 5
+                }
+
+                FormCard.FormTextDelegate {
+                    id: expressionValueLabel
+                    text: i18n("Pedal Position")
+                    visible: settings.expressionMode > 0
+                    description: "—"
+
+                    // Polled like the view does, pedal messages don't reach the GUI thread
+                    Timer {
+                        interval: 100
+                        repeat: true
+                        running: expressionValueLabel.visible
+                        onTriggered: {
+                            var stats = midiClient.expressionStats()
+                            expressionValueLabel.description = stats.active ?
+                                i18n("%1%", Math.round(stats.value * 100)) : i18n("No pedal messages received")
+                        }
+                    }
+                }
+            }
+
             // Test area card
             FormCard.FormCard {
                 Layout.fillWidth: true
@@ -219,19 +394,58 @@ FormCard.FormCardPage {
                             wrapMode: Text.WordWrap
                         }
 
-                        // MIDI test connections
+                        // Recent controllers, with their last value and rate
+                        Repeater {
+                            model: midiClient.monitor
+                            delegate: QQC2.Label {
+                                required property int channel
+                                required property string type
+                                required property int number
+                                required property int value
+                                required property double rate
+                                Layout.fillWidth: true
+                                font: Kirigami.Theme.smallFont
+                                opacity: 0.7
+                                text: number >= 0 ?
+                                          i18n("Channel %1, %2 %3: %4 (%5/s)", channel, type, number, value, rate.toFixed(0)) :
+                                          i18n("Channel %1, %2: %3 (%4/s)", channel, type, value, rate.toFixed(0))
+                            }
+                        }
+
+                        // The monitor records while the page is shown and is
+                        // drained once per frame, however dense the input
+                        Binding {
+                            target: midiClient.monitor
+                            property: "active"
+                            value: midiPage.visible
+                        }
+
+                        FrameAnimation {
+                            running: midiPage.visible
+                            onTriggered: midiClient.monitor.update()
+                        }
+
                         Connections {
-                            target: midiClient
-                            function onMidiMessageReceived(channel, control, value) {
+                            target: midiClient.monitor
+                            function onLastEventChanged() {
+                                var monitor = midiClient.monitor
+                                if (monitor.lastChannel === 0) {
+                                    lastControlLabel.text = i18n("Last received control: None")
+                                    actionLabel.text = ""
+                                    return
+                                }
                                 lastControlLabel.text = i18n("Last received: Channel %1, Control %2, Value %3",
-                                                          channel, control, value)
+                                                          monitor.lastChannel, monitor.lastNumber, monitor.lastValue)
 
                                 // Show what action would be triggered
-                                if (channel === midiClient.midiChannel) {
-                                    if (control === midiClient.nextPageControl) {
+                                if (monitor.lastType !== "cc") {
+                                    actionLabel.text = i18n("Not a control change")
+                                    actionLabel.color = "#757575" // Gray
+                                } else if (monitor.lastChannel === midiClient.midiChannel) {
+                                    if (monitor.lastNumber === midiClient.nextPageControl) {
                                         actionLabel.text = i18n("Action: Next Page")
                                         actionLabel.color = "#4CAF50" // Green
-                                    } else if (control === midiClient.prevPageControl) {
+                                    } else if (monitor.lastNumber === midiClient.prevPageControl) {
                                         actionLabel.text = i18n("Action: Previous Page")
                                         actionLabel.color = "#2196F3" // Blue
                                     } else {
@@ -1,4 +1,6 @@
 #include <QApplication>
+#include <QElapsedTimer>
+#include <QQuickWindow>
 #include <QQmlApplicationEngine>
 #include <QtQml>
 #include <QQmlApplicationEngine>
@@ -11,10 +13,17 @@
 
 #include <backend/midiclient.h>
 #include <utils/pdfModel.h>
+#include <utils/documentRegistry.h>
+#include <utils/frameProfiler.h>
+#include <utils/libraryIndex.h>
+#include <utils/metrics.h>
 #include <utils/settings.h>
 
 int main(int argc, char *argv[])
 {
+    QElapsedTimer startupTimer;
+    startupTimer.start();
+
     QApplication app(argc, argv);
     KIconTheme::current();
     QApplication::setStyle("breeze");
@@ -33,10 +42,33 @@ int main(int argc, char *argv[])
 
     QQmlApplicationEngine engine;
 
+    // JACK comes up in the background, in parallel with loading the QML
     MidiClient *midiClient = new MidiClient();
+    midiClient->start();
     Settings *settings = new Settings();
+    // Restore the last session: the document and the pages that were on
+    // screen load while the QML below is still being compiled
+    if (settings->autoOpenLast() && QFileInfo::exists(settings->lastDocument())) {
+        const int restoredPages = 3; // The page on screen, the next one or the facing page
+        PageEffects effects;
+        effects.invert = settings->nightMode();
+        effects.contrast = qBound(0, settings->contrastBoost(), 100);
+        effects.trim = settings->trimMargins();
+        const RenderKey key{-1, RenderCache::quantizeDpi(72.0 * settings->lastZoom() / 100.0),
+                            RenderMode(qBound(0, settings->renderMode(), int(RenderMode::Monochrome))),
+                            effects};
+        DocumentRegistry::preload(settings->lastDocument(), settings->lastPage(), restoredPages, key);
+    }
+
     engine.rootContext()->setContextProperty("midiClient", midiClient);
     engine.rootContext()->setContextProperty("settings", settings);
+    // Loads the saved index in the background, scans once QML hands it the folders
+    LibraryIndex *library = new LibraryIndex();
+    engine.rootContext()->setContextProperty("library", library);
+    FrameProfiler *frameProfiler = new FrameProfiler();
+    engine.rootContext()->setContextProperty("frameProfiler", frameProfiler);
+    Metrics *metrics = new Metrics();
+    engine.rootContext()->setContextProperty("metrics", metrics);
     qmlRegisterType<PdfModel>("com.SpiritMusic.Poppler", 1, 0, "Poppler");
 
     engine.rootContext()->setContextObject(new KLocalizedContext(&engine));
@@ -48,6 +80,17 @@ int main(int argc, char *argv[])
                 []() { QCoreApplication::exit(-1); },
     Qt::QueuedConnection);
     engine.load(url);
+
+    // Time to first frame, the number startup work is judged by. Reported
+    // from the render thread, a queued connection would add a frame to it.
+    if (!engine.rootObjects().isEmpty()) {
+        if (auto *window = qobject_cast<QQuickWindow *>(engine.rootObjects().constFirst())) {
+            frameProfiler->attach(window);
+            QObject::connect(window, &QQuickWindow::frameSwapped, window, [startupTimer] {
+                qDebug() << "First frame after" << startupTimer.elapsed() << "ms";
+            }, Qt::ConnectionType(Qt::DirectConnection | Qt::SingleShotConnection));
+        }
+    }
     //    engine.loadFromModule("SpiritSheet", "Main");
 
     return app.exec();
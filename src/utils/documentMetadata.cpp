@@ -0,0 +1,190 @@
+// documentMetadata.cpp
+#include "documentMetadata.h"
+#include "pdfModel.h"
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QDebug>
+
+static const quint32 SIDECAR_MAGIC = 0x53534d44; // "SSMD"
+static const quint16 SIDECAR_VERSION = 2;
+static const qint64 KEY_BLOCK_SIZE = 64 * 1024;
+
+static QDataStream& operator<<(QDataStream& out, const PageLink& link)
+{
+    return out << link.rect << qint32(link.page) << link.top << link.left;
+}
+
+static QDataStream& operator>>(QDataStream& in, PageLink& link)
+{
+    qint32 page;
+    in >> link.rect >> page >> link.top >> link.left;
+    link.page = page;
+    return in;
+}
+
+QDataStream& operator<<(QDataStream& out, const OutlineEntry& entry)
+{
+    return out << entry.title << qint32(entry.page) << entry.top << quint8(entry.level);
+}
+
+QDataStream& operator>>(QDataStream& in, OutlineEntry& entry)
+{
+    qint32 page;
+    quint8 level;
+    in >> entry.title >> page >> entry.top >> level;
+    entry.page = page;
+    entry.level = level;
+    return in;
+}
+
+static QString sidecarPath(const QString& path)
+{
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation)
+        + "/metadata/" + DocumentMetadata::fileKey(path) + ".bin";
+}
+
+static void appendOutline(const QList<Poppler::OutlineItem>& items, int level,
+                          QList<OutlineEntry>& outline)
+{
+    for (const Poppler::OutlineItem& item : items)
+    {
+        OutlineEntry entry;
+        entry.title = item.name();
+        entry.level = level;
+        if (auto destination = item.destination())
+        {
+            entry.page = destination->pageNumber() - 1;
+            entry.top = destination->top();
+        }
+        outline.append(entry);
+
+        if (item.hasChildren())
+            appendOutline(item.children(), level + 1, outline);
+    }
+}
+
+DocumentMetadata DocumentMetadata::fromDocument(Poppler::Document* document, bool withOutline)
+{
+    DocumentMetadata metadata;
+    const int numPages = document->numPages();
+    metadata.pageSizes.reserve(numPages);
+    metadata.links.reserve(numPages);
+
+    for (int i = 0; i < numPages; ++i)
+    {
+        std::unique_ptr<Poppler::Page> page(document->page(i));
+        metadata.pageSizes.append(page ? page->pageSizeF() : QSizeF());
+
+        QList<PageLink> pageLinks;
+        if (page)
+        {
+            auto links = page->links();
+            for (const auto& link : links)
+            {
+                if (link->linkType() == Poppler::Link::Goto)
+                {
+                    auto* gotoLink = dynamic_cast<Poppler::LinkGoto*>(link.get());
+                    if (gotoLink && !gotoLink->isExternal())
+                    {
+                        const Poppler::LinkDestination destination = gotoLink->destination();
+                        pageLinks.append({link->linkArea().normalized(),
+                                          destination.pageNumber() - 1,
+                                          destination.top(),
+                                          destination.left()});
+                    }
+                }
+            }
+        }
+        metadata.links.append(pageLinks);
+    }
+
+    metadata.hasOutline = withOutline;
+    if (withOutline)
+        metadata.outline = outlineOf(document);
+    return metadata;
+}
+
+QList<OutlineEntry> DocumentMetadata::outlineOf(Poppler::Document* document)
+{
+    QList<OutlineEntry> outline;
+    appendOutline(document->outline(), 0, outline);
+    return outline;
+}
+
+std::optional<DocumentMetadata> DocumentMetadata::loadCached(const QString& path)
+{
+    QFile file(sidecarPath(path));
+    if (!file.open(QIODevice::ReadOnly))
+        return std::nullopt;
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_6_5);
+    in.setFloatingPointPrecision(QDataStream::SinglePrecision);
+
+    quint32 magic;
+    quint16 version;
+    in >> magic >> version;
+    if (magic != SIDECAR_MAGIC || version != SIDECAR_VERSION)
+    {
+        DEBUG << "Ignoring metadata sidecar with unknown format:" << file.fileName();
+        return std::nullopt;
+    }
+
+    DocumentMetadata metadata;
+    in >> metadata.pageSizes >> metadata.links >> metadata.hasOutline >> metadata.outline;
+    if (in.status() != QDataStream::Ok || metadata.links.size() != metadata.pageSizes.size())
+    {
+        qWarning() << "Corrupt metadata sidecar, ignoring it:" << file.fileName();
+        return std::nullopt;
+    }
+
+    return metadata;
+}
+
+bool DocumentMetadata::saveCached(const QString& path) const
+{
+    const QString fileName = sidecarPath(path);
+    QDir().mkpath(QFileInfo(fileName).absolutePath());
+
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly))
+    {
+        qWarning() << "Can't write metadata sidecar" << fileName;
+        return false;
+    }
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_6_5);
+    out.setFloatingPointPrecision(QDataStream::SinglePrecision);
+    out << SIDECAR_MAGIC << SIDECAR_VERSION;
+    out << pageSizes << links << hasOutline << outline;
+
+    return file.commit();
+}
+
+QString DocumentMetadata::fileKey(const QString& path)
+{
+    const QFileInfo info(path);
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(info.absoluteFilePath().toUtf8());
+    hash.addData(QByteArray::number(info.size()));
+    hash.addData(QByteArray::number(info.lastModified().toMSecsSinceEpoch()));
+
+    QFile file(path);
+    if (file.open(QIODevice::ReadOnly))
+    {
+        hash.addData(file.read(KEY_BLOCK_SIZE));
+        if (file.size() > KEY_BLOCK_SIZE)
+        {
+            file.seek(qMax(KEY_BLOCK_SIZE, file.size() - KEY_BLOCK_SIZE));
+            hash.addData(file.read(KEY_BLOCK_SIZE));
+        }
+    }
+
+    return hash.result().toHex();
+}
@@ -0,0 +1,56 @@
+// documentMetadata.h
+#ifndef DOCUMENTMETADATA_H
+#define DOCUMENTMETADATA_H
+
+#include <QDataStream>
+#include <QList>
+#include <QRectF>
+#include <QSizeF>
+#include <QString>
+#include <poppler-qt6.h>
+#include <optional>
+
+struct PageLink
+{
+    QRectF rect;     // Normalized to the page size
+    int page = 0;    // 0-based destination page
+    double top = 0.0;
+    double left = 0.0;
+};
+
+struct OutlineEntry
+{
+    QString title;
+    int page = -1;   // 0-based, -1 if the entry has no destination
+    double top = 0.0;
+    int level = 0;   // Nesting depth, 0 for top level entries
+};
+
+// Everything PdfModel needs from a document that never changes for a given
+// file. Collecting it walks every page, so it is kept in a small binary
+// sidecar in the cache location and reused as long as the file is unchanged.
+struct DocumentMetadata
+{
+    QList<QSizeF> pageSizes;
+    QList<QList<PageLink>> links;
+    QList<OutlineEntry> outline;
+    // False until the outline has been read, see fromDocument()
+    bool hasOutline = true;
+
+    // Without the outline when withOutline is false: walking a large one
+    // takes long enough to be left to a background thread
+    static DocumentMetadata fromDocument(Poppler::Document* document, bool withOutline = true);
+    // Just the outline, without walking the pages
+    static QList<OutlineEntry> outlineOf(Poppler::Document* document);
+    static std::optional<DocumentMetadata> loadCached(const QString& path);
+    bool saveCached(const QString& path) const;
+
+    // Identifies the contents of a file: its path, size, mtime and a
+    // hash of its first and last blocks
+    static QString fileKey(const QString& path);
+};
+
+QDataStream& operator<<(QDataStream& out, const OutlineEntry& entry);
+QDataStream& operator>>(QDataStream& in, OutlineEntry& entry);
+
+#endif // DOCUMENTMETADATA_H
@@ -0,0 +1,363 @@
+// documentRegistry.cpp
+#include "documentRegistry.h"
+#include "metrics.h"
+#include "pageFingerprint.h"
+#include "pdfModel.h"
+#include "renderTuning.h"
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QPointer>
+#include <QDebug>
+
+QMutex DocumentRegistry::mutex;
+QHash<QString, std::weak_ptr<SharedDocument>> DocumentRegistry::documents;
+quint64 DocumentRegistry::opened = 0;
+quint64 DocumentRegistry::shared = 0;
+QWaitCondition DocumentRegistry::preloadDone;
+QString DocumentRegistry::preloadingPath;
+QSet<QString> DocumentRegistry::reloading;
+std::shared_ptr<SharedDocument> DocumentRegistry::preloaded;
+qint64 DocumentRegistry::preloadMs = -1;
+
+// How often a pending calibration checks whether the views still need the
+// render thread
+static const int TUNE_IDLE_POLL_MS = 250;
+// tune() runs as the file opens, before the views have asked for a page: the
+// scheduler looks idle until they do
+static const int TUNE_START_DELAY_MS = 2000;
+
+SharedDocument::~SharedDocument()
+{
+    // The generator renders through the scheduler, stop it first
+    if (thumbnails)
+        thumbnails->stop();
+    DEBUG << "Document closed:" << path;
+}
+
+std::shared_ptr<SharedDocument> DocumentRegistry::acquire(const QString& path, QString* errorMessage)
+{
+    const QString key = DocumentMetadata::fileKey(path);
+
+    QMutexLocker locker(&mutex);
+    const QString absolutePath = QFileInfo(path).absoluteFilePath();
+    while (preloadingPath == absolutePath)
+        preloadDone.wait(&mutex);
+
+    // Whichever document the first view opens, the session has moved on
+    // from the preloaded one
+    std::shared_ptr<SharedDocument> document = documents.value(key).lock();
+    if (preloaded)
+    {
+        preloaded->renderScheduler->removeViewport(&preloaded);
+        if (document == preloaded)
+            DEBUG << "Document restored from the last session:" << path;
+        else if (document)
+            ++shared;
+        preloaded.reset();
+        if (document)
+            return document;
+    }
+    else if (document)
+    {
+        ++shared;
+        DEBUG << "Document already open, sharing it:" << path;
+        return document;
+    }
+
+    // On the GUI thread, the outline is read in the background afterwards
+    document = load(path, key, errorMessage, false);
+    if (!document)
+        return nullptr;
+    document->thumbnails->start();
+
+    // Expired entries of closed documents are dropped on the way
+    documents.removeIf([](const auto& entry) { return entry.value().expired(); });
+    documents.insert(key, document);
+    ++opened;
+    return document;
+}
+
+std::shared_ptr<SharedDocument> DocumentRegistry::load(const QString& path, const QString& key,
+                                                      QString* errorMessage, bool withOutline)
+{
+    DEBUG << "Loading document...";
+    QElapsedTimer loadTimer;
+    loadTimer.start();
+    std::shared_ptr<Poppler::Document> pdf(Poppler::Document::load(path));
+    if (!pdf || pdf->isLocked())
+    {
+        *errorMessage = "Can't open the document located at " + path;
+        return nullptr;
+    }
+
+    // Page sizes, links and outline never change for a given file, reuse
+    // them from the sidecar if this file was opened before
+    QElapsedTimer timer;
+    timer.start();
+    std::optional<DocumentMetadata> metadata = DocumentMetadata::loadCached(path);
+    if (metadata && metadata->pageSizes.size() != pdf->numPages())
+        metadata.reset();
+    const bool fromCache = metadata.has_value();
+    if (!metadata)
+    {
+        metadata = DocumentMetadata::fromDocument(pdf.get(), withOutline);
+        metadata->saveCached(path);
+    }
+    DEBUG << "Metadata of" << metadata->pageSizes.size() << "pages"
+          << (fromCache ? "read from sidecar" : "collected") << "in" << timer.elapsed() << "ms";
+
+    // The defaults until the file is calibrated, and for good if that failed
+    bool tuningFailed = false;
+    const std::optional<RenderConfig> tuned = RenderTuning::loadCached(key, &tuningFailed);
+    if (tuned)
+        DEBUG << "Rendering with the calibrated" << tuned->name();
+
+    auto document = std::make_shared<SharedDocument>();
+    document->key = key;
+    document->path = path;
+    document->document = pdf;
+    document->metadata = std::move(*metadata);
+    document->tuned = tuned || tuningFailed;
+    document->renderCache = std::make_shared<RenderCache>();
+    document->renderScheduler = std::make_shared<RenderScheduler>(pdf, document->renderCache,
+                                                                  tuned.value_or(RenderConfig()));
+    document->thumbnails = std::make_shared<ThumbnailStore>(path, document->metadata.pageSizes,
+                                                            document->renderScheduler);
+
+    static Metrics::Counter& loads = Metrics::counter("document.loads");
+    static Metrics::Gauge& lastLoadMs = Metrics::gauge("document.lastLoadMs");
+    loads.add();
+    lastLoadMs.set(loadTimer.elapsed());
+    return document;
+}
+
+void DocumentRegistry::preload(const QString& path, int firstPage, int pageCount, const RenderKey& key)
+{
+    const QString absolutePath = QFileInfo(path).absoluteFilePath();
+    {
+        QMutexLocker locker(&mutex);
+        if (!preloadingPath.isEmpty() || preloaded)
+            return;
+        preloadingPath = absolutePath;
+    }
+
+    QThread* loader = QThread::create([path, firstPage, pageCount, key] {
+        QElapsedTimer timer;
+        timer.start();
+        const QString fileKey = DocumentMetadata::fileKey(path);
+        QString message;
+        std::shared_ptr<SharedDocument> document = load(path, fileKey, &message);
+        if (document)
+        {
+            document->thumbnails->start();
+            // Rendered ahead of everything else until a view reports its
+            // own viewport
+            const int lastPage = qMin(firstPage + pageCount, int(document->metadata.pageSizes.size())) - 1;
+            document->renderScheduler->setViewport(&preloaded, firstPage, lastPage, 1);
+            for (int page = qMax(0, firstPage); page <= lastPage; ++page)
+            {
+                RenderKey pageKey = key;
+                pageKey.page = page;
+                document->renderScheduler->prefetch(pageKey);
+            }
+            DEBUG << "Session document loaded in" << timer.elapsed() << "ms, pages"
+                  << firstPage + 1 << "to" << lastPage + 1 << "queued at" << key.dpi << "dpi";
+        }
+        else
+        {
+            qWarning() << "Can't restore the last session:" << message;
+        }
+
+        QMutexLocker locker(&mutex);
+        if (document)
+        {
+            documents.insert(fileKey, document);
+            preloaded = document;
+            preloadMs = timer.elapsed();
+            ++opened;
+        }
+        preloadingPath.clear();
+        preloadDone.wakeAll();
+    });
+    QObject::connect(loader, &QThread::finished, loader, &QObject::deleteLater);
+    loader->start();
+}
+
+void DocumentRegistry::reload(std::shared_ptr<SharedDocument> previous, QObject* context,
+                              std::function<void(std::shared_ptr<SharedDocument>, int, const QString&)> done)
+{
+    QThread* loader = QThread::create([previous, context = QPointer<QObject>(context), done] {
+        QElapsedTimer timer;
+        timer.start();
+        const QString key = DocumentMetadata::fileKey(previous->path);
+        QString message;
+        std::shared_ptr<SharedDocument> document;
+        int carried = 0;
+
+        // Every view of the file notices the change, the first one loads it
+        // and the others wait and share the result
+        bool loadHere = false;
+        {
+            QMutexLocker locker(&mutex);
+            while (reloading.contains(previous->key))
+                preloadDone.wait(&mutex);
+            document = documents.value(key).lock();
+            if (!document)
+            {
+                reloading.insert(previous->key);
+                loadHere = true;
+            }
+        }
+
+        if (loadHere)
+        {
+            document = load(previous->path, key, &message);
+            if (document)
+            {
+                // Before the generator starts, it skips what was carried over
+                carried = carryOver(*previous, *document);
+                document->thumbnails->start();
+            }
+
+            QMutexLocker locker(&mutex);
+            if (document)
+            {
+                documents.removeIf([](const auto& entry) { return entry.value().expired(); });
+                documents.insert(key, document);
+                ++opened;
+                DEBUG << "Document reloaded in" << timer.elapsed() << "ms," << carried << "of"
+                      << document->metadata.pageSizes.size() << "pages unchanged";
+            }
+            reloading.remove(previous->key);
+            preloadDone.wakeAll();
+        }
+        else if (document == previous)
+        {
+            carried = int(document->metadata.pageSizes.size());
+        }
+
+        QMetaObject::invokeMethod(context.data(), [context, done, document, carried, message] {
+            if (context)
+                done(document, carried, message);
+        }, Qt::QueuedConnection);
+    });
+    QObject::connect(loader, &QThread::finished, loader, &QObject::deleteLater);
+    loader->start();
+}
+
+void DocumentRegistry::tune(std::shared_ptr<SharedDocument> document)
+{
+    if (!document || document->tuned.exchange(true))
+        return;
+
+    // Weak, closing the document stops the calibration
+    QThread* tuner = QThread::create([weak = std::weak_ptr<SharedDocument>(document),
+                                      path = document->path, key = document->key] {
+        // Before every render: timings taken while pages for the screen are
+        // rendering would be off, and would slow those pages down
+        const auto idle = [&weak] {
+            forever
+            {
+                const std::shared_ptr<SharedDocument> document = weak.lock();
+                if (!document)
+                    return false;
+                if (!document->renderScheduler->isBusy())
+                    return true;
+                QThread::msleep(TUNE_IDLE_POLL_MS);
+            }
+        };
+
+        QThread::msleep(TUNE_START_DELAY_MS);
+        const std::optional<RenderConfig> config = RenderTuning::calibrate(path, idle);
+        if (weak.expired())
+            return;
+        if (!config)
+            qWarning() << "Can't calibrate rendering of" << path << "- keeping the defaults";
+
+        RenderTuning::saveCached(key, config);
+        if (const std::shared_ptr<SharedDocument> document = weak.lock(); document && config)
+            document->renderScheduler->setRenderConfig(*config);
+    });
+    QObject::connect(tuner, &QThread::finished, tuner, &QObject::deleteLater);
+    tuner->start(QThread::LowPriority);
+}
+
+int DocumentRegistry::carryOver(const SharedDocument& previous, const SharedDocument& document)
+{
+    // A document of its own: the scheduler may already be rendering from the
+    // shared one, and the hints have to match the thumbnail generator's for
+    // the fingerprints to be comparable
+    std::unique_ptr<Poppler::Document> pdf(Poppler::Document::load(document.path));
+    if (!pdf || pdf->isLocked())
+        return 0;
+    pdf->setRenderHint(Poppler::Document::Antialiasing, true);
+    pdf->setRenderHint(Poppler::Document::TextAntialiasing, true);
+
+    // Pages the old generator didn't get to have no fingerprint and are
+    // rendered again. Identical pages (blank ones, repeated codas) can all
+    // take the renders of any one of them.
+    const QList<QByteArray> previousHashes = previous.thumbnails->fingerprints();
+    QHash<QByteArray, int> previousPages;
+    QSet<QByteArray> previousTexts;
+    for (int page = 0; page < previousHashes.size(); ++page)
+    {
+        if (previousHashes[page].size() != PageFingerprint::SIZE)
+            continue;
+        previousPages.insert(previousHashes[page], page);
+        previousTexts.insert(PageFingerprint::textPart(previousHashes[page]));
+    }
+
+    // Size and text tell most edited pages apart without rendering them,
+    // only the pages that may be unchanged are rasterized to compare the
+    // notation. The others are left to the thumbnail generator, which
+    // renders them anyway.
+    QList<QByteArray> hashes(pdf->numPages());
+    QMultiHash<int, int> pages;
+    int rasterized = 0;
+    for (int page = 0; page < hashes.size(); ++page)
+    {
+        std::unique_ptr<Poppler::Page> p(pdf->page(page));
+        const QByteArray text = PageFingerprint::textHash(p.get());
+        if (text.isEmpty() || !previousTexts.contains(text))
+            continue;
+
+        hashes[page] = PageFingerprint::compute(p.get(), text);
+        ++rasterized;
+        const auto match = previousPages.constFind(hashes[page]);
+        if (!hashes[page].isEmpty() && match != previousPages.cend())
+            pages.insert(match.value(), page);
+    }
+    document.thumbnails->setFingerprints(hashes);
+
+    const int thumbnails = document.thumbnails->adoptThumbnails(*previous.thumbnails, pages);
+    const int images = document.renderCache->adopt(*previous.renderCache, pages);
+    DEBUG << "Rasterized" << rasterized << "of" << hashes.size() << "pages to compare them, carried"
+          << images << "rendered images and" << thumbnails << "thumbnails over to the new version";
+    return int(pages.size());
+}
+
+QVariantMap DocumentRegistry::stats()
+{
+    QMutexLocker locker(&mutex);
+
+    QVariantList open;
+    for (auto it = documents.cbegin(); it != documents.cend(); ++it)
+    {
+        const std::shared_ptr<SharedDocument> document = it.value().lock();
+        if (!document)
+            continue;
+        QVariantMap entry;
+        entry["path"] = document->path;
+        entry["views"] = qint64(document.use_count()) - 1; // Minus the one held here
+        entry["cacheBytes"] = document->renderCache->stats().value("bytes");
+        open.append(entry);
+    }
+
+    QVariantMap result;
+    result["documents"] = open;
+    result["opened"] = opened;
+    result["shared"] = shared;
+    result["preloadMs"] = preloadMs;
+    return result;
+}
@@ -0,0 +1,92 @@
+// documentRegistry.h
+#ifndef DOCUMENTREGISTRY_H
+#define DOCUMENTREGISTRY_H
+
+#include <QHash>
+#include <QMutex>
+#include <QSet>
+#include <QString>
+#include <QVariantMap>
+#include <QWaitCondition>
+#include <poppler-qt6.h>
+#include "documentMetadata.h"
+#include "renderCache.h"
+#include "renderScheduler.h"
+#include "thumbnailStore.h"
+#include <atomic>
+#include <functional>
+#include <memory>
+
+// Everything about an open file that doesn't depend on how it is shown:
+// the parsed document, its metadata, rendered pages and thumbnails. Views
+// of the same file (a second window, a mirror on a conductor screen) hold
+// the same instance, so the file is parsed and every page rendered once.
+struct SharedDocument
+{
+    ~SharedDocument();
+
+    QString key; // DocumentMetadata::fileKey of the file
+    QString path;
+    std::shared_ptr<Poppler::Document> document;
+    DocumentMetadata metadata;
+    std::shared_ptr<RenderCache> renderCache;
+    std::shared_ptr<RenderScheduler> renderScheduler;
+    std::shared_ptr<ThumbnailStore> thumbnails;
+    // Render configuration calibrated, or being calibrated (see RenderTuning)
+    std::atomic_bool tuned{false};
+};
+
+// Process-wide map from file identity to the open document. Entries are
+// weak: a document is closed when the last view holding it lets go, and a
+// file that changed on disk gets a new key and is opened fresh.
+class DocumentRegistry
+{
+public:
+    // The open document for this file, loaded if no view has it yet. Null
+    // with errorMessage set if the file can't be opened. GUI thread only.
+    static std::shared_ptr<SharedDocument> acquire(const QString& path, QString* errorMessage);
+
+    // Session restore: loads the document on a background thread while the
+    // QML is still starting and queues pageCount pages from firstPage at
+    // the resolution, mode and effects of key. The document stays open
+    // until the first view acquires a document, acquiring this one while
+    // it's loading waits for it instead of loading it twice.
+    static void preload(const QString& path, int firstPage, int pageCount, const RenderKey& key);
+
+    // Opens the new version of a file that changed on disk, on a background
+    // thread. Pages whose fingerprint is the same as in previous keep their
+    // rendered images. done runs on the thread of context with the new
+    // document (previous if the file is the same after all, null if it
+    // can't be opened) and how many pages were carried over.
+    static void reload(std::shared_ptr<SharedDocument> previous, QObject* context,
+                       std::function<void(std::shared_ptr<SharedDocument>, int, const QString&)> done);
+
+    // Calibrates the render backend and hints of a document that has none
+    // yet, on a background thread once the scheduler has nothing urgent to
+    // render. The choice is remembered for the file and applied to the
+    // scheduler as soon as it is made.
+    static void tune(std::shared_ptr<SharedDocument> document);
+
+    // Open documents and how many views share each
+    static QVariantMap stats();
+
+private:
+    // withOutline false leaves reading the outline of a file without a
+    // sidecar to the view (see PdfModel::buildSongIndex)
+    static std::shared_ptr<SharedDocument> load(const QString& path, const QString& key,
+                                                QString* errorMessage, bool withOutline = true);
+    static int carryOver(const SharedDocument& previous, const SharedDocument& document);
+
+    static QMutex mutex;
+    static QHash<QString, std::weak_ptr<SharedDocument>> documents;
+    static quint64 opened;
+    static quint64 shared;
+
+    static QWaitCondition preloadDone;
+    static QString preloadingPath; // Absolute, empty when nothing is loading
+    static QSet<QString> reloading; // Keys of documents being reloaded
+    static std::shared_ptr<SharedDocument> preloaded;
+    static qint64 preloadMs;
+};
+
+#endif // DOCUMENTREGISTRY_H
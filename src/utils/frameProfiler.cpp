@@ -0,0 +1,310 @@
+// frameProfiler.cpp
+#include "frameProfiler.h"
+#include "pdfModel.h"
+#include <QDateTime>
+#include <QDir>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <QScreen>
+#include <QStandardPaths>
+#include <QDebug>
+#include <cmath>
+
+static const int SUMMARY_INTERVAL_MS = 250;
+static const qint64 SUMMARY_WINDOW_NS = 1000000000;
+static const qint64 IDLE_GAP_NS = 100000000;
+
+std::atomic<int> FrameProfiler::pendingUploads{0};
+std::atomic<qint64> FrameProfiler::pendingUploadBytes{0};
+
+static double toMs(qint64 ns)
+{
+    return ns / 1e6;
+}
+
+FrameProfiler::FrameProfiler(QObject* parent)
+    : QObject(parent)
+{
+    clock.start();
+    frames.reserve(MAX_FRAMES);
+
+    summaryTimer.setInterval(SUMMARY_INTERVAL_MS);
+    connect(&summaryTimer, &QTimer::timeout, this, &FrameProfiler::updateSummary);
+}
+
+void FrameProfiler::attach(QQuickWindow* quickWindow)
+{
+    window = quickWindow;
+    if (!window)
+        return;
+
+    const auto updateRefresh = [this](QScreen* screen) {
+        if (screen && screen->refreshRate() > 1.0)
+            refreshNs = qint64(1e9 / screen->refreshRate());
+    };
+    updateRefresh(window->screen());
+    connect(window, &QWindow::screenChanged, this, updateRefresh);
+
+    // All direct: the render thread must not wait for the GUI thread to
+    // report its own timings
+    connect(window, &QQuickWindow::afterAnimating, this, [this] {
+        animatedAt = clock.nsecsElapsed();
+    }, Qt::DirectConnection);
+    connect(window, &QQuickWindow::beforeSynchronizing, this, [this] {
+        syncStart = clock.nsecsElapsed();
+        const qint64 animated = animatedAt.exchange(-1);
+        animateNs = animated >= 0 ? syncStart - animated : 0;
+    }, Qt::DirectConnection);
+    connect(window, &QQuickWindow::afterSynchronizing, this, [this] {
+        syncEnd = clock.nsecsElapsed();
+        frameUploads += pendingUploads.exchange(0);
+        frameUploadBytes += pendingUploadBytes.exchange(0);
+    }, Qt::DirectConnection);
+    connect(window, &QQuickWindow::beforeRendering, this, [this] {
+        renderStart = clock.nsecsElapsed();
+    }, Qt::DirectConnection);
+    connect(window, &QQuickWindow::afterRendering, this, [this] {
+        renderEnd = clock.nsecsElapsed();
+    }, Qt::DirectConnection);
+    connect(window, &QQuickWindow::frameSwapped, this, &FrameProfiler::frameSwapped, Qt::DirectConnection);
+}
+
+void FrameProfiler::noteImageUpload(qint64 bytes)
+{
+    pendingUploads.fetch_add(1, std::memory_order_relaxed);
+    pendingUploadBytes.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+void FrameProfiler::frameSwapped()
+{
+    Frame frame;
+    frame.swappedNs = clock.nsecsElapsed();
+    frame.intervalNs = lastSwap >= 0 ? frame.swappedNs - lastSwap : 0;
+    frame.animateNs = animateNs;
+    frame.syncNs = syncEnd - syncStart;
+    frame.renderNs = renderEnd - renderStart;
+    frame.swapNs = frame.swappedNs - renderEnd;
+    frame.uploads = frameUploads;
+    frame.uploadBytes = frameUploadBytes;
+    lastSwap = frame.swappedNs;
+    frameUploads = 0;
+    frameUploadBytes = 0;
+
+    // Half a period of slack: vsync timestamps jitter. A long gap is the
+    // window idling between updates, unless an animation was running.
+    QMutexLocker locker(&mutex);
+    const qint64 refresh = refreshNs;
+    if (frame.intervalNs > 0 && (frame.intervalNs < IDLE_GAP_NS || !openSpans.isEmpty()))
+        frame.missed = qMax(0, int(std::floor(double(frame.intervalNs) / refresh + 0.5)) - 1);
+
+    if (frames.size() < MAX_FRAMES)
+        frames.append(frame);
+    else
+        frames[frameCount % MAX_FRAMES] = frame;
+    ++frameCount;
+}
+
+QList<FrameProfiler::Frame> FrameProfiler::framesSince(qint64 ns) const
+{
+    // Frames whose whole interval is inside the period: the first frame
+    // after an idle stretch isn't a missed vsync
+    QList<Frame> result;
+    QMutexLocker locker(&mutex);
+    const int count = frames.size();
+    for (int i = 0; i < count; ++i)
+    {
+        const Frame& frame = frames[(frameCount - count + i) % MAX_FRAMES];
+        if (frame.swappedNs - frame.intervalNs >= ns && frame.intervalNs > 0)
+            result.append(frame);
+    }
+    return result;
+}
+
+void FrameProfiler::beginSpan(const QString& kind)
+{
+    QMutexLocker locker(&mutex);
+    openSpans.insert(kind, clock.nsecsElapsed());
+}
+
+void FrameProfiler::endSpan(const QString& kind)
+{
+    qint64 start;
+    {
+        QMutexLocker locker(&mutex);
+        start = openSpans.take(kind);
+        if (start == 0)
+            return;
+    }
+
+    Span span;
+    span.kind = kind;
+    span.startNs = start;
+    span.endNs = clock.nsecsElapsed();
+    for (const Frame& frame : framesSince(start))
+    {
+        if (frame.swappedNs > span.endNs)
+            break;
+        ++span.frames;
+        span.missed += frame.missed;
+        span.uploads += frame.uploads;
+        span.uploadBytes += frame.uploadBytes;
+        span.worstFrameNs = qMax(span.worstFrameNs, frame.intervalNs);
+        span.renderNs += frame.renderNs;
+    }
+    if (span.missed > 0)
+        DEBUG << "Frame profiler:" << kind << "missed" << span.missed << "vsyncs in" << span.frames
+              << "frames, worst" << toMs(span.worstFrameNs) << "ms," << span.uploads << "image uploads";
+
+    QMutexLocker locker(&mutex);
+    finishedSpans.append(span);
+    if (finishedSpans.size() > MAX_SPANS)
+        finishedSpans.removeFirst();
+}
+
+QVariantMap FrameProfiler::toVariant(const Span& span)
+{
+    QVariantMap result;
+    result["kind"] = span.kind;
+    result["durationMs"] = toMs(span.endNs - span.startNs);
+    result["frames"] = span.frames;
+    result["missed"] = span.missed;
+    result["worstFrameMs"] = toMs(span.worstFrameNs);
+    result["averageRenderMs"] = span.frames > 0 ? toMs(span.renderNs / span.frames) : 0.0;
+    result["uploads"] = span.uploads;
+    result["uploadKiB"] = span.uploadBytes / 1024;
+    return result;
+}
+
+QVariantList FrameProfiler::spans() const
+{
+    QVariantList result;
+    QMutexLocker locker(&mutex);
+    for (const Span& span : finishedSpans)
+        result.append(toVariant(span));
+    return result;
+}
+
+void FrameProfiler::setLive(bool enabled)
+{
+    if (enabled == live)
+        return;
+
+    live = enabled;
+    emit liveChanged();
+    if (live)
+    {
+        updateSummary();
+        summaryTimer.start();
+    }
+    else
+    {
+        summaryTimer.stop();
+    }
+}
+
+void FrameProfiler::updateSummary()
+{
+    const qint64 now = clock.nsecsElapsed();
+    const QList<Frame> recent = framesSince(now - SUMMARY_WINDOW_NS);
+
+    qint64 worst = 0;
+    qint64 animate = 0;
+    qint64 sync = 0;
+    qint64 render = 0;
+    qint64 swap = 0;
+    int missed = 0;
+    int uploads = 0;
+    for (const Frame& frame : recent)
+    {
+        worst = qMax(worst, frame.intervalNs);
+        animate += frame.animateNs;
+        sync += frame.syncNs;
+        render += frame.renderNs;
+        swap += frame.swapNs;
+        missed += frame.missed;
+        uploads += frame.uploads;
+    }
+    const qint64 count = qMax<qint64>(1, recent.size());
+
+    QVariantMap result;
+    result["fps"] = recent.size();
+    result["refreshHz"] = qRound(1e9 / refreshNs);
+    result["worstFrameMs"] = toMs(worst);
+    result["animateMs"] = toMs(animate / count);
+    result["syncMs"] = toMs(sync / count);
+    result["renderMs"] = toMs(render / count);
+    result["swapMs"] = toMs(swap / count);
+    result["missed"] = missed;
+    result["uploads"] = uploads;
+
+    QMutexLocker locker(&mutex);
+    result["lastSpan"] = finishedSpans.isEmpty() ? QVariantMap() : toVariant(finishedSpans.last());
+    int spanMissed = 0;
+    for (const Span& span : finishedSpans)
+        spanMissed += span.missed;
+    result["spans"] = finishedSpans.size();
+    result["spanMissed"] = spanMissed;
+    locker.unlock();
+
+    summary = result;
+    emit summaryChanged();
+}
+
+QString FrameProfiler::dump(const QString& fileName) const
+{
+    QString path = fileName;
+    if (path.isEmpty())
+    {
+        const QString directory = QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation);
+        QDir().mkpath(directory);
+        path = directory + "/frames-" + QDateTime::currentDateTime().toString("yyyyMMdd-HHmmss") + ".json";
+    }
+
+    QJsonArray frameList;
+    for (const Frame& frame : framesSince(0))
+    {
+        QJsonObject entry;
+        entry["t"] = toMs(frame.swappedNs);
+        entry["interval"] = toMs(frame.intervalNs);
+        entry["animate"] = toMs(frame.animateNs);
+        entry["sync"] = toMs(frame.syncNs);
+        entry["render"] = toMs(frame.renderNs);
+        entry["swap"] = toMs(frame.swapNs);
+        entry["missed"] = frame.missed;
+        entry["uploads"] = frame.uploads;
+        entry["uploadKiB"] = frame.uploadBytes / 1024;
+        frameList.append(entry);
+    }
+
+    QJsonArray spanList;
+    {
+        QMutexLocker locker(&mutex);
+        for (const Span& span : finishedSpans)
+        {
+            QJsonObject entry = QJsonObject::fromVariantMap(toVariant(span));
+            entry["t"] = toMs(span.startNs);
+            spanList.append(entry);
+        }
+    }
+
+    QJsonObject root;
+    root["refreshHz"] = 1e9 / refreshNs;
+    root["frames"] = frameList;
+    root["spans"] = spanList;
+
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly))
+    {
+        qWarning() << "Can't write frame profile to" << path;
+        return QString();
+    }
+    file.write(QJsonDocument(root).toJson(QJsonDocument::Compact));
+    if (!file.commit())
+        return QString();
+
+    qDebug() << "Frame profile written to" << path;
+    return path;
+}
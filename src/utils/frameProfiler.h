@@ -0,0 +1,124 @@
+// frameProfiler.h
+#ifndef FRAMEPROFILER_H
+#define FRAMEPROFILER_H
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QObject>
+#include <QPointer>
+#include <QQuickWindow>
+#include <QTimer>
+#include <QVariantMap>
+#include <atomic>
+
+// Per-frame timings of a QQuickWindow, taken from the render loop signals:
+// the time the GUI thread spent between advancing animations and the
+// scene graph sync (polish, bindings), the sync itself, the render pass
+// and the swap. Frames that took longer than a refresh period count as
+// missed vsyncs. Page images handed to the scene graph are counted per
+// frame, since their texture uploads land in that frame's sync.
+//
+// The view marks its animations (page turns, smoothed scrolling, flicks)
+// as spans; each finished span gets its frame count, missed vsyncs, worst
+// frame and uploads, which is what tells a stutter caused by a late render
+// from one caused by an upload. The last MAX_FRAMES frames and MAX_SPANS
+// spans are kept, a summary is published for the live view and everything
+// can be dumped to a JSON file.
+class FrameProfiler : public QObject
+{
+    Q_OBJECT
+    // Last second of frames and the last span, updated while live is set
+    Q_PROPERTY(QVariantMap summary READ getSummary NOTIFY summaryChanged)
+    Q_PROPERTY(bool live READ isLive WRITE setLive NOTIFY liveChanged)
+
+public:
+    explicit FrameProfiler(QObject* parent = nullptr);
+
+    void attach(QQuickWindow* window);
+
+    // Any thread: an image is about to be turned into a texture
+    static void noteImageUpload(qint64 bytes);
+
+    QVariantMap getSummary() const { return summary; }
+    bool isLive() const { return live; }
+    void setLive(bool enabled);
+
+    Q_INVOKABLE void beginSpan(const QString& kind);
+    Q_INVOKABLE void endSpan(const QString& kind);
+    Q_INVOKABLE QVariantList spans() const;
+    // Writes frames and spans as JSON, to the app data location when no
+    // file name is given. Returns the file written, empty on failure.
+    Q_INVOKABLE QString dump(const QString& fileName = QString()) const;
+
+    static const int MAX_FRAMES = 3600; // A minute at 60 Hz
+    static const int MAX_SPANS = 200;
+
+signals:
+    void summaryChanged();
+    void liveChanged();
+
+private:
+    struct Frame
+    {
+        qint64 swappedNs = 0;
+        qint64 intervalNs = 0; // Since the previous swap
+        qint64 animateNs = 0;  // GUI thread, animations to sync
+        qint64 syncNs = 0;
+        qint64 renderNs = 0;
+        qint64 swapNs = 0;
+        int missed = 0;
+        int uploads = 0;
+        qint64 uploadBytes = 0;
+    };
+
+    struct Span
+    {
+        QString kind;
+        qint64 startNs = 0;
+        qint64 endNs = 0;
+        int frames = 0;
+        int missed = 0;
+        int uploads = 0;
+        qint64 uploadBytes = 0;
+        qint64 worstFrameNs = 0;
+        qint64 renderNs = 0; // Sum over the frames
+    };
+
+    void frameSwapped();
+    void updateSummary();
+    QList<Frame> framesSince(qint64 ns) const;
+    static QVariantMap toVariant(const Span& span);
+
+    QPointer<QQuickWindow> window;
+    QElapsedTimer clock;
+    std::atomic<qint64> refreshNs{16666667};
+    std::atomic<qint64> animatedAt{-1};
+
+    // Render thread only
+    qint64 syncStart = 0;
+    qint64 syncEnd = 0;
+    qint64 renderStart = 0;
+    qint64 renderEnd = 0;
+    qint64 animateNs = 0;
+    qint64 lastSwap = -1;
+    int frameUploads = 0;
+    qint64 frameUploadBytes = 0;
+
+    mutable QMutex mutex;
+    QList<Frame> frames; // Ring of MAX_FRAMES
+    quint64 frameCount = 0;
+    QList<Span> finishedSpans;
+    QHash<QString, qint64> openSpans;
+
+    // GUI thread
+    QTimer summaryTimer;
+    QVariantMap summary;
+    bool live = false;
+
+    static std::atomic<int> pendingUploads;
+    static std::atomic<qint64> pendingUploadBytes;
+};
+
+#endif // FRAMEPROFILER_H
@@ -0,0 +1,470 @@
+// libraryIndex.cpp
+#include "libraryIndex.h"
+#include "pdfModel.h"
+#include "thumbnailStore.h"
+#include <QDataStream>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QSet>
+#include <QStandardPaths>
+#include <QUrl>
+#include <QDebug>
+#include <algorithm>
+#include <tuple>
+
+static const quint32 INDEX_MAGIC = 0x53534c49; // "SSLI"
+static const quint16 INDEX_VERSION = 1;
+// Folder change notifications come in bursts while files are copied
+static const int RESCAN_DELAY_MS = 2000;
+// Found documents show up in batches rather than one by one
+static const int UPDATE_INTERVAL_MS = 1000;
+
+static QDataStream& operator<<(QDataStream& out, const LibraryEntry& entry)
+{
+    return out << entry.path << entry.size << entry.modified << entry.title << entry.documentTitle
+               << qint32(entry.pageCount) << entry.outline << entry.thumbnail;
+}
+
+static QDataStream& operator>>(QDataStream& in, LibraryEntry& entry)
+{
+    qint32 pageCount;
+    in >> entry.path >> entry.size >> entry.modified >> entry.title >> entry.documentTitle
+       >> pageCount >> entry.outline >> entry.thumbnail;
+    entry.pageCount = pageCount;
+    return in;
+}
+
+LibraryIndex::LibraryIndex(QObject* parent)
+    : QObject(parent)
+{
+    // Opening PDFs is mostly parsing, half the cores leave room for the
+    // render scheduler and the UI
+    pool.setMaxThreadCount(qMax(1, QThread::idealThreadCount() / 2));
+    pool.setThreadPriority(QThread::LowPriority);
+
+    rescanTimer.setSingleShot(true);
+    rescanTimer.setInterval(RESCAN_DELAY_MS);
+    connect(&rescanTimer, &QTimer::timeout, this, &LibraryIndex::rescan);
+    connect(&watcher, &QFileSystemWatcher::directoryChanged, &rescanTimer, qOverload<>(&QTimer::start));
+
+    updateTimer.setSingleShot(true);
+    updateTimer.setInterval(UPDATE_INTERVAL_MS);
+    connect(&updateTimer, &QTimer::timeout, this, &LibraryIndex::rebuildSearchIndex);
+
+    // The saved index is searchable before the folders have been checked
+    indexBuilder = QThread::create([this] {
+        QElapsedTimer timer;
+        timer.start();
+        const QList<LibraryEntry> saved = loadIndex();
+        std::shared_ptr<SongIndex> index = buildSearchIndex(saved);
+        DEBUG << "Library index of" << saved.size() << "documents loaded in" << timer.elapsed() << "ms";
+
+        QMetaObject::invokeMethod(this, [this, saved, index] {
+            for (const LibraryEntry& entry : saved)
+                entries.insert(entry.path, entry);
+            searchEntries = saved;
+            searchIndex = index;
+            loaded = true;
+            emit documentsChanged();
+            if (!folders.isEmpty())
+                rescan();
+        }, Qt::QueuedConnection);
+    });
+    connect(indexBuilder, &QThread::finished, indexBuilder, &QObject::deleteLater);
+    indexBuilder->start(QThread::LowPriority);
+}
+
+LibraryIndex::~LibraryIndex()
+{
+    stopping = true;
+    pool.clear();
+    pool.waitForDone();
+    if (indexBuilder)
+        indexBuilder->wait();
+}
+
+void LibraryIndex::setFolders(const QStringList& newFolders)
+{
+    if (newFolders == folders)
+        return;
+
+    folders = newFolders;
+    emit foldersChanged();
+    rescan();
+}
+
+void LibraryIndex::rescan()
+{
+    // Once the saved index is there, or every file would look new
+    if (!loaded)
+        return;
+    if (scanning)
+    {
+        rescanPending = true;
+        return;
+    }
+
+    QHash<QString, std::pair<qint64, qint64>> known;
+    known.reserve(entries.size());
+    for (const LibraryEntry& entry : std::as_const(entries))
+        known.insert(entry.path, {entry.size, entry.modified});
+
+    scanning = true;
+    walking = true;
+    scanTimer.start();
+    emit scanningChanged();
+
+    pool.start([this, roots = folders, known] {
+        QStringList directories;
+        QSet<QString> found;
+        QList<std::tuple<QString, qint64, qint64>> changed;
+        for (const QString& root : roots)
+        {
+            if (!QFileInfo(root).isDir())
+                continue;
+            directories.append(root);
+
+            QDirIterator it(root, QDir::Dirs | QDir::Files | QDir::NoDotAndDotDot | QDir::Readable,
+                            QDirIterator::Subdirectories | QDirIterator::FollowSymlinks);
+            while (it.hasNext() && !stopping)
+            {
+                const QFileInfo info = it.nextFileInfo();
+                if (info.isDir())
+                {
+                    directories.append(info.absoluteFilePath());
+                    continue;
+                }
+                if (info.suffix().compare("pdf", Qt::CaseInsensitive) != 0)
+                    continue;
+
+                const QString path = info.absoluteFilePath();
+                if (found.contains(path))
+                    continue;
+                found.insert(path);
+
+                const qint64 size = info.size();
+                const qint64 modified = info.lastModified().toMSecsSinceEpoch();
+                const auto previous = known.constFind(path);
+                if (previous == known.cend() || previous->first != size || previous->second != modified)
+                    changed.append({path, size, modified});
+            }
+        }
+
+        // Files gone, and those of folders no longer in the library
+        QStringList removed;
+        for (auto it = known.cbegin(); it != known.cend(); ++it)
+        {
+            if (!found.contains(it.key()))
+                removed.append(it.key());
+        }
+
+        // Posted before the files are queued, so it is handled before any
+        // of their results
+        QMetaObject::invokeMethod(this, [this, checked = int(found.size()), count = int(changed.size()),
+                                         removed, directories] {
+            walkDone(checked, count, removed, directories);
+        }, Qt::QueuedConnection);
+
+        for (const auto& [path, size, modified] : std::as_const(changed))
+        {
+            pool.start([this, path, size, modified] {
+                if (stopping)
+                    return;
+                const LibraryEntry entry = readEntry(path, size, modified);
+                QMetaObject::invokeMethod(this, [this, entry] { addEntry(entry); }, Qt::QueuedConnection);
+            });
+        }
+    });
+}
+
+void LibraryIndex::walkDone(int checked, int changed, const QStringList& removed,
+                            const QStringList& directories)
+{
+    walking = false;
+    filesChecked = checked;
+    filesOpened = changed;
+
+    for (const QString& path : removed)
+    {
+        const LibraryEntry entry = entries.take(path);
+        if (!entry.thumbnail.isEmpty())
+            QFile::remove(entry.thumbnail);
+    }
+    if (!removed.isEmpty())
+        scheduleUpdate();
+
+    if (!watcher.directories().isEmpty())
+        watcher.removePaths(watcher.directories());
+    if (!directories.isEmpty())
+        watcher.addPaths(directories);
+
+    pendingFiles += changed;
+    emit pendingFilesChanged();
+    if (pendingFiles == 0)
+        finishScan();
+}
+
+void LibraryIndex::addEntry(const LibraryEntry& entry)
+{
+    const auto previous = entries.constFind(entry.path);
+    if (previous != entries.cend() && !previous->thumbnail.isEmpty() && previous->thumbnail != entry.thumbnail)
+        QFile::remove(previous->thumbnail);
+    entries.insert(entry.path, entry);
+    scheduleUpdate();
+
+    --pendingFiles;
+    emit pendingFilesChanged();
+    if (!walking && pendingFiles == 0)
+        finishScan();
+}
+
+void LibraryIndex::finishScan()
+{
+    lastScanMs = scanTimer.elapsed();
+    scanning = false;
+    emit scanningChanged();
+    DEBUG << "Library scanned in" << lastScanMs << "ms:" << filesChecked << "files," << filesOpened << "opened";
+
+    if (rescanPending)
+    {
+        rescanPending = false;
+        rescan();
+    }
+}
+
+void LibraryIndex::scheduleUpdate()
+{
+    // Not restarted, so a long scan still publishes every interval
+    if (!updateTimer.isActive())
+        updateTimer.start();
+}
+
+void LibraryIndex::rebuildSearchIndex()
+{
+    if (indexBuilder)
+    {
+        rebuildPending = true;
+        return;
+    }
+
+    QList<LibraryEntry> snapshot = entries.values();
+    std::sort(snapshot.begin(), snapshot.end(), [](const LibraryEntry& a, const LibraryEntry& b) {
+        return QString::localeAwareCompare(a.title, b.title) < 0;
+    });
+
+    indexBuilder = QThread::create([this, snapshot] {
+        std::shared_ptr<SongIndex> index = buildSearchIndex(snapshot);
+        saveIndex(snapshot);
+        QMetaObject::invokeMethod(this, [this, snapshot, index] {
+            searchEntries = snapshot;
+            searchIndex = index;
+            emit documentsChanged();
+        }, Qt::QueuedConnection);
+    });
+    connect(indexBuilder, &QThread::finished, this, [this] {
+        if (rebuildPending)
+        {
+            rebuildPending = false;
+            scheduleUpdate();
+        }
+    });
+    connect(indexBuilder, &QThread::finished, indexBuilder, &QObject::deleteLater);
+    indexBuilder->start(QThread::LowPriority);
+}
+
+std::shared_ptr<SongIndex> LibraryIndex::buildSearchIndex(const QList<LibraryEntry>& entries)
+{
+    QList<OutlineEntry> titles;
+    QList<int> documents;
+    for (int i = 0; i < entries.size(); ++i)
+    {
+        const LibraryEntry& entry = entries[i];
+        if (entry.pageCount <= 0)
+            continue;
+
+        titles.append({entry.title, 0});
+        documents.append(i);
+        if (!entry.documentTitle.isEmpty() && entry.documentTitle != entry.title)
+        {
+            titles.append({entry.documentTitle, 0});
+            documents.append(i);
+        }
+        for (const OutlineEntry& item : entry.outline)
+        {
+            titles.append(item);
+            documents.append(i);
+        }
+    }
+
+    auto index = std::make_shared<SongIndex>();
+    index->build(titles, documents);
+    return index;
+}
+
+QVariantMap LibraryIndex::toVariant(const LibraryEntry& entry, int page, const QString& song) const
+{
+    QVariantMap item;
+    item["path"] = entry.path;
+    item["title"] = entry.title;
+    item["pageCount"] = entry.pageCount;
+    item["thumbnail"] = entry.thumbnail.isEmpty() ? QString() : QUrl::fromLocalFile(entry.thumbnail).toString();
+    item["page"] = page;
+    item["song"] = song;
+    return item;
+}
+
+QVariantList LibraryIndex::search(const QString& query, int limit) const
+{
+    QVariantList result;
+    if (!searchIndex)
+        return result;
+
+    QElapsedTimer timer;
+    timer.start();
+
+    // A document matching by file name and by its info title shows once
+    QSet<std::pair<int, QString>> seen;
+    const QVariantList matches = searchIndex->search(query, limit * 2);
+    for (const QVariant& match : matches)
+    {
+        const QVariantMap map = match.toMap();
+        const int document = map["document"].toInt();
+        if (document < 0 || document >= searchEntries.size())
+            continue;
+
+        const LibraryEntry& entry = searchEntries[document];
+        const QString title = map["title"].toString();
+        const bool wholeDocument = title == entry.title.trimmed() || title == entry.documentTitle.trimmed();
+        const QString song = wholeDocument ? QString() : title;
+        if (seen.contains({document, song}))
+            continue;
+        seen.insert({document, song});
+
+        result.append(toVariant(entry, map["page"].toInt(), song));
+        if (result.size() == limit)
+            break;
+    }
+
+    DEBUG << "Library search for" << query << "took" << timer.nsecsElapsed() / 1000 << "us";
+    return result;
+}
+
+QVariantList LibraryIndex::documents() const
+{
+    QVariantList result;
+    result.reserve(searchEntries.size());
+    for (const LibraryEntry& entry : searchEntries)
+    {
+        if (entry.pageCount > 0)
+            result.append(toVariant(entry, 0, QString()));
+    }
+    return result;
+}
+
+QVariantMap LibraryIndex::stats() const
+{
+    QVariantMap result;
+    result["documents"] = searchEntries.size();
+    result["titles"] = searchIndex ? searchIndex->size() : 0;
+    result["folders"] = folders.size();
+    result["watchedDirectories"] = watcher.directories().size();
+    result["lastScanMs"] = lastScanMs;
+    result["filesChecked"] = filesChecked;
+    result["filesOpened"] = filesOpened;
+    return result;
+}
+
+LibraryEntry LibraryIndex::readEntry(const QString& path, qint64 size, qint64 modified)
+{
+    LibraryEntry entry;
+    entry.path = path;
+    entry.size = size;
+    entry.modified = modified;
+    entry.title = QFileInfo(path).completeBaseName();
+
+    // Unreadable files stay in the index too, so they aren't retried on
+    // every scan until they change
+    std::unique_ptr<Poppler::Document> document(Poppler::Document::load(path));
+    if (!document || document->isLocked())
+    {
+        DEBUG << "Library: can't open" << path;
+        return entry;
+    }
+    document->setRenderHint(Poppler::Document::Antialiasing, true);
+    document->setRenderHint(Poppler::Document::TextAntialiasing, true);
+
+    entry.documentTitle = document->info("Title").trimmed();
+    entry.pageCount = document->numPages();
+    entry.outline = DocumentMetadata::outlineOf(document.get());
+
+    std::unique_ptr<Poppler::Page> page(document->page(0));
+    if (page)
+    {
+        const double dpi = ThumbnailStore::thumbnailDpi(page->pageSizeF());
+        const QImage image = page->renderToImage(dpi, dpi);
+        const QString fileName = cacheDirectory() + "/" + DocumentMetadata::fileKey(path) + ".png";
+        if (!image.isNull() && image.save(fileName))
+            entry.thumbnail = fileName;
+        else
+            qWarning() << "Failed to save library thumbnail of" << path;
+    }
+    return entry;
+}
+
+QString LibraryIndex::cacheDirectory()
+{
+    static const QString directory = [] {
+        const QString path = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/library";
+        QDir().mkpath(path);
+        return path;
+    }();
+    return directory;
+}
+
+QList<LibraryEntry> LibraryIndex::loadIndex()
+{
+    QFile file(cacheDirectory() + "/index.bin");
+    if (!file.open(QIODevice::ReadOnly))
+        return {};
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_6_5);
+    in.setFloatingPointPrecision(QDataStream::SinglePrecision);
+
+    quint32 magic;
+    quint16 version;
+    in >> magic >> version;
+    if (magic != INDEX_MAGIC || version != INDEX_VERSION)
+    {
+        DEBUG << "Ignoring library index with unknown format:" << file.fileName();
+        return {};
+    }
+
+    QList<LibraryEntry> entries;
+    in >> entries;
+    if (in.status() != QDataStream::Ok)
+    {
+        qWarning() << "Corrupt library index, rebuilding it:" << file.fileName();
+        return {};
+    }
+    return entries;
+}
+
+void LibraryIndex::saveIndex(const QList<LibraryEntry>& entries)
+{
+    QSaveFile file(cacheDirectory() + "/index.bin");
+    if (!file.open(QIODevice::WriteOnly))
+    {
+        qWarning() << "Can't write library index" << file.fileName();
+        return;
+    }
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_6_5);
+    out.setFloatingPointPrecision(QDataStream::SinglePrecision);
+    out << INDEX_MAGIC << INDEX_VERSION << entries;
+    file.commit();
+}
@@ -0,0 +1,116 @@
+// libraryIndex.h
+#ifndef LIBRARYINDEX_H
+#define LIBRARYINDEX_H
+
+#include <QElapsedTimer>
+#include <QFileSystemWatcher>
+#include <QHash>
+#include <QList>
+#include <QObject>
+#include <QPointer>
+#include <QStringList>
+#include <QThread>
+#include <QThreadPool>
+#include <QTimer>
+#include <QVariantList>
+#include "documentMetadata.h"
+#include "songIndex.h"
+#include <atomic>
+#include <memory>
+
+// What the library knows about one PDF
+struct LibraryEntry
+{
+    QString path;
+    qint64 size = 0;
+    qint64 modified = 0;   // ms since the epoch
+    QString title;         // File name without the extension
+    QString documentTitle; // From the document info, often empty or junk
+    int pageCount = 0;     // 0 if the file can't be opened
+    QList<OutlineEntry> outline;
+    QString thumbnail;     // First page, PNG in the cache; empty if none
+};
+
+// The PDFs found in the library folders, so a chart can be found among
+// thousands by typing a few letters of its name instead of through a file
+// dialog. Folders are walked on a thread pool and only files whose size or
+// modification time changed are opened, for their title, page count,
+// outline and a thumbnail of the first page. The index is kept in the
+// cache location, so a launch just checks the files again, and folders
+// are watched for changes. File names, document titles and outline
+// entries are all searchable through a SongIndex built in the background.
+class LibraryIndex : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(QStringList folders READ getFolders WRITE setFolders NOTIFY foldersChanged)
+    Q_PROPERTY(int documentCount READ getDocumentCount NOTIFY documentsChanged)
+    Q_PROPERTY(bool scanning READ isScanning NOTIFY scanningChanged)
+    // Files still to be opened by the running scan
+    Q_PROPERTY(int pendingFiles READ getPendingFiles NOTIFY pendingFilesChanged)
+
+public:
+    explicit LibraryIndex(QObject* parent = nullptr);
+    ~LibraryIndex();
+
+    QStringList getFolders() const { return folders; }
+    void setFolders(const QStringList& newFolders);
+    int getDocumentCount() const { return searchEntries.size(); }
+    bool isScanning() const { return scanning; }
+    int getPendingFiles() const { return pendingFiles; }
+
+    // Documents and songs matching query, best first, as { path, title,
+    // pageCount, thumbnail, page, song } maps; song is empty when the
+    // document itself matched
+    Q_INVOKABLE QVariantList search(const QString& query, int limit = 50) const;
+    // The whole library by title, for browsing without a query
+    Q_INVOKABLE QVariantList documents() const;
+    Q_INVOKABLE void rescan();
+    Q_INVOKABLE QVariantMap stats() const;
+
+signals:
+    void foldersChanged();
+    void documentsChanged();
+    void scanningChanged();
+    void pendingFilesChanged();
+
+private:
+    void walkDone(int checked, int changed, const QStringList& removed, const QStringList& directories);
+    void addEntry(const LibraryEntry& entry);
+    void finishScan();
+    void scheduleUpdate();
+    void rebuildSearchIndex();
+    QVariantMap toVariant(const LibraryEntry& entry, int page, const QString& song) const;
+
+    static LibraryEntry readEntry(const QString& path, qint64 size, qint64 modified);
+    static std::shared_ptr<SongIndex> buildSearchIndex(const QList<LibraryEntry>& entries);
+    static QList<LibraryEntry> loadIndex();
+    static void saveIndex(const QList<LibraryEntry>& entries);
+    static QString cacheDirectory();
+
+    QStringList folders;
+    QHash<QString, LibraryEntry> entries; // By path, the scan's view
+    // The entries the search index was built from, a document number in
+    // its matches is an index in this list
+    QList<LibraryEntry> searchEntries;
+    std::shared_ptr<SongIndex> searchIndex;
+    QPointer<QThread> indexBuilder;
+    bool loaded = false;
+    bool rebuildPending = false;
+
+    QThreadPool pool;
+    QFileSystemWatcher watcher;
+    QTimer rescanTimer;
+    QTimer updateTimer;
+    std::atomic_bool stopping{false};
+    bool scanning = false;
+    bool walking = false;
+    bool rescanPending = false;
+    int pendingFiles = 0;
+
+    QElapsedTimer scanTimer;
+    qint64 lastScanMs = -1;
+    int filesChecked = 0;
+    int filesOpened = 0;
+};
+
+#endif // LIBRARYINDEX_H
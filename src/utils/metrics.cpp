@@ -0,0 +1,150 @@
+// metrics.cpp
+#include "metrics.h"
+#include <QDateTime>
+#include <QDir>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QStandardPaths>
+#include <QDebug>
+#include <map>
+#include <memory>
+
+namespace
+{
+// Function statics, so metrics can be looked up from other statics
+struct Registry
+{
+    QMutex mutex;
+    std::map<QString, std::unique_ptr<Metrics::Counter>> counters;
+    std::map<QString, std::unique_ptr<Metrics::Gauge>> gauges;
+};
+
+Registry& registry()
+{
+    static Registry instance;
+    return instance;
+}
+}
+
+Metrics::Counter& Metrics::counter(const QString& name)
+{
+    Registry& r = registry();
+    QMutexLocker locker(&r.mutex);
+    std::unique_ptr<Counter>& entry = r.counters[name];
+    if (!entry)
+        entry = std::make_unique<Counter>();
+    return *entry;
+}
+
+Metrics::Gauge& Metrics::gauge(const QString& name)
+{
+    Registry& r = registry();
+    QMutexLocker locker(&r.mutex);
+    std::unique_ptr<Gauge>& entry = r.gauges[name];
+    if (!entry)
+        entry = std::make_unique<Gauge>();
+    return *entry;
+}
+
+Metrics::Metrics(QObject* parent)
+    : QObject(parent)
+{
+    uptime.start();
+
+    liveTimer.setInterval(LIVE_INTERVAL_MS);
+    connect(&liveTimer, &QTimer::timeout, this, &Metrics::publish);
+
+    // Only when asked for, SPIRITSHEET_METRICS_LOG=1. One file per launch,
+    // appended to as it goes so a crash loses at most one interval
+    if (qgetenv("SPIRITSHEET_METRICS_LOG") != "1")
+        return;
+
+    const QString directory = QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation) + "/metrics";
+    QDir().mkpath(directory);
+    log.setFileName(directory + "/metrics-" + QDateTime::currentDateTime().toString("yyyyMMdd-HHmmss") + ".jsonl");
+    logTimer.setInterval(LOG_INTERVAL_MS);
+    connect(&logTimer, &QTimer::timeout, this, &Metrics::writeLog);
+    logTimer.start();
+}
+
+void Metrics::setLive(bool enabled)
+{
+    if (enabled == live)
+        return;
+
+    live = enabled;
+    emit liveChanged();
+    if (live)
+    {
+        publish();
+        liveTimer.start();
+    }
+    else
+    {
+        liveTimer.stop();
+    }
+}
+
+QVariantMap Metrics::snapshot()
+{
+    return snapshot(callerBaseline);
+}
+
+QVariantMap Metrics::snapshot(Baseline& baseline) const
+{
+    const qint64 now = uptime.elapsed();
+    const double seconds = (now - baseline.ms) / 1000.0;
+    baseline.ms = now;
+
+    QVariantMap result;
+    result["uptimeS"] = now / 1000;
+
+    Registry& r = registry();
+    QMutexLocker locker(&r.mutex);
+    for (const auto& [name, counter] : r.counters)
+    {
+        const quint64 count = counter->get();
+        result[name] = count;
+        quint64& last = baseline.counts[name];
+        result[name + ".perSecond"] = seconds > 0 ? (count - last) / seconds : 0.0;
+        last = count;
+    }
+    for (const auto& [name, gauge] : r.gauges)
+        result[name] = gauge->get();
+    locker.unlock();
+
+    // Derived, the overlay shouldn't have to know how
+    const quint64 hits = result.value("cache.hits").toULongLong();
+    const quint64 misses = result.value("cache.misses").toULongLong();
+    result["cache.hitRate"] = hits + misses ? double(hits) / (hits + misses) : 0.0;
+    const quint64 compressedHits = result.value("cache.compressedHits").toULongLong();
+    const quint64 compressedMisses = result.value("cache.compressedMisses").toULongLong();
+    result["cache.compressedHitRate"] = compressedHits + compressedMisses
+                                            ? double(compressedHits) / (compressedHits + compressedMisses)
+                                            : 0.0;
+    return result;
+}
+
+void Metrics::publish()
+{
+    values = snapshot(liveBaseline);
+    emit valuesChanged();
+}
+
+void Metrics::writeLog()
+{
+    if (!log.isOpen() && !log.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Text))
+    {
+        qWarning() << "Can't write metrics to" << log.fileName();
+        logTimer.stop();
+        return;
+    }
+
+    QJsonObject line = QJsonObject::fromVariantMap(snapshot(logBaseline));
+    line["time"] = QDateTime::currentDateTime().toString(Qt::ISODateWithMs);
+    log.write(QJsonDocument(line).toJson(QJsonDocument::Compact));
+    log.write("\n");
+    log.flush();
+}
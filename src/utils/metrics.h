@@ -0,0 +1,100 @@
+// metrics.h
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <QFile>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QObject>
+#include <QString>
+#include <QTimer>
+#include <QVariantMap>
+#include <atomic>
+
+// Process-wide counters and gauges of what the app is doing: renders,
+// cache use, document loads, MIDI traffic, settings writes. Looking one up
+// by name registers it and takes a lock, so call sites keep the reference
+// (a static or a member); updating it is a relaxed atomic and safe from
+// any thread, the JACK process callback included.
+//
+// The Metrics object publishes snapshots to QML for the debug overlay
+// while live is set. With SPIRITSHEET_METRICS_LOG=1 it also appends one as
+// a JSON line to a file in the app data location every LOG_INTERVAL_MS, for
+// looking at a gig afterwards.
+// Counters also get a per-second rate in snapshots.
+class Metrics : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(QVariantMap values READ getValues NOTIFY valuesChanged)
+    Q_PROPERTY(bool live READ isLive WRITE setLive NOTIFY liveChanged)
+    Q_PROPERTY(QString logFile READ getLogFile CONSTANT)
+
+public:
+    class Counter
+    {
+    public:
+        void add(quint64 count = 1) { value.fetch_add(count, std::memory_order_relaxed); }
+        quint64 get() const { return value.load(std::memory_order_relaxed); }
+
+    private:
+        std::atomic<quint64> value{0};
+    };
+
+    class Gauge
+    {
+    public:
+        void set(qint64 newValue) { value.store(newValue, std::memory_order_relaxed); }
+        void add(qint64 delta) { value.fetch_add(delta, std::memory_order_relaxed); }
+        qint64 get() const { return value.load(std::memory_order_relaxed); }
+
+    private:
+        std::atomic<qint64> value{0};
+    };
+
+    // Never freed, references stay valid for the life of the process
+    static Counter& counter(const QString& name);
+    static Gauge& gauge(const QString& name);
+
+    explicit Metrics(QObject* parent = nullptr);
+
+    QVariantMap getValues() const { return values; }
+    bool isLive() const { return live; }
+    void setLive(bool enabled);
+    QString getLogFile() const { return log.fileName(); } // Empty when the log is off
+
+    // Every metric by name, with rates since the previous call
+    Q_INVOKABLE QVariantMap snapshot();
+
+    static const int LIVE_INTERVAL_MS = 500;
+    static const int LOG_INTERVAL_MS = 10000;
+
+signals:
+    void valuesChanged();
+    void liveChanged();
+
+private:
+    // Where rates are measured from; the overlay and the log each keep
+    // their own so opening one doesn't skew the other
+    struct Baseline
+    {
+        qint64 ms = 0;
+        QHash<QString, quint64> counts;
+    };
+
+    QVariantMap snapshot(Baseline& baseline) const;
+    void publish();
+    void writeLog();
+
+    QVariantMap values;
+    bool live = false;
+    QTimer liveTimer;
+    QTimer logTimer;
+    QFile log;
+
+    QElapsedTimer uptime;
+    Baseline liveBaseline;
+    Baseline logBaseline;
+    Baseline callerBaseline;
+};
+
+#endif // METRICS_H
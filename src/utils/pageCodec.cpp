@@ -0,0 +1,155 @@
+// pageCodec.cpp
+#include "pageCodec.h"
+#include <cstring>
+
+static const quint32 MAGIC = 0x50475a31; // "PGZ1"
+
+// Row markers
+static const char ROW_REPEAT = 0;
+static const char ROW_PACKED = 1;
+
+struct Header
+{
+    quint32 magic;
+    qint32 width;
+    qint32 height;
+    qint32 format;
+    qint32 bytesPerLine;
+    qint32 colorCount; // Entries of the color table following the header
+};
+
+// PackBits: a control byte n < 128 is followed by n + 1 literal bytes,
+// n >= 128 by one byte repeated n - 126 times (2 to 129)
+static void packRow(const uchar* row, qsizetype length, QByteArray& out)
+{
+    qsizetype i = 0;
+    while (i < length)
+    {
+        qsizetype run = 1;
+        while (i + run < length && run < 129 && row[i + run] == row[i])
+            ++run;
+
+        if (run >= 2)
+        {
+            out.append(char(run + 126));
+            out.append(char(row[i]));
+            i += run;
+            continue;
+        }
+
+        // Literals up to the next run of at least 3
+        qsizetype literal = 1;
+        while (i + literal < length && literal < 128)
+        {
+            const uchar* p = row + i + literal;
+            if (i + literal + 2 < length && p[0] == p[1] && p[1] == p[2])
+                break;
+            ++literal;
+        }
+        out.append(char(literal - 1));
+        out.append(reinterpret_cast<const char*>(row + i), literal);
+        i += literal;
+    }
+}
+
+static bool unpackRow(const uchar*& in, const uchar* end, uchar* row, qsizetype length)
+{
+    qsizetype i = 0;
+    while (i < length)
+    {
+        if (in >= end)
+            return false;
+        const uchar control = *in++;
+        if (control < 128)
+        {
+            const qsizetype literal = control + 1;
+            if (i + literal > length || in + literal > end)
+                return false;
+            std::memcpy(row + i, in, literal);
+            in += literal;
+            i += literal;
+        }
+        else
+        {
+            const qsizetype run = control - 126;
+            if (i + run > length || in >= end)
+                return false;
+            std::memset(row + i, *in++, run);
+            i += run;
+        }
+    }
+    return true;
+}
+
+QByteArray PageCodec::compress(const QImage& image)
+{
+    QByteArray out;
+    if (image.isNull())
+        return out;
+
+    const QList<QRgb> colors = image.colorTable();
+    const Header header{MAGIC, image.width(), image.height(), int(image.format()),
+                        int(image.bytesPerLine()), int(colors.size())};
+    out.reserve(image.sizeInBytes() / 8);
+    out.append(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.append(reinterpret_cast<const char*>(colors.constData()), colors.size() * sizeof(QRgb));
+
+    const qsizetype length = image.bytesPerLine();
+    const uchar* previous = nullptr;
+    for (int y = 0; y < image.height(); ++y)
+    {
+        const uchar* row = image.constScanLine(y);
+        if (previous && std::memcmp(row, previous, length) == 0)
+        {
+            out.append(ROW_REPEAT);
+        }
+        else
+        {
+            out.append(ROW_PACKED);
+            packRow(row, length, out);
+        }
+        previous = row;
+    }
+    out.squeeze();
+    return out;
+}
+
+QImage PageCodec::decompress(const QByteArray& data)
+{
+    Header header;
+    if (data.size() < qsizetype(sizeof(header)))
+        return QImage();
+    std::memcpy(&header, data.constData(), sizeof(header));
+    if (header.magic != MAGIC || header.width <= 0 || header.height <= 0 || header.colorCount < 0)
+        return QImage();
+
+    QImage image(header.width, header.height, QImage::Format(header.format));
+    if (image.isNull() || image.bytesPerLine() != header.bytesPerLine)
+        return QImage();
+
+    const uchar* in = reinterpret_cast<const uchar*>(data.constData()) + sizeof(header);
+    const uchar* end = reinterpret_cast<const uchar*>(data.constData()) + data.size();
+    if (header.colorCount > 0)
+    {
+        if (in + header.colorCount * sizeof(QRgb) > end)
+            return QImage();
+        QList<QRgb> colors(header.colorCount);
+        std::memcpy(colors.data(), in, header.colorCount * sizeof(QRgb));
+        image.setColorTable(colors);
+        in += header.colorCount * sizeof(QRgb);
+    }
+
+    const qsizetype length = image.bytesPerLine();
+    for (int y = 0; y < header.height; ++y)
+    {
+        if (in >= end)
+            return QImage();
+        uchar* row = image.scanLine(y);
+        const char marker = char(*in++);
+        if (marker == ROW_REPEAT && y > 0)
+            std::memcpy(row, image.constScanLine(y - 1), length);
+        else if (marker != ROW_PACKED || !unpackRow(in, end, row, length))
+            return QImage();
+    }
+    return image;
+}
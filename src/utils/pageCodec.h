@@ -0,0 +1,21 @@
+// pageCodec.h
+#ifndef PAGECODEC_H
+#define PAGECODEC_H
+
+#include <QByteArray>
+#include <QImage>
+
+// Lossless compression for rendered pages. Rows equal to the previous one
+// (blank space between staves, the margins) take one byte, other rows are
+// run-length coded (PackBits), which collapses the long runs of white
+// around notation. Much weaker than a general purpose codec on photos, but
+// decoding is a memcpy/memset loop and needs no extra dependency.
+class PageCodec
+{
+public:
+    static QByteArray compress(const QImage& image);
+    // Null image if data isn't something compress() produced
+    static QImage decompress(const QByteArray& data);
+};
+
+#endif // PAGECODEC_H
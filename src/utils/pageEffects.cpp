@@ -0,0 +1,249 @@
+// pageEffects.cpp
+#include "pageEffects.h"
+#include <QStringList>
+#include <QtAlgorithms>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Channel value below which a pixel counts as content when trimming;
+// leaves scanner noise and antialiasing fringes in the margin
+static const uchar CONTENT_THRESHOLD = 224;
+
+QString PageEffects::toString() const
+{
+    QStringList parts;
+    if (invert)
+        parts << QStringLiteral("inv");
+    if (contrast > 0)
+        parts << QStringLiteral("c%1").arg(contrast);
+    if (trim)
+        parts << QStringLiteral("trim");
+    return parts.isEmpty() ? QStringLiteral("none") : parts.join(u'+');
+}
+
+PageEffects PageEffects::fromString(QStringView text)
+{
+    PageEffects effects;
+    for (const auto part : text.split(u'+', Qt::SkipEmptyParts))
+    {
+        if (part == u"inv")
+            effects.invert = true;
+        else if (part == u"trim")
+            effects.trim = true;
+        else if (part.startsWith(u'c'))
+            effects.contrast = qBound(0, part.mid(1).toInt(), 100);
+    }
+    return effects;
+}
+
+// XORs every 32-bit word with pattern: inverts all bytes (0xFFFFFFFF) or
+// the color channels of ARGB32 (0x00FFFFFF)
+static void xorWords(uchar* data, qsizetype bytes, quint32 pattern)
+{
+    qsizetype i = 0;
+#if defined(__SSE2__)
+    const __m128i mask = _mm_set1_epi32(int(pattern));
+    for (; i + 16 <= bytes; i += 16)
+    {
+        __m128i* p = reinterpret_cast<__m128i*>(data + i);
+        _mm_storeu_si128(p, _mm_xor_si128(_mm_loadu_si128(p), mask));
+    }
+#endif
+    for (; i + 4 <= bytes; i += 4)
+    {
+        quint32 word;
+        memcpy(&word, data + i, 4);
+        word ^= pattern;
+        memcpy(data + i, &word, 4);
+    }
+    for (; i < bytes; ++i)
+        data[i] ^= uchar(pattern);
+}
+
+// Black point, white point and gamma all move with the strength, which
+// darkens faint lines without filling in the paper
+static std::array<uchar, 256> contrastTable(int contrast, bool invert)
+{
+    const double strength = contrast / 100.0;
+    const double black = 96.0 * strength;
+    const double white = 255.0 - 32.0 * strength;
+    const double gamma = 1.0 + strength;
+
+    std::array<uchar, 256> table;
+    for (int v = 0; v < 256; ++v)
+    {
+        const double x = std::clamp((v - black) / (white - black), 0.0, 1.0);
+        const int out = int(std::lround(255.0 * std::pow(x, gamma)));
+        table[v] = uchar(invert ? 255 - out : out);
+    }
+    return table;
+}
+
+void PageEffects::apply(QImage& image, const PageEffects& effects)
+{
+    if (image.isNull() || (!effects.invert && effects.contrast <= 0))
+        return;
+
+    switch (image.format())
+    {
+    case QImage::Format_Mono:
+    case QImage::Format_MonoLSB:
+        // Two colors, only inversion makes sense: swap the table
+        if (effects.invert && image.colorCount() == 2)
+            image.setColorTable({image.color(1), image.color(0)});
+        return;
+    case QImage::Format_Grayscale8:
+    case QImage::Format_RGB32:
+    case QImage::Format_ARGB32:
+    case QImage::Format_ARGB32_Premultiplied:
+        break;
+    default:
+        image = image.convertToFormat(QImage::Format_ARGB32);
+        break;
+    }
+
+    const bool gray = image.format() == QImage::Format_Grayscale8;
+    uchar* data = image.bits();
+    const qsizetype bytes = image.sizeInBytes();
+
+    if (effects.contrast <= 0)
+    {
+        // Pages are opaque, so inverting premultiplied colors is fine too
+        xorWords(data, bytes, gray ? 0xFFFFFFFFu : 0x00FFFFFFu);
+        return;
+    }
+
+    const std::array<uchar, 256> table = contrastTable(effects.contrast, effects.invert);
+    if (gray)
+    {
+        for (qsizetype i = 0; i < bytes; ++i)
+            data[i] = table[data[i]];
+        return;
+    }
+
+    quint32* pixels = reinterpret_cast<quint32*>(data);
+    const qsizetype count = bytes / 4;
+    for (qsizetype i = 0; i < count; ++i)
+    {
+        const quint32 p = pixels[i];
+        pixels[i] = (p & 0xFF000000u)
+                    | quint32(table[(p >> 16) & 0xFF]) << 16
+                    | quint32(table[(p >> 8) & 0xFF]) << 8
+                    | quint32(table[p & 0xFF]);
+    }
+}
+
+// Smallest byte of a row; alpha bytes are 255 on a page so they don't matter
+static uchar minimumByte(const uchar* row, qsizetype bytes)
+{
+    uchar result = 255;
+    qsizetype i = 0;
+#if defined(__SSE2__)
+    __m128i minimum = _mm_set1_epi8(char(255));
+    for (; i + 16 <= bytes; i += 16)
+        minimum = _mm_min_epu8(minimum, _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + i)));
+    alignas(16) uchar lanes[16];
+    _mm_store_si128(reinterpret_cast<__m128i*>(lanes), minimum);
+    result = *std::min_element(lanes, lanes + 16);
+#endif
+    for (; i < bytes; ++i)
+        result = std::min(result, row[i]);
+    return result;
+}
+
+// Index of the first byte below CONTENT_THRESHOLD, -1 if there is none
+static qsizetype firstContentByte(const uchar* data, qsizetype bytes)
+{
+    qsizetype i = 0;
+#if defined(__SSE2__)
+    // x < threshold exactly when min(x, threshold - 1) == x
+    const __m128i limit = _mm_set1_epi8(char(CONTENT_THRESHOLD - 1));
+    for (; i + 16 <= bytes; i += 16)
+    {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        const int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_min_epu8(v, limit), v));
+        if (mask)
+            return i + qCountTrailingZeroBits(quint32(mask));
+    }
+#endif
+    for (; i < bytes; ++i)
+    {
+        if (data[i] < CONTENT_THRESHOLD)
+            return i;
+    }
+    return -1;
+}
+
+// Index of the last byte below CONTENT_THRESHOLD, -1 if there is none
+static qsizetype lastContentByte(const uchar* data, qsizetype bytes)
+{
+    qsizetype end = bytes;
+#if defined(__SSE2__)
+    const __m128i limit = _mm_set1_epi8(char(CONTENT_THRESHOLD - 1));
+    for (; end >= 16; end -= 16)
+    {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + end - 16));
+        const int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_min_epu8(v, limit), v));
+        if (mask)
+            return end - 16 + 31 - qCountLeadingZeroBits(quint32(mask));
+    }
+#endif
+    while (end > 0)
+    {
+        if (data[--end] < CONTENT_THRESHOLD)
+            return end;
+    }
+    return -1;
+}
+
+QRectF PageEffects::contentBox(const QImage& source)
+{
+    QImage image = source;
+    if (image.format() == QImage::Format_Mono || image.format() == QImage::Format_MonoLSB)
+        image = image.convertToFormat(QImage::Format_Grayscale8);
+    else if (image.format() != QImage::Format_Grayscale8 && image.depth() != 32)
+        image = image.convertToFormat(QImage::Format_ARGB32);
+    if (image.isNull())
+        return QRectF();
+
+    const int bpp = image.depth() / 8;
+    const qsizetype rowBytes = qsizetype(image.width()) * bpp;
+    const auto rowHasContent = [&](int y) {
+        return minimumByte(image.constScanLine(y), rowBytes) < CONTENT_THRESHOLD;
+    };
+
+    int top = 0;
+    while (top < image.height() && !rowHasContent(top))
+        ++top;
+    if (top == image.height())
+        return QRectF();
+    int bottom = image.height() - 1;
+    while (bottom > top && !rowHasContent(bottom))
+        --bottom;
+
+    // Per row, only the part still outside the box found so far is scanned,
+    // as one run of bytes so the vectorized search applies
+    int left = image.width();
+    int right = -1;
+    for (int y = top; y <= bottom; ++y)
+    {
+        const uchar* row = image.constScanLine(y);
+        const qsizetype first = firstContentByte(row, qsizetype(left) * bpp);
+        if (first >= 0)
+            left = int(first / bpp);
+        const qsizetype from = qsizetype(right + 1) * bpp;
+        const qsizetype last = lastContentByte(row + from, rowBytes - from);
+        if (last >= 0)
+            right = int((from + last) / bpp);
+    }
+    if (right < left)
+        return QRectF();
+
+    return QRectF(double(left) / image.width(), double(top) / image.height(),
+                  double(right - left + 1) / image.width(), double(bottom - top + 1) / image.height());
+}
@@ -0,0 +1,40 @@
+// pageEffects.h
+#ifndef PAGEEFFECTS_H
+#define PAGEEFFECTS_H
+
+#include <QImage>
+#include <QRectF>
+#include <QString>
+
+// Post-processing applied by the render worker before a page is cached:
+// inverted colors for dark stages, a contrast curve for faint scans and
+// trimming of the white margins. Part of the cache key, so each variant is
+// computed once per raster.
+struct PageEffects
+{
+    bool invert = false;
+    int contrast = 0; // 0 (off) to 100
+    bool trim = false;
+
+    bool operator==(const PageEffects& other) const = default;
+    bool isNone() const { return *this == PageEffects(); }
+
+    // Compact form used in image provider URLs, "none" or e.g. "inv+c40+trim"
+    QString toString() const;
+    static PageEffects fromString(QStringView text);
+
+    // Applies everything but trim in place. Grayscale8, ARGB32/RGB32 and
+    // Mono images are processed directly, other formats are converted.
+    static void apply(QImage& image, const PageEffects& effects);
+
+    // Bounding box of everything that isn't (near) white, normalized to the
+    // image size; empty for a blank page. Only the margins are scanned.
+    static QRectF contentBox(const QImage& image);
+};
+
+inline size_t qHash(const PageEffects& effects, size_t seed = 0)
+{
+    return qHashMulti(seed, effects.invert, effects.contrast, effects.trim);
+}
+
+#endif // PAGEEFFECTS_H
@@ -0,0 +1,42 @@
+// pageFingerprint.cpp
+#include "pageFingerprint.h"
+#include <QCryptographicHash>
+#include <QImage>
+
+template <typename T>
+static void addValue(QCryptographicHash& hash, const T& value)
+{
+    hash.addData(QByteArrayView(reinterpret_cast<const char*>(&value), sizeof(value)));
+}
+
+QByteArray PageFingerprint::textHash(Poppler::Page* page)
+{
+    if (!page)
+        return QByteArray();
+
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    addValue(hash, page->pageSizeF());
+    for (const auto& box : page->textList())
+    {
+        hash.addData(box->text().toUtf8());
+        addValue(hash, box->boundingBox());
+    }
+    return hash.result();
+}
+
+QByteArray PageFingerprint::compute(Poppler::Page* page, const QByteArray& text)
+{
+    if (!page)
+        return QByteArray();
+
+    const QImage image = page->renderToImage(FINGERPRINT_DPI, FINGERPRINT_DPI)
+                             .convertToFormat(QImage::Format_Grayscale8);
+    if (image.isNull())
+        return QByteArray();
+
+    // Row by row, the padding at the end of a scanline is undefined
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    for (int y = 0; y < image.height(); ++y)
+        hash.addData(QByteArrayView(reinterpret_cast<const char*>(image.constScanLine(y)), image.width()));
+    return (text.isEmpty() ? textHash(page) : text) + hash.result();
+}
@@ -0,0 +1,31 @@
+// pageFingerprint.h
+#ifndef PAGEFINGERPRINT_H
+#define PAGEFINGERPRINT_H
+
+#include <QByteArray>
+#include <poppler-qt6.h>
+
+// Content hash of a page, to tell which pages of a re-exported document
+// are unchanged: its size, its text with positions and a coarse grayscale
+// raster. Poppler doesn't expose the content streams, the raster stands in
+// for them; at FINGERPRINT_DPI a notehead is several pixels, so any edit
+// worth re-rendering changes it.
+//
+// The size and text come first, as a hash of their own (textHash()), so
+// pages whose text changed can be told apart without rendering them.
+class PageFingerprint
+{
+public:
+    // Empty if the page can't be rendered. text is textHash() of the page
+    // if the caller already has it.
+    static QByteArray compute(Poppler::Page* page, const QByteArray& text = QByteArray());
+    // Size and text only, no rendering. Empty for a null page.
+    static QByteArray textHash(Poppler::Page* page);
+    static QByteArray textPart(const QByteArray& fingerprint) { return fingerprint.left(TEXT_HASH_SIZE); }
+
+    static const int FINGERPRINT_DPI = 48;
+    static const int TEXT_HASH_SIZE = 20; // SHA-1
+    static const int SIZE = 2 * TEXT_HASH_SIZE;
+};
+
+#endif // PAGEFINGERPRINT_H
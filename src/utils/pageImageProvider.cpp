@@ -1,78 +1,160 @@
 // pageImageProvider.cpp
 #include "pageImageProvider.h"
+#include "frameProfiler.h"
 #include "pdfModel.h"
-#include <QElapsedTimer>
+#include <QTransform>
 #include <QDebug>
 
-PageImageProvider::PageImageProvider(Poppler::Document* pdfDocument)
-    : QQuickImageProvider(QQuickImageProvider::Image,
-                         QQmlImageProviderBase::ForceAsynchronousImageLoading)
-    , document(pdfDocument)
+PageImageResponse::PageImageResponse(std::shared_ptr<RenderScheduler> renderScheduler,
+                                     const QString& id)
+    : scheduler(std::move(renderScheduler))
+    , id(id)
 {}
 
-QImage PageImageProvider::requestImage(const QString& id, QSize* size,
-                                     const QSize& requestedSize)
+QQuickTextureFactory* PageImageResponse::textureFactory() const
 {
-    QElapsedTimer timer;
-    timer.start();
+    if (!image.isNull())
+        FrameProfiler::noteImageUpload(image.sizeInBytes());
+    return QQuickTextureFactory::textureFactoryForImage(image);
+}
 
-    QString type = id.section("/", 0, 0);
-    QImage result;
+QString PageImageResponse::errorString() const
+{
+    return error;
+}
 
-    if (document && type == "page")
-    {
-        bool ok;
-        int numPage = id.section("/", 1, 1).toInt(&ok);
+void PageImageResponse::cancel()
+{
+    DEBUG << "Request cancelled:" << id;
+    cancelled = true;
 
-        if (!ok)
-        {
-            qWarning() << "Invalid page number in request:" << id;
-            return result;
-        }
+    // A cancelled response still has to finish so the engine can clean it up
+    if (scheduler->withdraw(this))
+        deliver(QImage());
+}
 
-        DEBUG << "Page" << numPage << "requested";
+void PageImageResponse::deliver(const QImage& rendered)
+{
+    image = rendered;
+    if (image.isNull() && !cancelled && error.isEmpty())
+        error = "Failed to render " + id;
+    emit finished();
+}
 
-        std::unique_ptr<Poppler::Page> page(document->page(numPage - 1));
-        if (!page)
-        {
-            qWarning() << "Failed to load page" << numPage;
-            return result;
-        }
+void PageImageResponse::fail(const QString& message)
+{
+    qWarning() << message;
+    error = message;
 
-        QSizeF pageSize = page->pageSizeF();
-        DEBUG << "Requested size:" << requestedSize << "Page size:" << pageSize;
+    // Not queued on the scheduler, finish once the engine is listening
+    QMetaObject::invokeMethod(this, [this] { deliver(QImage()); }, Qt::QueuedConnection);
+}
 
-        // Calculate resolution
-        double res;
-        if (requestedSize.isValid() && requestedSize.width() > 0)
-        {
-            res = requestedSize.width() / (pageSize.width() / 72.0);
-        }
-        else
-        {
-            res = 72.0; // Default to 72 DPI if no size requested
-        }
+PageImageProvider::PageImageProvider(std::shared_ptr<RenderScheduler> renderScheduler,
+                                     std::shared_ptr<RenderCache> renderCache,
+                                     std::shared_ptr<ThumbnailStore> thumbnailStore,
+                                     const QList<QSizeF>& pageSizes)
+    : scheduler(std::move(renderScheduler))
+    , cache(std::move(renderCache))
+    , thumbnails(std::move(thumbnailStore))
+    , pageSizes(pageSizes)
+{}
 
-        DEBUG << "Rendering resolution:" << res << "dpi";
+QQuickImageResponse* PageImageProvider::requestImageResponse(const QString& id,
+                                                             const QSize& requestedSize)
+{
+    auto* response = new PageImageResponse(scheduler, id);
+
+    QString type = id.section("/", 0, 0);
+    if (type != "page" && type != "thumb")
+    {
+        response->fail("Invalid request: " + id);
+        return response;
+    }
 
-        result = page->renderToImage(res, res);
-        if (result.isNull())
+    bool ok;
+    int numPage = id.section("/", 1, 1).toInt(&ok);
+    if (!ok || numPage < 1 || numPage > pageSizes.size())
+    {
+        response->fail("Invalid page number in request: " + id);
+        return response;
+    }
+
+    if (type == "thumb")
+    {
+        QImage thumbnail = thumbnails ? thumbnails->thumbnail(numPage - 1) : QImage();
+        if (!thumbnail.isNull())
         {
-            qWarning() << "Failed to render page" << numPage;
-            return QImage();
+            QMetaObject::invokeMethod(response, [response, thumbnail] { response->deliver(thumbnail); },
+                                      Qt::QueuedConnection);
+            return response;
         }
 
-        if (size)
+        // Not generated yet, render it when nothing else is waiting
+        const double dpi = ThumbnailStore::thumbnailDpi(pageSizes[numPage - 1]);
+        scheduler->submit({numPage - 1, qMax(1, qRound(dpi))}, response, true);
+        return response;
+    }
+
+    DEBUG << "Page" << numPage << "requested";
+
+    // Quarter turns are rendered by Poppler, the raster comes out transposed
+    const int rotation = (id.section("/", 4, 4).toInt() / 90) & 3;
+    QSizeF pageSize = pageSizes[numPage - 1];
+    if (rotation & 1)
+        pageSize.transpose();
+    DEBUG << "Requested size:" << requestedSize << "Page size:" << pageSize;
+
+    const RenderMode mode = renderModeFromName(id.section("/", 2, 2));
+    const PageEffects effects = PageEffects::fromString(id.section("/", 3, 3));
+
+    // A trimmed page fills the item with less of the page, so it needs more
+    // pixels per inch for the same sharpness
+    if (effects.trim && cache)
+    {
+        const RenderKey boxKey{numPage - 1, 0, mode, effects, rotation};
+        QRectF box = cache->contentBox(boxKey);
+        if (box.isEmpty() && thumbnails)
         {
-            *size = result.size();
+            // Before the first trimmed render, the thumbnail is close
+            // enough; otherwise the page would be rendered at the untrimmed
+            // resolution and again once the box is known
+            const QImage thumbnail = thumbnails->thumbnail(numPage - 1);
+            if (!thumbnail.isNull())
+            {
+                box = PageEffects::contentBox(rotation ? thumbnail.transformed(QTransform().rotate(90 * rotation))
+                                                       : thumbnail);
+                if (!box.isEmpty())
+                    cache->setContentBox(boxKey, box);
+            }
         }
+        if (!box.isEmpty())
+            pageSize.setWidth(pageSize.width() * qMin(1.0, box.width() + 2 * RenderScheduler::TRIM_PADDING));
+    }
 
-        DEBUG << "Page rendered in" << timer.elapsed() << "ms." << result.size();
+    // Calculate resolution
+    double res;
+    if (requestedSize.isValid() && requestedSize.width() > 0)
+    {
+        res = requestedSize.width() / (pageSize.width() / 72.0);
     }
     else
     {
-        qWarning() << "Invalid request or no document:" << id;
+        res = 72.0; // Default to 72 DPI if no size requested
+    }
+
+    // Snap to the DPI ladder so nearby zoom levels share a raster
+    const RenderKey key{numPage - 1, RenderCache::quantizeDpi(res), mode, effects, rotation};
+    QImage cached;
+    if (cache && cache->lookup(key, &cached))
+    {
+        DEBUG << "Page" << numPage << "served from cache for" << res << "dpi"
+              << "hit rate:" << cache->hitRate();
+        QMetaObject::invokeMethod(response, [response, cached] { response->deliver(cached); },
+                                  Qt::QueuedConnection);
+        return response;
     }
 
-    return result;
+    scheduler->submit(key, response);
+    return response;
 }
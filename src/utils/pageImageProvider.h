@@ -3,17 +3,52 @@
 #define PAGEIMAGEPROVIDER_H
 
 #include <QQuickImageProvider>
-#include <poppler-qt6.h>
+#include "renderCache.h"
+#include "renderScheduler.h"
+#include "thumbnailStore.h"
+#include <atomic>
 #include <memory>
 
-class PageImageProvider : public QQuickImageProvider
+// One asynchronous page request. Rendering is done by the RenderScheduler;
+// the engine cancels the response when the Image that asked for it goes
+// away or changes its source or sourceSize (e.g. an intermediate zoom
+// level), which withdraws it from the scheduler.
+class PageImageResponse : public QQuickImageResponse
 {
 public:
-    explicit PageImageProvider(Poppler::Document* pdfDocument = nullptr);
-    QImage requestImage(const QString& id, QSize* size, const QSize& requestedSize) override;
+    PageImageResponse(std::shared_ptr<RenderScheduler> renderScheduler, const QString& id);
+
+    QQuickTextureFactory* textureFactory() const override;
+    QString errorString() const override;
+    void cancel() override;
+
+    // Finishes the response, from whichever thread produced the image
+    void deliver(const QImage& rendered);
+    void fail(const QString& message);
+
+private:
+    std::shared_ptr<RenderScheduler> scheduler;
+    QString id;
+    QImage image;
+    QString error;
+    std::atomic_bool cancelled{false};
+};
+
+class PageImageProvider : public QQuickAsyncImageProvider
+{
+public:
+    PageImageProvider(std::shared_ptr<RenderScheduler> renderScheduler,
+                      std::shared_ptr<RenderCache> renderCache,
+                      std::shared_ptr<ThumbnailStore> thumbnailStore,
+                      const QList<QSizeF>& pageSizes);
+
+    QQuickImageResponse* requestImageResponse(const QString& id, const QSize& requestedSize) override;
 
 private:
-    Poppler::Document* document; // Non-owning pointer
+    std::shared_ptr<RenderScheduler> scheduler;
+    std::shared_ptr<RenderCache> cache;
+    std::shared_ptr<ThumbnailStore> thumbnails;
+    QList<QSizeF> pageSizes;
 };
 
 #endif // PAGEIMAGEPROVIDER_H
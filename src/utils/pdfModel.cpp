@@ -1,22 +1,65 @@
 // pdfModel.cpp
 #include "pdfModel.h"
 #include "pageImageProvider.h"
+#include "documentMetadata.h"
+#include "documentRegistry.h"
+#include <QElapsedTimer>
+#include <QFileInfo>
 #include <QDebug>
 #include <QQmlEngine>
 #include <QQmlContext>
 
-static QVariantMap convertDestination(const Poppler::LinkDestination& destination)
+// Turns a rect normalized to the page by quarter turns clockwise
+static QRectF rotateRect(const QRectF& rect, int quarterTurns)
+{
+    switch (quarterTurns & 3)
+    {
+    case 1:
+        return QRectF(1.0 - rect.bottom(), rect.left(), rect.height(), rect.width());
+    case 2:
+        return QRectF(1.0 - rect.right(), 1.0 - rect.bottom(), rect.width(), rect.height());
+    case 3:
+        return QRectF(rect.top(), 1.0 - rect.right(), rect.height(), rect.width());
+    }
+    return rect;
+}
+
+// Editors write in several steps (truncate, write, rename), wait for them
+// to settle before reading the file
+static const int RELOAD_DELAY_MS = 500;
+
+static QVariantList outlineData(const QList<OutlineEntry>& entries)
+{
+    QVariantList result;
+    for (const OutlineEntry& entry : entries)
+    {
+        QVariantMap outlineData;
+        outlineData["title"] = entry.title;
+        outlineData["page"] = entry.page;
+        outlineData["top"] = entry.top;
+        outlineData["level"] = entry.level;
+        result.append(outlineData);
+    }
+    return result;
+}
+
+static QVariantMap convertDestination(const PageLink& link)
 {
     QVariantMap result;
-    result["page"] = destination.pageNumber() - 1;
-    result["top"] = destination.top();
-    result["left"] = destination.left();
+    result["page"] = link.page;
+    result["top"] = link.top;
+    result["left"] = link.left;
     return result;
 }
 
 PdfModel::PdfModel(QObject* parent)
     : QObject(parent)
-{}
+{
+    reloadTimer.setSingleShot(true);
+    reloadTimer.setInterval(RELOAD_DELAY_MS);
+    connect(&reloadTimer, &QTimer::timeout, this, &PdfModel::reload);
+    connect(&watcher, &QFileSystemWatcher::fileChanged, &reloadTimer, qOverload<>(&QTimer::start));
+}
 
 void PdfModel::setPath(QString& pathName)
 {
@@ -33,73 +76,302 @@ void PdfModel::setPath(QString& pathName)
     this->path = pathName;
     emit pathChanged(pathName);
 
-    // Load document
+    // Load document, or share it with the views that have it open already
     clear();
-    DEBUG << "Loading document...";
-    document = std::unique_ptr<Poppler::Document>(Poppler::Document::load(path));
-
-    if (!document || document->isLocked())
+    QString message;
+    shared = DocumentRegistry::acquire(path, &message);
+    if (!shared)
     {
-        DEBUG << "ERROR : Can't open the document located at " + pathName;
-        emit error("Can't open the document located at " + pathName);
-        document.reset();
+        DEBUG << "ERROR :" << message;
+        emit error(message);
         return;
     }
+    populate();
+    watcher.addPath(path);
+    if (autoTuneRendering)
+        DocumentRegistry::tune(shared);
 
-    // Create image provider
-    document->setRenderHint(Poppler::Document::Antialiasing, true);
-    document->setRenderHint(Poppler::Document::TextAntialiasing, true);
-    loadProvider();
+    DEBUG << "Document loaded successfully";
+    emit loadedChanged();
+}
+
+void PdfModel::populate()
+{
+    providerName = "poppler" + QString::number(quintptr(this)) + "-" + QString::number(generation);
+    const DocumentMetadata* metadata = &shared->metadata;
 
     // Fill in pages data
-    const int numPages = document->numPages();
+    const QList<QSizeF>& pageSizes = metadata->pageSizes;
+    const int numPages = pageSizes.size();
+    pages.reserve(numPages);
     for (int i = 0; i < numPages; ++i)
     {
-        std::unique_ptr<Poppler::Page> page(document->page(i));
-
         QVariantMap pageData;
-        pageData["image"] = "image://" + providerName + "/page/" + QString::number(i + 1);
-        pageData["size"] = page->pageSizeF();
+        pageData["image"] = pageImageUrl(i);
+        pageData["thumbnail"] = "image://" + providerName + "/thumb/" + QString::number(i + 1);
+        pageData["size"] = quarterTurns & 1 ? pageSizes[i].transposed() : pageSizes[i];
 
         QVariantList pageLinks;
-        auto links = page->links();
-        for (const auto& link : links)
+        for (const PageLink& link : metadata->links[i])
         {
-            if (link->linkType() == Poppler::Link::Goto)
-            {
-                auto* gotoLink = dynamic_cast<Poppler::LinkGoto*>(link.get());
-                if (gotoLink && !gotoLink->isExternal())
-                {
-                    QVariantMap linkMap;
-                    linkMap["rect"] = link->linkArea().normalized();
-                    linkMap["destination"] = convertDestination(gotoLink->destination());
-                    pageLinks.append(linkMap);
-                }
-            }
+            QVariantMap linkMap;
+            linkMap["rect"] = rotateRect(link.rect, quarterTurns);
+            linkMap["destination"] = convertDestination(link);
+            pageLinks.append(linkMap);
         }
         pageData["links"] = pageLinks;
 
         pages.append(pageData);
     }
+
+    buildSongIndex();
+    outline = outlineData(metadata->outline);
+
+    // Create image provider
+    loadProvider(pageSizes);
     emit pagesChanged();
+    emit outlineChanged();
 
-    DEBUG << "Document loaded successfully";
-    emit loadedChanged();
+    // The listener is removed in detach() before this model goes away
+    thumbnailsReady = shared->thumbnails->readyCount();
+    emit thumbnailsReadyChanged();
+    thumbnailListener = shared->thumbnails->addProgressListener([this](int ready) {
+        QMetaObject::invokeMethod(this, [this, ready] {
+            thumbnailsReady = ready;
+            emit thumbnailsReadyChanged();
+        }, Qt::QueuedConnection);
+    });
+}
+
+void PdfModel::reload()
+{
+    if (!shared)
+        return;
+    if (reloading)
+    {
+        reloadPending = true;
+        return;
+    }
+
+    // Saved by renaming a new file over the old one: the watch went with
+    // the old file, and the new one may not be there yet
+    if (!QFileInfo::exists(path))
+    {
+        reloadTimer.start();
+        return;
+    }
+    if (!watcher.files().contains(path))
+        watcher.addPath(path);
+
+    DEBUG << "Document changed on disk, reloading:" << path;
+    reloading = true;
+    DocumentRegistry::reload(shared, this, [this, previous = shared](std::shared_ptr<SharedDocument> document,
+                                                                     int unchangedPages, const QString& message) {
+        adoptReloaded(previous, std::move(document), unchangedPages, message);
+    });
+}
+
+void PdfModel::adoptReloaded(const std::shared_ptr<SharedDocument>& previous,
+                             std::shared_ptr<SharedDocument> document, int unchangedPages,
+                             const QString& errorMessage)
+{
+    reloading = false;
+    if (reloadPending)
+    {
+        reloadPending = false;
+        reloadTimer.start();
+    }
+
+    // Half-written files don't open, the next change notification retries.
+    // Meanwhile the old version stays on screen.
+    if (!document)
+    {
+        qWarning() << "Poppler plugin: can't reload the document:" << errorMessage;
+        return;
+    }
+    // Another document was opened in the meantime
+    if (document == shared || shared != previous)
+        return;
+
+    emit aboutToReload();
+    detach();
+    shared = std::move(document);
+    ++generation;
+    pages.clear();
+    outline.clear();
+    populate();
+    if (autoTuneRendering)
+        DocumentRegistry::tune(shared);
+    emit reloaded(unchangedPages);
+}
+
+QString PdfModel::pageImageUrl(int page) const
+{
+    return "image://" + providerName + "/page/" + QString::number(page + 1)
+           + "/" + renderModeName(renderMode) + "/" + effects.toString()
+           + "/" + QString::number(quarterTurns * 90);
+}
+
+void PdfModel::refreshPageImages()
+{
+    // New URLs make the pages request new rasters, the old ones age out of
+    // the cache
+    if (pages.isEmpty())
+        return;
+    for (int i = 0; i < pages.size(); ++i)
+    {
+        QVariantMap pageData = pages[i].toMap();
+        pageData["image"] = pageImageUrl(i);
+        pages[i] = pageData;
+    }
+    emit pagesChanged();
 }
 
-void PdfModel::loadProvider()
+void PdfModel::setRenderMode(int mode)
+{
+    const RenderMode newMode = RenderMode(qBound(0, mode, int(RenderMode::Monochrome)));
+    if (newMode == renderMode)
+        return;
+
+    renderMode = newMode;
+    emit renderModeChanged();
+    refreshPageImages();
+}
+
+void PdfModel::setInvertColors(bool invert)
+{
+    if (invert == effects.invert)
+        return;
+
+    effects.invert = invert;
+    emit invertColorsChanged();
+    refreshPageImages();
+}
+
+void PdfModel::setContrast(int contrast)
+{
+    contrast = qBound(0, contrast, 100);
+    if (contrast == effects.contrast)
+        return;
+
+    effects.contrast = contrast;
+    emit contrastChanged();
+    refreshPageImages();
+}
+
+void PdfModel::setTrimMargins(bool trim)
+{
+    if (trim == effects.trim)
+        return;
+
+    effects.trim = trim;
+    emit trimMarginsChanged();
+    refreshPageImages();
+}
+
+void PdfModel::setAutoTuneRendering(bool enable)
+{
+    if (enable == autoTuneRendering)
+        return;
+
+    autoTuneRendering = enable;
+    emit autoTuneRenderingChanged();
+    if (enable && shared)
+        DocumentRegistry::tune(shared);
+}
+
+void PdfModel::setRotation(int degrees)
+{
+    const int turns = ((degrees / 90) % 4 + 4) % 4;
+    if (turns == quarterTurns)
+        return;
+
+    const int delta = (turns - quarterTurns + 4) % 4;
+    quarterTurns = turns;
+    emit rotationChanged();
+    if (pages.isEmpty())
+        return;
+
+    // Sizes and links turn along, so the layout follows without transforming
+    // the view
+    for (int i = 0; i < pages.size(); ++i)
+    {
+        QVariantMap pageData = pages[i].toMap();
+        if (delta & 1)
+            pageData["size"] = pageData["size"].toSizeF().transposed();
+
+        QVariantList pageLinks = pageData["links"].toList();
+        for (QVariant& link : pageLinks)
+        {
+            QVariantMap linkMap = link.toMap();
+            linkMap["rect"] = rotateRect(linkMap["rect"].toRectF(), delta);
+            link = linkMap;
+        }
+        pageData["links"] = pageLinks;
+        pageData["image"] = pageImageUrl(i);
+        pages[i] = pageData;
+    }
+    emit pagesChanged();
+}
+
+void PdfModel::buildSongIndex()
+{
+    auto index = std::make_shared<SongIndex>();
+    songIndex = index;
+
+    // A file opened without a sidecar has no outline yet, it is read here
+    // on a document of its own (the scheduler renders from the shared one)
+    // and saved to the sidecar for next time
+    auto metadata = std::make_shared<DocumentMetadata>(shared->metadata);
+    songIndexBuilder = QThread::create([index, metadata, path = shared->path, key = shared->key] {
+        if (!metadata->hasOutline)
+        {
+            std::unique_ptr<Poppler::Document> document(Poppler::Document::load(path));
+            if (document && !document->isLocked())
+            {
+                metadata->outline = DocumentMetadata::outlineOf(document.get());
+                metadata->hasOutline = true;
+                if (DocumentMetadata::fileKey(path) == key)
+                    metadata->saveCached(path);
+            }
+        }
+        index->build(metadata->outline);
+    });
+    connect(songIndexBuilder, &QThread::finished, this, [this, index, metadata] {
+        if (songIndex != index)
+            return;
+
+        if (metadata->hasOutline && !shared->metadata.hasOutline)
+        {
+            // Shared with the other views of the document, all on this thread
+            shared->metadata.outline = metadata->outline;
+            shared->metadata.hasOutline = true;
+        }
+        if (outline.isEmpty() && !shared->metadata.outline.isEmpty())
+        {
+            outline = outlineData(shared->metadata.outline);
+            emit outlineChanged();
+        }
+        DEBUG << "Song index ready," << index->size() << "titles";
+        emit songIndexChanged();
+    });
+    connect(songIndexBuilder, &QThread::finished, songIndexBuilder, &QObject::deleteLater);
+    songIndexBuilder->start(QThread::LowPriority);
+}
+
+void PdfModel::loadProvider(const QList<QSizeF>& pageSizes)
 {
     DEBUG << "Loading image provider...";
     QQmlEngine* engine = QQmlEngine::contextForObject(this)->engine();
 
-    const QString& prefix = QString::number(quintptr(this));
-    providerName = "poppler" + prefix;
-    engine->addImageProvider(providerName, new PageImageProvider(document.get()));
+    engine->addImageProvider(providerName,
+                             new PageImageProvider(shared->renderScheduler, shared->renderCache,
+                                                   shared->thumbnails, pageSizes));
 
     DEBUG << "Image provider loaded successfully !" << qPrintable("(" + providerName + ")");
 }
 
-void PdfModel::clear()
+void PdfModel::detach()
 {
     if (!providerName.isEmpty())
     {
@@ -109,10 +381,37 @@ void PdfModel::clear()
         providerName.clear();
     }
 
-    document.reset();
+    if (shared)
+    {
+        shared->thumbnails->removeProgressListener(thumbnailListener);
+        shared->renderScheduler->removeViewport(this);
+    }
+    thumbnailListener = -1;
+
+    if (songIndexBuilder)
+        songIndexBuilder->wait();
+}
+
+void PdfModel::clear()
+{
+    detach();
+    if (!watcher.files().isEmpty())
+        watcher.removePaths(watcher.files());
+    reloadTimer.stop();
+
+    thumbnailsReady = 0;
+    emit thumbnailsReadyChanged();
+    songIndex.reset();
+    emit songIndexChanged();
+
+    // Other views and requests still in flight keep the document alive,
+    // it is closed with the last of them
+    shared.reset();
     emit loadedChanged();
     pages.clear();
     emit pagesChanged();
+    outline.clear();
+    emit outlineChanged();
 }
 
 QVariantList PdfModel::getPages() const
@@ -120,27 +419,32 @@ QVariantList PdfModel::getPages() const
     return pages;
 }
 
+QVariantList PdfModel::getOutline() const
+{
+    return outline;
+}
+
 bool PdfModel::getLoaded() const
 {
-    return document != nullptr;
+    return shared != nullptr;
 }
 
 QVariantList PdfModel::search(int page, const QString& text, Qt::CaseSensitivity caseSensitivity)
 {
     QVariantList result;
-    if (!document)
+    if (!shared)
     {
         qWarning() << "Poppler plugin: no document to search";
         return result;
     }
 
-    if (page >= document->numPages() || page < 0)
+    if (page >= shared->document->numPages() || page < 0)
     {
         qWarning() << "Poppler plugin: search page" << page << "isn't in a document";
         return result;
     }
 
-    std::unique_ptr<Poppler::Page> p(document->page(page));
+    std::unique_ptr<Poppler::Page> p(shared->document->page(page));
     auto searchResult = p->search(text, caseSensitivity == Qt::CaseInsensitive ?
                                 Poppler::Page::IgnoreCase :
                                 static_cast<Poppler::Page::SearchFlag>(0));
@@ -148,14 +452,52 @@ QVariantList PdfModel::search(int page, const QString& text, Qt::CaseSensitivity
     auto pageSize = p->pageSizeF();
     for (const auto& r : searchResult)
     {
-        result.append(QRectF(r.left() / pageSize.width(),
-                            r.top() / pageSize.height(),
-                            r.width() / pageSize.width(),
-                            r.height() / pageSize.height()));
+        result.append(rotateRect(QRectF(r.left() / pageSize.width(),
+                                        r.top() / pageSize.height(),
+                                        r.width() / pageSize.width(),
+                                        r.height() / pageSize.height()), quarterTurns));
     }
     return result;
 }
 
+int PdfModel::getSongCount() const
+{
+    return songIndex ? songIndex->size() : 0;
+}
+
+QVariantList PdfModel::findSongs(const QString& query, int limit) const
+{
+    if (!songIndex)
+        return QVariantList();
+
+    QElapsedTimer timer;
+    timer.start();
+    QVariantList result = songIndex->search(query, limit);
+    DEBUG << "Song search for" << query << "took" << timer.nsecsElapsed() / 1000 << "us";
+    return result;
+}
+
+QVariantMap PdfModel::renderCacheStats() const
+{
+    return shared ? shared->renderCache->stats() : QVariantMap();
+}
+
+QVariantMap PdfModel::renderSchedulerStats() const
+{
+    return shared ? shared->renderScheduler->stats() : QVariantMap();
+}
+
+QVariantMap PdfModel::documentStats() const
+{
+    return DocumentRegistry::stats();
+}
+
+void PdfModel::setViewport(int firstPage, int lastPage, int direction)
+{
+    if (shared)
+        shared->renderScheduler->setViewport(this, firstPage, lastPage, direction);
+}
+
 PdfModel::~PdfModel()
 {
     clear();
@@ -2,12 +2,19 @@
 #ifndef PDFMODEL_H
 #define PDFMODEL_H
 
+#include <QFileSystemWatcher>
 #include <QObject>
+#include <QPointer>
+#include <QThread>
+#include <QTimer>
 #include <memory>
-#include <poppler-qt6.h>
+#include "renderCache.h"
+#include "songIndex.h"
 
 #define DEBUG if (qgetenv("POPPLERPLUGIN_DEBUG") == "1") qDebug() << "Poppler plugin:"
 
+struct SharedDocument;
+
 class PdfModel : public QObject
 {
     Q_OBJECT
@@ -20,29 +27,105 @@ public:
     Q_PROPERTY(QString path READ getPath WRITE setPath NOTIFY pathChanged)
     Q_PROPERTY(bool loaded READ getLoaded NOTIFY loadedChanged)
     Q_PROPERTY(QVariantList pages READ getPages NOTIFY pagesChanged)
+    Q_PROPERTY(QVariantList outline READ getOutline NOTIFY outlineChanged)
+    Q_PROPERTY(int songCount READ getSongCount NOTIFY songIndexChanged)
+    Q_PROPERTY(int thumbnailsReady READ getThumbnailsReady NOTIFY thumbnailsReadyChanged)
+    // 0: color, 1: 8-bit grayscale, 2: 1-bit (see RenderMode)
+    Q_PROPERTY(int renderMode READ getRenderMode WRITE setRenderMode NOTIFY renderModeChanged)
+    // Post-processing of rendered pages (see PageEffects)
+    Q_PROPERTY(bool invertColors READ getInvertColors WRITE setInvertColors NOTIFY invertColorsChanged)
+    Q_PROPERTY(int contrast READ getContrast WRITE setContrast NOTIFY contrastChanged)
+    Q_PROPERTY(bool trimMargins READ getTrimMargins WRITE setTrimMargins NOTIFY trimMarginsChanged)
+    // Clockwise, in degrees (0, 90, 180 or 270). Pages are rendered rotated,
+    // page sizes, links and search results are given in rotated coordinates.
+    Q_PROPERTY(int rotation READ getRotation WRITE setRotation NOTIFY rotationChanged)
+    // Calibrate the render backend and hints of documents opened for the
+    // first time (see RenderTuning)
+    Q_PROPERTY(bool autoTuneRendering READ getAutoTuneRendering WRITE setAutoTuneRendering
+                   NOTIFY autoTuneRenderingChanged)
 
     void setPath(QString& pathName);
     QString getPath() const { return path; }
     QVariantList getPages() const;
+    QVariantList getOutline() const;
     bool getLoaded() const;
+    int getThumbnailsReady() const { return thumbnailsReady; }
+    int getSongCount() const;
+    int getRenderMode() const { return int(renderMode); }
+    void setRenderMode(int mode);
+    bool getInvertColors() const { return effects.invert; }
+    void setInvertColors(bool invert);
+    int getContrast() const { return effects.contrast; }
+    void setContrast(int contrast);
+    bool getTrimMargins() const { return effects.trim; }
+    void setTrimMargins(bool trim);
+    int getRotation() const { return quarterTurns * 90; }
+    void setRotation(int degrees);
+    bool getAutoTuneRendering() const { return autoTuneRendering; }
+    void setAutoTuneRendering(bool enable);
 
     Q_INVOKABLE QVariantList search(int page, const QString& text,
                                    Qt::CaseSensitivity caseSensitivity = Qt::CaseSensitive);
+    // Outline entries matching a (partial, misspelled) title, best first
+    Q_INVOKABLE QVariantList findSongs(const QString& query, int limit = 20) const;
+    Q_INVOKABLE QVariantMap renderCacheStats() const;
+    Q_INVOKABLE QVariantMap renderSchedulerStats() const;
+    // Documents open in the process, shared between views
+    Q_INVOKABLE QVariantMap documentStats() const;
+    // Pages (0-based) currently on screen and the direction the reader is moving in
+    Q_INVOKABLE void setViewport(int firstPage, int lastPage, int direction);
 
 signals:
     void pathChanged(const QString& newPath);
     void loadedChanged();
     void error(const QString& errorMessage);
     void pagesChanged();
+    void outlineChanged();
+    void songIndexChanged();
+    void thumbnailsReadyChanged();
+    void renderModeChanged();
+    void invertColorsChanged();
+    void contrastChanged();
+    void trimMarginsChanged();
+    void rotationChanged();
+    void autoTuneRenderingChanged();
+    // The file changed on disk and the new version replaces the old one.
+    // Pages stay where they are unless the page count changed.
+    void aboutToReload();
+    void reloaded(int unchangedPages);
 
 private:
-    void loadProvider();
+    void loadProvider(const QList<QSizeF>& pageSizes);
+    // Also reads the outline if the document was opened without it
+    void buildSongIndex();
     void clear();
+    void populate();
+    void detach();
+    void reload();
+    void adoptReloaded(const std::shared_ptr<SharedDocument>& previous,
+                       std::shared_ptr<SharedDocument> document, int unchangedPages,
+                       const QString& errorMessage);
+    QString pageImageUrl(int page) const;
+    void refreshPageImages();
 
-    std::unique_ptr<Poppler::Document> document;
+    std::shared_ptr<SharedDocument> shared;
+    int thumbnailListener = -1;
+    std::shared_ptr<SongIndex> songIndex;
+    QPointer<QThread> songIndexBuilder;
     QString providerName;
+    int generation = 0; // Bumped on reload so the image URLs change
+    QFileSystemWatcher watcher;
+    QTimer reloadTimer;
+    bool reloading = false;
+    bool reloadPending = false;
     QString path;
     QVariantList pages;
+    QVariantList outline;
+    int thumbnailsReady = 0;
+    RenderMode renderMode = RenderMode::Color;
+    PageEffects effects;
+    int quarterTurns = 0;
+    bool autoTuneRendering = false;
 };
 
 Q_DECLARE_METATYPE(PdfModel*)
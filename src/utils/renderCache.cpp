@@ -0,0 +1,235 @@
+// renderCache.cpp
+#include "renderCache.h"
+#include "metrics.h"
+#include <QMutexLocker>
+#include <algorithm>
+#include <array>
+
+// Levels are 1.2-1.33x apart, so a fresh raster is never more than
+// ~1.33x larger than what is displayed
+static constexpr std::array<int, 14> dpiLadder = {
+    36, 48, 60, 72, 96, 120, 144, 192, 240, 288, 384, 480, 576, 720
+};
+
+// Summed over all open documents. The second tier is only asked after a
+// miss in the first, its lookups are counted apart.
+static Metrics::Counter& hitsMetric = Metrics::counter("cache.hits");
+static Metrics::Counter& missesMetric = Metrics::counter("cache.misses");
+static Metrics::Counter& compressedHitsMetric = Metrics::counter("cache.compressedHits");
+static Metrics::Counter& compressedMissesMetric = Metrics::counter("cache.compressedMisses");
+static Metrics::Gauge& bytesMetric = Metrics::gauge("cache.bytes");
+
+QString renderModeName(RenderMode mode)
+{
+    switch (mode)
+    {
+    case RenderMode::Grayscale:
+        return QStringLiteral("gray");
+    case RenderMode::Monochrome:
+        return QStringLiteral("mono");
+    case RenderMode::Color:
+        break;
+    }
+    return QStringLiteral("color");
+}
+
+RenderMode renderModeFromName(QStringView name)
+{
+    if (name == u"gray")
+        return RenderMode::Grayscale;
+    if (name == u"mono")
+        return RenderMode::Monochrome;
+    return RenderMode::Color;
+}
+
+RenderCache::RenderCache(qint64 maxBytes, qint64 maxCompressedBytes)
+    : images(maxBytes)
+    , compressed(maxCompressedBytes)
+{}
+
+RenderCache::~RenderCache()
+{
+    bytesMetric.add(-reportedBytes);
+}
+
+int RenderCache::quantizeDpi(double dpi)
+{
+    for (int level : dpiLadder)
+    {
+        if (level >= dpi)
+            return level;
+    }
+    return dpiLadder.back();
+}
+
+bool RenderCache::lookup(const RenderKey& key, QImage* image)
+{
+    QMutexLocker locker(&mutex);
+
+    auto level = std::find(dpiLadder.begin(), dpiLadder.end(), key.dpi);
+    for (int up = 0; level != dpiLadder.end() && up <= MAX_LEVELS_UP; ++level, ++up)
+    {
+        if (const QImage* cached = images.object({key.page, *level, key.mode, key.effects, key.rotation}))
+        {
+            *image = *cached;
+            ++hits;
+            hitsMetric.add();
+            return true;
+        }
+    }
+
+    ++misses;
+    missesMetric.add();
+    return false;
+}
+
+void RenderCache::insert(const RenderKey& key, const QImage& image)
+{
+    if (image.isNull())
+        return;
+
+    QMutexLocker locker(&mutex);
+    images.insert(key, new QImage(image), image.sizeInBytes());
+    publishBytes();
+}
+
+void RenderCache::clear()
+{
+    QMutexLocker locker(&mutex);
+    images.clear();
+    compressed.clear();
+    contentBoxes.clear();
+    hits = 0;
+    misses = 0;
+    compressedHits = 0;
+    compressedMisses = 0;
+    insertedBytes = 0;
+    insertedCompressedBytes = 0;
+    publishBytes();
+}
+
+int RenderCache::adopt(RenderCache& previous, const QMultiHash<int, int>& pages)
+{
+    if (&previous == this)
+        return 0;
+
+    QMutexLocker previousLocker(&previous.mutex);
+    QMutexLocker locker(&mutex);
+
+    int adopted = 0;
+    const QList<RenderKey> imageKeys = previous.images.keys();
+    for (const RenderKey& key : imageKeys)
+    {
+        const QImage* image = previous.images.object(key);
+        for (auto it = pages.constFind(key.page); image && it != pages.cend() && it.key() == key.page; ++it)
+        {
+            RenderKey moved = key;
+            moved.page = it.value();
+            images.insert(moved, new QImage(*image), image->sizeInBytes());
+            ++adopted;
+        }
+    }
+
+    const QList<RenderKey> compressedKeys = previous.compressed.keys();
+    for (const RenderKey& key : compressedKeys)
+    {
+        const QByteArray* data = previous.compressed.object(key);
+        for (auto it = pages.constFind(key.page); data && it != pages.cend() && it.key() == key.page; ++it)
+        {
+            RenderKey moved = key;
+            moved.page = it.value();
+            compressed.insert(moved, new QByteArray(*data), data->size());
+            ++adopted;
+        }
+    }
+
+    for (auto box = previous.contentBoxes.cbegin(); box != previous.contentBoxes.cend(); ++box)
+    {
+        for (auto it = pages.constFind(box.key().first); it != pages.cend() && it.key() == box.key().first; ++it)
+            contentBoxes.insert({it.value(), box.key().second}, box.value());
+    }
+    publishBytes();
+    return adopted;
+}
+
+bool RenderCache::lookupCompressed(const RenderKey& key, RenderKey* found, QByteArray* data)
+{
+    QMutexLocker locker(&mutex);
+
+    auto level = std::find(dpiLadder.begin(), dpiLadder.end(), key.dpi);
+    for (int up = 0; level != dpiLadder.end() && up <= MAX_LEVELS_UP; ++level, ++up)
+    {
+        const RenderKey candidate{key.page, *level, key.mode, key.effects, key.rotation};
+        if (const QByteArray* cached = compressed.object(candidate))
+        {
+            *found = candidate;
+            *data = *cached;
+            ++compressedHits;
+            compressedHitsMetric.add();
+            return true;
+        }
+    }
+
+    ++compressedMisses;
+    compressedMissesMetric.add();
+    return false;
+}
+
+void RenderCache::insertCompressed(const RenderKey& key, const QByteArray& data, qint64 uncompressedBytes)
+{
+    if (data.isEmpty())
+        return;
+
+    QMutexLocker locker(&mutex);
+    compressed.insert(key, new QByteArray(data), data.size());
+    insertedBytes += uncompressedBytes;
+    insertedCompressedBytes += data.size();
+    publishBytes();
+}
+
+void RenderCache::setContentBox(const RenderKey& key, const QRectF& box)
+{
+    QMutexLocker locker(&mutex);
+    contentBoxes.insert({key.page, key.rotation}, box);
+}
+
+QRectF RenderCache::contentBox(const RenderKey& key) const
+{
+    QMutexLocker locker(&mutex);
+    return contentBoxes.value({key.page, key.rotation});
+}
+
+void RenderCache::publishBytes()
+{
+    const qint64 bytes = images.totalCost() + compressed.totalCost();
+    bytesMetric.add(bytes - reportedBytes);
+    reportedBytes = bytes;
+}
+
+double RenderCache::hitRate() const
+{
+    QMutexLocker locker(&mutex);
+    const quint64 total = hits + misses;
+    return total ? double(hits) / total : 0.0;
+}
+
+QVariantMap RenderCache::stats() const
+{
+    QMutexLocker locker(&mutex);
+    const quint64 total = hits + misses;
+
+    QVariantMap result;
+    result["hits"] = hits;
+    result["misses"] = misses;
+    result["hitRate"] = total ? double(hits) / total : 0.0;
+    result["entries"] = images.count();
+    result["bytes"] = images.totalCost();
+    result["maxBytes"] = images.maxCost();
+    result["compressedHits"] = compressedHits;
+    result["compressedMisses"] = compressedMisses;
+    result["compressedEntries"] = compressed.count();
+    result["compressedBytes"] = compressed.totalCost();
+    result["maxCompressedBytes"] = compressed.maxCost();
+    result["compressionRatio"] = insertedCompressedBytes ? double(insertedBytes) / insertedCompressedBytes : 0.0;
+    return result;
+}
@@ -0,0 +1,107 @@
+// renderCache.h
+#ifndef RENDERCACHE_H
+#define RENDERCACHE_H
+
+#include <QCache>
+#include <QHash>
+#include <QImage>
+#include <QMutex>
+#include <QVariantMap>
+#include "pageEffects.h"
+
+// Pixel format pages are kept in. Sheet music is black on white, so 8-bit
+// grayscale (4x smaller than ARGB32) or thresholded 1-bit (32x smaller)
+// usually looks the same.
+enum class RenderMode
+{
+    Color,
+    Grayscale,
+    Monochrome
+};
+
+// Names used in image provider URLs
+QString renderModeName(RenderMode mode);
+RenderMode renderModeFromName(QStringView name);
+
+struct RenderKey
+{
+    int page = -1;
+    int dpi = 0;
+    RenderMode mode = RenderMode::Color;
+    PageEffects effects;
+    int rotation = 0; // Quarter turns clockwise
+
+    bool operator==(const RenderKey& other) const = default;
+};
+
+inline size_t qHash(const RenderKey& key, size_t seed = 0)
+{
+    return qHashMulti(seed, key.page, key.dpi, int(key.mode), key.effects, key.rotation);
+}
+
+// Rendered pages, keyed by page and by a level of a fixed DPI ladder.
+// Requests are rounded up to the next ladder level so that nearby zoom
+// levels and odd fit-to-width factors share one raster, which the scene
+// graph scales down for display. Safe to use from render threads.
+//
+// Behind it sits a second, compressed tier (see PageCodec) that keeps
+// every page rendered so far at a fraction of the size, so a whole set
+// list stays in memory; pages found there are decompressed by the render
+// worker instead of being rendered again.
+class RenderCache
+{
+public:
+    explicit RenderCache(qint64 maxBytes = DEFAULT_MAX_BYTES,
+                         qint64 maxCompressedBytes = DEFAULT_MAX_COMPRESSED_BYTES);
+    ~RenderCache();
+
+    // Smallest ladder level that is at least dpi (clamped to the top level)
+    static int quantizeDpi(double dpi);
+
+    // Looks for the page at the given level, or failing that at one of the
+    // next few higher levels already in the cache.
+    bool lookup(const RenderKey& key, QImage* image);
+    void insert(const RenderKey& key, const QImage& image);
+    void clear();
+
+    // Takes over the rasters (both tiers) and content boxes of pages that
+    // are unchanged in a new version of the document, pages maps page
+    // numbers in previous to the ones here. Returns the number of rasters.
+    int adopt(RenderCache& previous, const QMultiHash<int, int>& pages);
+
+    // Same search in the compressed tier, found is the key of the match
+    bool lookupCompressed(const RenderKey& key, RenderKey* found, QByteArray* data);
+    void insertCompressed(const RenderKey& key, const QByteArray& data, qint64 uncompressedBytes);
+
+    // Where the content of a page sits in a given rotation (see
+    // PageEffects::contentBox), known once the page has been rendered with
+    // trimming; null rect otherwise
+    void setContentBox(const RenderKey& key, const QRectF& box);
+    QRectF contentBox(const RenderKey& key) const;
+
+    double hitRate() const;
+    QVariantMap stats() const;
+
+    static const qint64 DEFAULT_MAX_BYTES = 256ll * 1024 * 1024;
+    static const qint64 DEFAULT_MAX_COMPRESSED_BYTES = 512ll * 1024 * 1024;
+    static const int MAX_LEVELS_UP = 2;
+
+private:
+    // Moves this cache's share of the process-wide byte gauge to its
+    // current size, mutex held
+    void publishBytes();
+
+    mutable QMutex mutex;
+    QCache<RenderKey, QImage> images;
+    QCache<RenderKey, QByteArray> compressed;
+    QHash<std::pair<int, int>, QRectF> contentBoxes; // By page and rotation
+    quint64 hits = 0;
+    quint64 misses = 0;
+    quint64 compressedHits = 0;
+    quint64 compressedMisses = 0;
+    qint64 insertedBytes = 0;           // Uncompressed size of compressed inserts
+    qint64 insertedCompressedBytes = 0;
+    qint64 reportedBytes = 0;
+};
+
+#endif // RENDERCACHE_H
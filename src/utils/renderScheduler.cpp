@@ -0,0 +1,477 @@
+// renderScheduler.cpp
+#include "renderScheduler.h"
+#include "pageImageProvider.h"
+#include "pdfModel.h"
+#include "pageCodec.h"
+#include "metrics.h"
+#include <QMutexLocker>
+#include <QtMath>
+#include <QDebug>
+
+// Summed over all open documents
+static Metrics::Gauge& queueDepthMetric = Metrics::gauge("render.queueDepth");
+static Metrics::Gauge& inFlightMetric = Metrics::gauge("render.inFlight");
+static Metrics::Counter& completedMetric = Metrics::counter("render.completed");
+
+RenderScheduler::RenderScheduler(std::shared_ptr<Poppler::Document> pdfDocument,
+                                 std::shared_ptr<RenderCache> renderCache,
+                                 const RenderConfig& renderConfig)
+    : document(std::move(pdfDocument))
+    , cache(std::move(renderCache))
+    , config(renderConfig)
+{
+    config.applyTo(document.get());
+    worker.reset(QThread::create([this] { run(); }));
+    worker->start();
+    compressor.reset(QThread::create([this] { runCompressor(); }));
+    compressor->start(QThread::LowestPriority);
+}
+
+RenderScheduler::~RenderScheduler()
+{
+    {
+        QMutexLocker locker(&mutex);
+        stopping = true;
+        for (const auto& job : std::as_const(jobs))
+            job->cancelled = true;
+        queueDepthMetric.add(-queue.size());
+    }
+    wakeUp.wakeAll();
+    compressWakeUp.wakeAll();
+    worker->wait();
+    compressor->wait();
+}
+
+void RenderScheduler::submit(const RenderKey& key, PageImageResponse* response, bool thumbnail)
+{
+    QMutexLocker locker(&mutex);
+    ++submitted;
+
+    std::shared_ptr<Job> job = jobs.value(key);
+    if (job)
+    {
+        // Already queued or rendering, wait for that one
+        ++deduplicated;
+        job->thumbnail = job->thumbnail && thumbnail;
+    }
+    else
+    {
+        job = enqueue(key, thumbnail);
+    }
+
+    job->waiters.append(response);
+    waiting.insert(response, job);
+}
+
+void RenderScheduler::prefetch(const RenderKey& key)
+{
+    QMutexLocker locker(&mutex);
+    if (!jobs.contains(key))
+        enqueue(key, false);
+}
+
+std::shared_ptr<RenderScheduler::Job> RenderScheduler::enqueue(const RenderKey& key, bool thumbnail)
+{
+    auto job = std::make_shared<Job>();
+    job->key = key;
+    job->thumbnail = thumbnail;
+    job->sequence = nextSequence++;
+    job->queued.start();
+    jobs.insert(key, job);
+    queue.append(job);
+    queueDepthMetric.add(1);
+    peakDepth = qMax(peakDepth, queue.size());
+    wakeUp.wakeOne();
+    return job;
+}
+
+bool RenderScheduler::withdraw(PageImageResponse* response)
+{
+    QMutexLocker locker(&mutex);
+
+    std::shared_ptr<Job> job = waiting.take(response);
+    if (!job)
+        return false;
+
+    job->waiters.removeOne(response);
+    if (job->waiters.isEmpty())
+    {
+        DEBUG << "Render of page" << job->key.page + 1 << "at" << job->key.dpi << "dpi dropped";
+        job->cancelled = true;
+        ++cancelledJobs;
+        if (queue.removeOne(job))
+            queueDepthMetric.add(-1);
+        if (jobs.value(job->key) == job)
+            jobs.remove(job->key);
+    }
+    return true;
+}
+
+void RenderScheduler::setViewport(const void* view, int firstPage, int lastPage, int readingDirection)
+{
+    QMutexLocker locker(&mutex);
+    Viewport& viewport = viewports[view];
+    viewport.firstVisible = qMin(firstPage, lastPage);
+    viewport.lastVisible = qMax(firstPage, lastPage);
+    viewport.direction = readingDirection < 0 ? -1 : 1;
+}
+
+void RenderScheduler::removeViewport(const void* view)
+{
+    QMutexLocker locker(&mutex);
+    viewports.remove(view);
+}
+
+bool RenderScheduler::isBusy() const
+{
+    QMutexLocker locker(&mutex);
+    for (const auto& job : jobs)
+    {
+        if (!job->thumbnail)
+            return true;
+    }
+    return false;
+}
+
+void RenderScheduler::setRenderConfig(const RenderConfig& tuned)
+{
+    QMutexLocker locker(&mutex);
+    pendingConfig = tuned;
+}
+
+QVariantMap RenderScheduler::stats() const
+{
+    QMutexLocker locker(&mutex);
+
+    QVariantMap result;
+    result["renderConfig"] = pendingConfig.value_or(config).name();
+    result["queueDepth"] = queue.size();
+    result["peakQueueDepth"] = peakDepth;
+    result["inFlight"] = jobs.size() - queue.size();
+    result["submitted"] = submitted;
+    result["deduplicated"] = deduplicated;
+    result["cancelled"] = cancelledJobs;
+    result["completed"] = completed;
+    result["lastWaitMs"] = lastWaitMs;
+    result["maxWaitMs"] = maxWaitMs;
+    result["averageWaitMs"] = averageWaitMs;
+
+    // Throughput and memory per render mode, render plus conversion
+    QVariantMap modes;
+    for (RenderMode mode : {RenderMode::Color, RenderMode::Grayscale, RenderMode::Monochrome})
+    {
+        const ModeMetrics& metrics = modeMetrics[int(mode)];
+        if (!metrics.renders)
+            continue;
+        const double totalMs = metrics.renderMs + (metrics.convertUs + metrics.effectsUs) / 1000.0;
+        QVariantMap entry;
+        entry["renders"] = metrics.renders;
+        entry["averageRenderMs"] = double(metrics.renderMs) / metrics.renders;
+        entry["averageConvertMs"] = metrics.convertUs / 1000.0 / metrics.renders;
+        entry["averageEffectsMs"] = metrics.effectsUs / 1000.0 / metrics.renders;
+        entry["megapixelsPerSecond"] = totalMs > 0 ? metrics.kilopixels / totalMs : 0.0;
+        entry["averageBytes"] = double(metrics.bytes) / metrics.renders;
+        modes[renderModeName(mode)] = entry;
+    }
+    result["modes"] = modes;
+
+    // Decompressing should stay well below rendering, or the tier isn't worth it
+    quint64 renders = 0;
+    qint64 renderMs = 0;
+    for (const ModeMetrics& metrics : modeMetrics)
+    {
+        renders += metrics.renders;
+        renderMs += metrics.renderMs + (metrics.convertUs + metrics.effectsUs) / 1000;
+    }
+    const double averageRenderMs = renders ? double(renderMs) / renders : 0.0;
+    const double averageDecompressMs = decompressedPages ? decompressUs / 1000.0 / decompressedPages : 0.0;
+    result["decompressed"] = decompressedPages;
+    result["averageDecompressMs"] = averageDecompressMs;
+    result["averageCompressMs"] = compressedPages ? compressUs / 1000.0 / compressedPages : 0.0;
+    result["skippedCompressions"] = skippedCompressions;
+    result["averageRenderMs"] = averageRenderMs;
+    result["decompressSpeedup"] = averageDecompressMs > 0 ? averageRenderMs / averageDecompressMs : 0.0;
+    return result;
+}
+
+RenderPriority RenderScheduler::priorityFor(const Job& job) const
+{
+    if (job.thumbnail)
+        return RenderPriority::Thumbnail;
+
+    const auto priorityIn = [page = job.key.page](const Viewport& viewport) {
+        if (page >= viewport.firstVisible && page <= viewport.lastVisible)
+            return RenderPriority::Visible;
+
+        const int ahead = viewport.direction > 0 ? page - viewport.lastVisible
+                                                 : viewport.firstVisible - page;
+        if (ahead > 0 && ahead <= NEXT_PAGES)
+            return RenderPriority::Next;
+
+        return RenderPriority::Prefetch;
+    };
+
+    // Before any view reported, the first page is on screen
+    if (viewports.isEmpty())
+        return priorityIn(Viewport());
+
+    RenderPriority best = RenderPriority::Prefetch;
+    for (const Viewport& viewport : viewports)
+        best = qMin(best, priorityIn(viewport));
+    return best;
+}
+
+std::shared_ptr<RenderScheduler::Job> RenderScheduler::takeNext()
+{
+    // The queue only ever holds a handful of pages, a linear scan keeps
+    // priorities current when the viewport moves
+    qsizetype best = 0;
+    for (qsizetype i = 1; i < queue.size(); ++i)
+    {
+        const RenderPriority candidate = priorityFor(*queue[i]);
+        const RenderPriority current = priorityFor(*queue[best]);
+        if (candidate < current
+            || (candidate == current && queue[i]->sequence < queue[best]->sequence))
+        {
+            best = i;
+        }
+    }
+
+    std::shared_ptr<Job> job = queue.takeAt(best);
+    queueDepthMetric.add(-1);
+
+    lastWaitMs = job->queued.elapsed();
+    maxWaitMs = qMax(maxWaitMs, lastWaitMs);
+    averageWaitMs += (lastWaitMs - averageWaitMs) * 0.1;
+    return job;
+}
+
+void RenderScheduler::run()
+{
+    forever
+    {
+        std::shared_ptr<Job> job;
+        {
+            QMutexLocker locker(&mutex);
+            while (!stopping && queue.isEmpty())
+                wakeUp.wait(&mutex);
+            if (stopping)
+                return;
+            job = takeNext();
+
+            // The document is only ever rendered from here, nothing reads
+            // the hints while they change
+            if (pendingConfig)
+            {
+                config = *std::exchange(pendingConfig, std::nullopt);
+                config.applyTo(document.get());
+                DEBUG << "Rendering with" << config.name() << "from now on";
+            }
+        }
+
+        inFlightMetric.add(1);
+        QImage image = job->cancelled ? QImage() : render(*job);
+        inFlightMetric.add(-1);
+
+        QMutexLocker locker(&mutex);
+        if (jobs.value(job->key) == job)
+            jobs.remove(job->key);
+        for (PageImageResponse* response : std::as_const(job->waiters))
+        {
+            waiting.remove(response);
+            response->deliver(image);
+        }
+        job->waiters.clear();
+        ++completed;
+        completedMetric.add();
+
+        // Handed to the compressor, it delays neither this page nor the next
+        if (!image.isNull() && !job->decompressed && !job->thumbnail)
+        {
+            if (toCompress.size() >= MAX_PENDING_COMPRESSIONS)
+            {
+                toCompress.removeFirst();
+                ++skippedCompressions;
+            }
+            toCompress.append({job->key, image});
+            compressWakeUp.wakeOne();
+        }
+    }
+}
+
+void RenderScheduler::runCompressor()
+{
+    forever
+    {
+        std::pair<RenderKey, QImage> page;
+        {
+            QMutexLocker locker(&mutex);
+            while (!stopping && toCompress.isEmpty())
+                compressWakeUp.wait(&mutex);
+            if (stopping)
+                return;
+            page = toCompress.takeFirst();
+        }
+        compress(page.first, page.second);
+    }
+}
+
+bool RenderScheduler::shouldAbort(const QVariant& closure)
+{
+    return static_cast<std::atomic_bool*>(closure.value<void*>())->load();
+}
+
+QImage RenderScheduler::render(Job& job)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    // Thumbnails are never compressed, and their sizes aren't on the ladder
+    QImage stored = job.thumbnail ? QImage() : decompress(job);
+    if (!stored.isNull())
+        return stored;
+
+    std::unique_ptr<Poppler::Page> page(document->page(job.key.page));
+    if (!page)
+    {
+        qWarning() << "Failed to load page" << job.key.page + 1;
+        return QImage();
+    }
+
+    const double res = job.key.dpi;
+    DEBUG << "Rendering page" << job.key.page + 1 << "at" << res << "dpi";
+
+    // Rotated natively, so the raster has the right number of pixels across
+    // whatever ends up horizontal
+    QImage result = page->renderToImage(res, res, -1, -1, -1, -1, Poppler::Page::Rotation(job.key.rotation),
+                                        nullptr, nullptr, &RenderScheduler::shouldAbort,
+                                        QVariant::fromValue(static_cast<void*>(&job.cancelled)));
+    if (job.cancelled)
+    {
+        DEBUG << "Render of page" << job.key.page + 1 << "aborted after" << timer.elapsed() << "ms.";
+        return QImage();
+    }
+    if (result.isNull())
+    {
+        qWarning() << "Failed to render page" << job.key.page + 1;
+        return QImage();
+    }
+
+    const qint64 renderMs = timer.elapsed();
+    QElapsedTimer convertTimer;
+    convertTimer.start();
+    result = convert(result, job.key.mode);
+    const qint64 convertUs = convertTimer.nsecsElapsed() / 1000;
+
+    QElapsedTimer effectsTimer;
+    effectsTimer.start();
+    result = applyEffects(job.key, result);
+    const qint64 effectsUs = effectsTimer.nsecsElapsed() / 1000;
+
+    // Thumbnails are rendered at the cell size, off the DPI ladder, so the
+    // cache would never find them again
+    if (cache && !job.thumbnail)
+        cache->insert(job.key, result);
+
+    {
+        QMutexLocker locker(&mutex);
+        ModeMetrics& metrics = modeMetrics[int(job.key.mode)];
+        ++metrics.renders;
+        metrics.renderMs += renderMs;
+        metrics.convertUs += convertUs;
+        metrics.effectsUs += effectsUs;
+        metrics.kilopixels += qint64(result.width()) * result.height() / 1000;
+        metrics.bytes += result.sizeInBytes();
+    }
+
+    DEBUG << "Page rendered in" << renderMs << "ms, converted to" << renderModeName(job.key.mode)
+          << "in" << convertUs << "us, effects" << job.key.effects.toString() << "in" << effectsUs << "us."
+          << result.size() << result.sizeInBytes() << "bytes";
+    return result;
+}
+
+QImage RenderScheduler::decompress(Job& job)
+{
+    RenderKey found;
+    QByteArray data;
+    if (!cache || !cache->lookupCompressed(job.key, &found, &data))
+        return QImage();
+
+    QElapsedTimer timer;
+    timer.start();
+    QImage image = PageCodec::decompress(data);
+    const qint64 elapsedUs = timer.nsecsElapsed() / 1000;
+    if (image.isNull())
+    {
+        qWarning() << "Failed to decompress page" << job.key.page + 1;
+        return QImage();
+    }
+
+    cache->insert(found, image);
+    job.decompressed = true;
+    {
+        QMutexLocker locker(&mutex);
+        ++decompressedPages;
+        decompressUs += elapsedUs;
+    }
+    DEBUG << "Page" << job.key.page + 1 << "decompressed in" << elapsedUs << "us.";
+    return image;
+}
+
+void RenderScheduler::compress(const RenderKey& key, const QImage& image)
+{
+    QElapsedTimer timer;
+    timer.start();
+    const QByteArray data = PageCodec::compress(image);
+    const qint64 elapsedUs = timer.nsecsElapsed() / 1000;
+
+    if (cache)
+        cache->insertCompressed(key, data, image.sizeInBytes());
+
+    QMutexLocker locker(&mutex);
+    ++compressedPages;
+    compressUs += elapsedUs;
+}
+
+QImage RenderScheduler::convert(const QImage& image, RenderMode mode)
+{
+    switch (mode)
+    {
+    case RenderMode::Grayscale:
+        return image.convertToFormat(QImage::Format_Grayscale8);
+    case RenderMode::Monochrome:
+        // Threshold rather than dither, notation has no midtones worth keeping
+        return image.convertToFormat(QImage::Format_Mono, Qt::MonoOnly | Qt::ThresholdDither);
+    case RenderMode::Color:
+        break;
+    }
+    return image;
+}
+
+QImage RenderScheduler::applyEffects(const RenderKey& key, const QImage& image)
+{
+    if (key.effects.isNone())
+        return image;
+
+    QImage result = image;
+    if (key.effects.trim)
+    {
+        // Measured before inverting, so white still means margin
+        const QRectF box = PageEffects::contentBox(result);
+        // The first box known for the page stays, it decides the resolution
+        // pages are requested at and a new one would change the cache key
+        if (cache && cache->contentBox(key).isEmpty())
+            cache->setContentBox(key, box);
+        if (!box.isEmpty())
+        {
+            const QRectF padded = box.adjusted(-TRIM_PADDING, -TRIM_PADDING, TRIM_PADDING, TRIM_PADDING)
+                                      .intersected(QRectF(0, 0, 1, 1));
+            const QRect pixels(qFloor(padded.x() * result.width()), qFloor(padded.y() * result.height()),
+                               qCeil(padded.width() * result.width()), qCeil(padded.height() * result.height()));
+            result = result.copy(pixels.intersected(result.rect()));
+        }
+    }
+
+    PageEffects::apply(result, key.effects);
+    return result;
+}
@@ -0,0 +1,148 @@
+// renderScheduler.h
+#ifndef RENDERSCHEDULER_H
+#define RENDERSCHEDULER_H
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QThread>
+#include <QVariantMap>
+#include <QWaitCondition>
+#include <poppler-qt6.h>
+#include "renderCache.h"
+#include "renderTuning.h"
+#include <atomic>
+#include <memory>
+#include <optional>
+#include <utility>
+
+class PageImageResponse;
+
+enum class RenderPriority
+{
+    Visible,
+    Next,
+    Prefetch,
+    Thumbnail
+};
+
+// Renders pages on one worker thread, since a Poppler document can't be
+// rendered from several threads at once. Pages in the viewport go first,
+// then the next ones in the reading direction, then prefetch, then
+// thumbnails. Identical requests share a single render, and a render no
+// response is waiting for anymore is dropped from the queue or aborted.
+// Delivered pages are compressed into the cache's second tier on a low
+// priority thread of their own, off the path of the next render.
+class RenderScheduler
+{
+public:
+    RenderScheduler(std::shared_ptr<Poppler::Document> pdfDocument,
+                    std::shared_ptr<RenderCache> renderCache,
+                    const RenderConfig& config = RenderConfig());
+    ~RenderScheduler();
+
+    void submit(const RenderKey& key, PageImageResponse* response, bool thumbnail = false);
+    // Renders into the cache with nobody waiting yet, a later request for
+    // the same key joins the render
+    void prefetch(const RenderKey& key);
+    // Returns false if the response isn't waiting anymore (already delivered)
+    bool withdraw(PageImageResponse* response);
+    // Each view showing the document reports its own viewport, a page is as
+    // urgent as the most urgent view makes it
+    void setViewport(const void* view, int firstPage, int lastPage, int direction);
+    void removeViewport(const void* view);
+    // True while anything more urgent than thumbnails is queued or rendering
+    bool isBusy() const;
+    // Backend and hints for the renders from now on, switched between two
+    // renders. Pages already rendered stay as they are.
+    void setRenderConfig(const RenderConfig& config);
+    QVariantMap stats() const;
+
+    static const int NEXT_PAGES = 2;
+    // Pages waiting for the compressor; the oldest is skipped beyond that,
+    // each one holds a full uncompressed page
+    static const int MAX_PENDING_COMPRESSIONS = 4;
+    // White kept around trimmed content, as a fraction of the page
+    static constexpr double TRIM_PADDING = 0.01;
+
+private:
+    struct Job
+    {
+        RenderKey key;
+        bool thumbnail = false;
+        bool decompressed = false; // Served from the compressed tier
+        quint64 sequence = 0;
+        QElapsedTimer queued;
+        QList<PageImageResponse*> waiters;
+        std::atomic_bool cancelled{false};
+    };
+
+    std::shared_ptr<Job> enqueue(const RenderKey& key, bool thumbnail);
+    void run();
+    void runCompressor();
+    RenderPriority priorityFor(const Job& job) const;
+    std::shared_ptr<Job> takeNext();
+    QImage render(Job& job);
+    static bool shouldAbort(const QVariant& closure);
+    static QImage convert(const QImage& image, RenderMode mode);
+    QImage applyEffects(const RenderKey& key, const QImage& image);
+    QImage decompress(Job& job);
+    void compress(const RenderKey& key, const QImage& image);
+
+    std::shared_ptr<Poppler::Document> document;
+    std::shared_ptr<RenderCache> cache;
+    std::unique_ptr<QThread> worker;
+    std::unique_ptr<QThread> compressor;
+
+    mutable QMutex mutex;
+    QWaitCondition wakeUp;
+    bool stopping = false;
+    QList<std::shared_ptr<Job>> queue;
+    QHash<RenderKey, std::shared_ptr<Job>> jobs; // queued or rendering
+    QHash<PageImageResponse*, std::shared_ptr<Job>> waiting;
+    QWaitCondition compressWakeUp;
+    QList<std::pair<RenderKey, QImage>> toCompress; // Oldest first
+    RenderConfig config; // In use by the worker
+    std::optional<RenderConfig> pendingConfig;
+
+    struct Viewport
+    {
+        int firstVisible = 0;
+        int lastVisible = 0;
+        int direction = 1;
+    };
+    QHash<const void*, Viewport> viewports;
+
+    // Metrics
+    quint64 nextSequence = 0;
+    quint64 submitted = 0;
+    quint64 deduplicated = 0;
+    quint64 cancelledJobs = 0;
+    quint64 completed = 0;
+    qsizetype peakDepth = 0;
+    qint64 lastWaitMs = 0;
+    qint64 maxWaitMs = 0;
+    double averageWaitMs = 0.0;
+
+    // Per RenderMode, to compare what each of them costs
+    struct ModeMetrics
+    {
+        quint64 renders = 0;
+        qint64 renderMs = 0;
+        qint64 convertUs = 0;
+        qint64 effectsUs = 0;
+        qint64 kilopixels = 0;
+        qint64 bytes = 0;
+    };
+    ModeMetrics modeMetrics[3];
+
+    // Compressed tier, against the render times above
+    quint64 decompressedPages = 0;
+    qint64 decompressUs = 0;
+    quint64 compressedPages = 0;
+    qint64 compressUs = 0;
+    quint64 skippedCompressions = 0;
+};
+
+#endif // RENDERSCHEDULER_H
@@ -0,0 +1,235 @@
+// renderTuning.cpp
+#include "renderTuning.h"
+#include "pdfModel.h"
+#include <QDataStream>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QtMath>
+#include <QDebug>
+#include <limits>
+
+static const quint32 TUNING_MAGIC = 0x53535254; // "SSRT"
+static const quint16 TUNING_VERSION = 3; // 3: Splash only
+
+// The hints candidates differ in, the others are left as Poppler sets them
+static const Poppler::Document::RenderHint TUNED_HINTS[] = {
+    Poppler::Document::Antialiasing,
+    Poppler::Document::TextAntialiasing,
+    Poppler::Document::ThinLineSolid,
+    Poppler::Document::ThinLineShape,
+};
+
+static QString tuningPath(const QString& key)
+{
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation)
+        + "/rendering/" + key + ".bin";
+}
+
+void RenderConfig::applyTo(Poppler::Document* document) const
+{
+    document->setRenderBackend(backend);
+    for (Poppler::Document::RenderHint hint : TUNED_HINTS)
+        document->setRenderHint(hint, hints.testFlag(hint));
+}
+
+QString RenderConfig::name() const
+{
+    QString result = backend == Poppler::Document::QPainterBackend ? "qpainter" : "splash";
+    if (hints.testFlag(Poppler::Document::Antialiasing))
+        result += " aa";
+    if (hints.testFlag(Poppler::Document::TextAntialiasing))
+        result += " text-aa";
+    if (hints.testFlag(Poppler::Document::ThinLineSolid))
+        result += " thin-solid";
+    if (hints.testFlag(Poppler::Document::ThinLineShape))
+        result += " thin-shape";
+    return result;
+}
+
+QList<RenderConfig> RenderTuning::candidates()
+{
+    using Document = Poppler::Document;
+    const Document::RenderHints antialiased = Document::Antialiasing | Document::TextAntialiasing;
+    return {
+        RenderConfig(),
+        // Hairlines (staff lines, stems) kept solid at low resolutions
+        {Document::SplashBackend, antialiased | Document::ThinLineSolid},
+        {Document::SplashBackend, antialiased | Document::ThinLineShape},
+        // Images and vectors aliased, much cheaper on scanned pages where
+        // everything is one big image
+        {Document::SplashBackend, Document::TextAntialiasing},
+        // No QPainter backend: Poppler only calls the abort callback of
+        // renderToImage() with Splash, a withdrawn render would run to the end
+    };
+}
+
+std::optional<RenderConfig> RenderTuning::calibrate(const QString& path, const std::function<bool()>& idle)
+{
+    std::unique_ptr<Poppler::Document> document(Poppler::Document::load(path));
+    if (!document || document->isLocked() || document->numPages() == 0)
+        return std::nullopt;
+
+    const int numPages = document->numPages();
+    QList<int> samples;
+    for (int i = 0; i < SAMPLE_PAGES; ++i)
+    {
+        const int page = SAMPLE_PAGES > 1 ? i * (numPages - 1) / (SAMPLE_PAGES - 1) : 0;
+        if (!samples.contains(page))
+            samples.append(page);
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    QList<QImage> reference;
+    const RenderConfig defaults;
+    RenderConfig best = defaults;
+    qint64 defaultUs = 0;
+    qint64 bestUs = 0;
+    for (const RenderConfig& config : candidates())
+    {
+        config.applyTo(document.get());
+        qint64 totalUs = 0;
+        double worstPsnr = std::numeric_limits<double>::infinity();
+        bool failed = false;
+        for (qsizetype i = 0; i < samples.size() && !failed; ++i)
+        {
+            std::unique_ptr<Poppler::Page> page(document->page(samples[i]));
+            QImage image;
+            qint64 fastestUs = std::numeric_limits<qint64>::max();
+            for (int run = 0; run < RUNS; ++run)
+            {
+                if (!idle())
+                    return std::nullopt;
+                QElapsedTimer renderTimer;
+                renderTimer.start();
+                image = page ? page->renderToImage(SAMPLE_DPI, SAMPLE_DPI) : QImage();
+                fastestUs = qMin(fastestUs, renderTimer.nsecsElapsed() / 1000);
+            }
+            if (image.isNull())
+            {
+                failed = true;
+                break;
+            }
+
+            totalUs += fastestUs;
+            if (reference.size() <= i)
+                reference.append(image);
+            else
+                worstPsnr = qMin(worstPsnr, psnr(reference[i], image));
+        }
+
+        DEBUG << "Render calibration:" << config.name() << (failed ? "failed" : "took")
+              << totalUs / 1000.0 << "ms, worst PSNR" << worstPsnr << "dB";
+        if (failed)
+        {
+            // Nothing to compare the others against
+            if (config == defaults)
+                return std::nullopt;
+            continue;
+        }
+        if (config == defaults)
+        {
+            defaultUs = totalUs;
+            bestUs = totalUs;
+        }
+        else if (worstPsnr >= MIN_PSNR && totalUs < bestUs)
+        {
+            best = config;
+            bestUs = totalUs;
+        }
+    }
+
+    if (bestUs > defaultUs * (1.0 - MIN_GAIN))
+        best = defaults;
+    DEBUG << "Render calibration of" << samples.size() << "pages done in" << timer.elapsed()
+          << "ms, using" << best.name() << "at" << (bestUs ? double(defaultUs) / bestUs : 1.0)
+          << "times the speed of the default";
+    return best;
+}
+
+std::optional<RenderConfig> RenderTuning::loadCached(const QString& key, bool* failed)
+{
+    if (failed)
+        *failed = false;
+
+    QFile file(tuningPath(key));
+    if (!file.open(QIODevice::ReadOnly))
+        return std::nullopt;
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_6_5);
+
+    quint32 magic;
+    quint16 version;
+    bool calibrated;
+    quint8 backend;
+    quint32 hints;
+    in >> magic >> version >> calibrated >> backend >> hints;
+    if (in.status() != QDataStream::Ok || magic != TUNING_MAGIC || version != TUNING_VERSION
+        || backend != Poppler::Document::SplashBackend)
+    {
+        qWarning() << "Ignoring unreadable render calibration:" << file.fileName();
+        return std::nullopt;
+    }
+    if (!calibrated)
+    {
+        if (failed)
+            *failed = true;
+        return std::nullopt;
+    }
+
+    RenderConfig config;
+    config.backend = Poppler::Document::RenderBackend(backend);
+    config.hints = Poppler::Document::RenderHints::fromInt(hints);
+    return config;
+}
+
+bool RenderTuning::saveCached(const QString& key, const std::optional<RenderConfig>& config)
+{
+    const QString fileName = tuningPath(key);
+    QDir().mkpath(QFileInfo(fileName).absolutePath());
+
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly))
+    {
+        qWarning() << "Can't write render calibration" << fileName;
+        return false;
+    }
+
+    const RenderConfig written = config.value_or(RenderConfig());
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_6_5);
+    out << TUNING_MAGIC << TUNING_VERSION << config.has_value() << quint8(written.backend)
+        << quint32(written.hints.toInt());
+    return file.commit();
+}
+
+double RenderTuning::psnr(const QImage& a, const QImage& b)
+{
+    if (a.size() != b.size() || a.isNull())
+        return 0.0;
+
+    // Compared in gray, the candidates differ in edges, not in colors
+    const QImage grayA = a.convertToFormat(QImage::Format_Grayscale8);
+    const QImage grayB = b.convertToFormat(QImage::Format_Grayscale8);
+    quint64 squaredError = 0;
+    for (int y = 0; y < grayA.height(); ++y)
+    {
+        const uchar* lineA = grayA.constScanLine(y);
+        const uchar* lineB = grayB.constScanLine(y);
+        for (int x = 0; x < grayA.width(); ++x)
+        {
+            const int difference = int(lineA[x]) - int(lineB[x]);
+            squaredError += difference * difference;
+        }
+    }
+
+    if (squaredError == 0)
+        return std::numeric_limits<double>::infinity();
+    const double meanSquaredError = double(squaredError) / (qint64(grayA.width()) * grayA.height());
+    return 10.0 * std::log10(255.0 * 255.0 / meanSquaredError);
+}
@@ -0,0 +1,64 @@
+// renderTuning.h
+#ifndef RENDERTUNING_H
+#define RENDERTUNING_H
+
+#include <QImage>
+#include <QList>
+#include <QString>
+#include <poppler-qt6.h>
+#include <functional>
+#include <optional>
+
+// The Poppler backend and hints a document is rendered with. The defaults
+// are what every document got before calibration existed.
+struct RenderConfig
+{
+    Poppler::Document::RenderBackend backend = Poppler::Document::SplashBackend;
+    Poppler::Document::RenderHints hints = Poppler::Document::Antialiasing
+                                           | Poppler::Document::TextAntialiasing;
+
+    // Only from the thread rendering the document, or before it starts
+    void applyTo(Poppler::Document* document) const;
+    // "splash aa text-aa", for logs and stats
+    QString name() const;
+    bool operator==(const RenderConfig& other) const = default;
+};
+
+// Picks the render configuration of a file by trying them. Scanned charts
+// (JBIG2 images) and engraved scores (thin vector lines, embedded fonts)
+// render fastest with different hints: a few sample pages are rendered
+// with every candidate, and the fastest one whose pages stay within
+// MIN_PSNR of the default's wins. The choice is kept next to the
+// metadata sidecar, keyed by DocumentMetadata::fileKey, so a file is
+// calibrated once per version.
+class RenderTuning
+{
+public:
+    // The default first, it is the reference the others are measured against
+    static QList<RenderConfig> candidates();
+
+    // Blocking, on a document of its own so it can run next to the render
+    // scheduler. idle() is called before every render, outside the timings:
+    // it waits while the views need the CPU and returns false to give up.
+    // Returns nullopt if the file can't be rendered or idle() gave up.
+    static std::optional<RenderConfig> calibrate(const QString& path, const std::function<bool()>& idle);
+
+    // nullopt when the file hasn't been calibrated, or when its calibration
+    // failed, which sets failed so it isn't tried on every open
+    static std::optional<RenderConfig> loadCached(const QString& key, bool* failed = nullptr);
+    // nullopt records a failed calibration
+    static bool saveCached(const QString& key, const std::optional<RenderConfig>& config);
+
+    // Peak signal to noise ratio of b against a, in dB, 0 if their sizes differ
+    static double psnr(const QImage& a, const QImage& b);
+
+    static const int SAMPLE_PAGES = 3; // First, middle and last
+    static const int SAMPLE_DPI = 96;
+    static const int RUNS = 2; // Fastest of, the first one also loads fonts and images
+    static constexpr double MIN_PSNR = 30.0;
+    // A candidate has to be this much faster than the default to replace it,
+    // below that the difference is measurement noise
+    static constexpr double MIN_GAIN = 0.1;
+};
+
+#endif // RENDERTUNING_H
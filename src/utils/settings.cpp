@@ -1,4 +1,5 @@
 #include "settings.h"
+#include "metrics.h"
 
 Settings::Settings(QObject *parent)
     : QObject(parent)
@@ -19,10 +20,31 @@ Settings::~Settings()
 {
 }
 
+void Settings::flush()
+{
+    static Metrics::Counter& flushes = Metrics::counter("settings.flushes");
+    m_settings.sync();
+    flushes.add();
+}
+
 // General getters
 bool Settings::autoOpenLast() const { return m_autoOpenLast; }
 int Settings::defaultZoom() const { return m_defaultZoom; }
 int Settings::defaultViewMode() const { return m_defaultViewMode; }
+int Settings::renderMode() const { return m_renderMode; }
+bool Settings::nightMode() const { return m_nightMode; }
+int Settings::contrastBoost() const { return m_contrastBoost; }
+bool Settings::trimMargins() const { return m_trimMargins; }
+bool Settings::autoTuneRendering() const { return m_autoTuneRendering; }
+
+// Session getters
+QString Settings::lastDocument() const { return m_lastDocument; }
+int Settings::lastPage() const { return m_lastPage; }
+int Settings::lastZoom() const { return m_lastZoom; }
+int Settings::lastViewMode() const { return m_lastViewMode; }
+
+// Library getters
+QStringList Settings::libraryFolders() const { return m_libraryFolders; }
 
 // MIDI getters
 int Settings::midiChannel() const { return m_midiChannel; }
@@ -30,13 +52,23 @@ int Settings::nextPageControl() const { return m_nextPageControl; }
 int Settings::prevPageControl() const { return m_prevPageControl; }
 QString Settings::midiDevice() const { return m_midiDevice; }
 
+// Auto-scroll getters
+bool Settings::autoScrollEnabled() const { return m_autoScrollEnabled; }
+int Settings::barsPerPage() const { return m_barsPerPage; }
+int Settings::beatsPerBar() const { return m_beatsPerBar; }
+
+// Expression pedal getters
+int Settings::expressionMode() const { return m_expressionMode; }
+int Settings::expressionControl() const { return m_expressionControl; }
+int Settings::expressionSpeed() const { return m_expressionSpeed; }
+
 // General setters
 void Settings::setAutoOpenLast(bool value)
 {
     if (m_autoOpenLast != value) {
         m_autoOpenLast = value;
         m_settings.setValue("General/AutoOpenLast", value);
-        m_settings.sync();
+        flush();
         emit autoOpenLastChanged();
     }
 }
@@ -46,7 +78,7 @@ void Settings::setDefaultZoom(int value)
     if (m_defaultZoom != value) {
         m_defaultZoom = value;
         m_settings.setValue("General/DefaultZoom", value);
-        m_settings.sync();
+        flush();
         emit defaultZoomChanged();
     }
 }
@@ -56,18 +88,120 @@ void Settings::setDefaultViewMode(int value)
     if (m_defaultViewMode != value) {
         m_defaultViewMode = value;
         m_settings.setValue("General/DefaultViewMode", value);
-        m_settings.sync();
+        flush();
         emit defaultViewModeChanged();
     }
 }
 
+void Settings::setRenderMode(int value)
+{
+    if (m_renderMode != value) {
+        m_renderMode = value;
+        m_settings.setValue("General/RenderMode", value);
+        flush();
+        emit renderModeChanged();
+    }
+}
+
+void Settings::setNightMode(bool value)
+{
+    if (m_nightMode != value) {
+        m_nightMode = value;
+        m_settings.setValue("General/NightMode", value);
+        flush();
+        emit nightModeChanged();
+    }
+}
+
+void Settings::setContrastBoost(int value)
+{
+    if (m_contrastBoost != value) {
+        m_contrastBoost = value;
+        m_settings.setValue("General/ContrastBoost", value);
+        flush();
+        emit contrastBoostChanged();
+    }
+}
+
+void Settings::setTrimMargins(bool value)
+{
+    if (m_trimMargins != value) {
+        m_trimMargins = value;
+        m_settings.setValue("General/TrimMargins", value);
+        flush();
+        emit trimMarginsChanged();
+    }
+}
+
+void Settings::setAutoTuneRendering(bool value)
+{
+    if (m_autoTuneRendering != value) {
+        m_autoTuneRendering = value;
+        m_settings.setValue("General/AutoTuneRendering", value);
+        flush();
+        emit autoTuneRenderingChanged();
+    }
+}
+
+// Session setters
+void Settings::setLastDocument(const QString &path)
+{
+    if (m_lastDocument != path) {
+        m_lastDocument = path;
+        m_settings.setValue("Session/Document", path);
+        flush();
+        emit lastDocumentChanged();
+    }
+}
+
+void Settings::setLastPage(int value)
+{
+    if (m_lastPage != value) {
+        m_lastPage = value;
+        m_settings.setValue("Session/Page", value);
+        flush();
+        emit lastPageChanged();
+    }
+}
+
+void Settings::setLastZoom(int value)
+{
+    if (m_lastZoom != value) {
+        m_lastZoom = value;
+        m_settings.setValue("Session/Zoom", value);
+        flush();
+        emit lastZoomChanged();
+    }
+}
+
+void Settings::setLastViewMode(int value)
+{
+    if (m_lastViewMode != value) {
+        m_lastViewMode = value;
+        m_settings.setValue("Session/ViewMode", value);
+        flush();
+        emit lastViewModeChanged();
+    }
+}
+
+// Library setters
+void Settings::setLibraryFolders(const QStringList &folders)
+{
+    if (m_libraryFolders != folders) {
+        m_libraryFolders = folders;
+        m_settings.setValue("Library/Folders", folders);
+        flush();
+        emit libraryFoldersChanged();
+    }
+}
+
 // MIDI setters
 void Settings::setMidiChannel(int value)
 {
     if (m_midiChannel != value) {
         m_midiChannel = value;
         m_settings.setValue("MIDI/Channel", value);
-        m_settings.sync();
+        flush();
         emit midiChannelChanged();
     }
 }
@@ -77,7 +211,7 @@ void Settings::setNextPageControl(int value)
     if (m_nextPageControl != value) {
         m_nextPageControl = value;
         m_settings.setValue("MIDI/NextPageControl", value);
-        m_settings.sync();
+        flush();
         emit nextPageControlChanged();
     }
 }
@@ -87,7 +221,7 @@ void Settings::setPrevPageControl(int value)
     if (m_prevPageControl != value) {
         m_prevPageControl = value;
         m_settings.setValue("MIDI/PrevPageControl", value);
-        m_settings.sync();
+        flush();
         emit prevPageControlChanged();
     }
 }
@@ -97,11 +231,73 @@ void Settings::setMidiDevice(const QString &device)
     if (m_midiDevice != device) {
         m_midiDevice = device;
         m_settings.setValue("MIDI/Device", device);
-        m_settings.sync();
+        flush();
         emit midiDeviceChanged();
     }
 }
 
+// Auto-scroll setters
+void Settings::setAutoScrollEnabled(bool value)
+{
+    if (m_autoScrollEnabled != value) {
+        m_autoScrollEnabled = value;
+        m_settings.setValue("AutoScroll/Enabled", value);
+        flush();
+        emit autoScrollEnabledChanged();
+    }
+}
+
+void Settings::setBarsPerPage(int value)
+{
+    if (m_barsPerPage != value) {
+        m_barsPerPage = value;
+        m_settings.setValue("AutoScroll/BarsPerPage", value);
+        flush();
+        emit barsPerPageChanged();
+    }
+}
+
+void Settings::setBeatsPerBar(int value)
+{
+    if (m_beatsPerBar != value) {
+        m_beatsPerBar = value;
+        m_settings.setValue("AutoScroll/BeatsPerBar", value);
+        flush();
+        emit beatsPerBarChanged();
+    }
+}
+
+// Expression pedal setters
+void Settings::setExpressionMode(int value)
+{
+    if (m_expressionMode != value) {
+        m_expressionMode = value;
+        m_settings.setValue("Expression/Mode", value);
+        flush();
+        emit expressionModeChanged();
+    }
+}
+
+void Settings::setExpressionControl(int value)
+{
+    if (m_expressionControl != value) {
+        m_expressionControl = value;
+        m_settings.setValue("Expression/Control", value);
+        flush();
+        emit expressionControlChanged();
+    }
+}
+
+void Settings::setExpressionSpeed(int value)
+{
+    if (m_expressionSpeed != value) {
+        m_expressionSpeed = value;
+        m_settings.setValue("Expression/Speed", value);
+        flush();
+        emit expressionSpeedChanged();
+    }
+}
+
 // void Settings::save()
 // {
 //     // General settings
@@ -124,12 +320,36 @@ void Settings::load()
     m_autoOpenLast = m_settings.value("General/AutoOpenLast", DEFAULT_AUTO_OPEN_LAST).toBool();
     m_defaultZoom = m_settings.value("General/DefaultZoom", DEFAULT_ZOOM).toInt();
     m_defaultViewMode = m_settings.value("General/DefaultViewMode", DEFAULT_VIEW_MODE).toInt();
+    m_renderMode = m_settings.value("General/RenderMode", DEFAULT_RENDER_MODE).toInt();
+    m_nightMode = m_settings.value("General/NightMode", DEFAULT_NIGHT_MODE).toBool();
+    m_contrastBoost = m_settings.value("General/ContrastBoost", DEFAULT_CONTRAST_BOOST).toInt();
+    m_trimMargins = m_settings.value("General/TrimMargins", DEFAULT_TRIM_MARGINS).toBool();
+    m_autoTuneRendering = m_settings.value("General/AutoTuneRendering", DEFAULT_AUTO_TUNE_RENDERING).toBool();
+
+    // Session
+    m_lastDocument = m_settings.value("Session/Document", "").toString();
+    m_lastPage = m_settings.value("Session/Page", 0).toInt();
+    m_lastZoom = m_settings.value("Session/Zoom", DEFAULT_ZOOM).toInt();
+    m_lastViewMode = m_settings.value("Session/ViewMode", DEFAULT_VIEW_MODE).toInt();
+
+    // Library
+    m_libraryFolders = m_settings.value("Library/Folders").toStringList();
 
     // MIDI settings
     m_midiChannel = m_settings.value("MIDI/Channel", DEFAULT_MIDI_CHANNEL).toInt();
     m_nextPageControl = m_settings.value("MIDI/NextPageControl", DEFAULT_NEXT_PAGE_CONTROL).toInt();
     m_prevPageControl = m_settings.value("MIDI/PrevPageControl", DEFAULT_PREV_PAGE_CONTROL).toInt();
     m_midiDevice = m_settings.value("MIDI/Device", "").toString();
+
+    // Auto-scroll settings
+    m_autoScrollEnabled = m_settings.value("AutoScroll/Enabled", DEFAULT_AUTO_SCROLL_ENABLED).toBool();
+    m_barsPerPage = m_settings.value("AutoScroll/BarsPerPage", DEFAULT_BARS_PER_PAGE).toInt();
+    m_beatsPerBar = m_settings.value("AutoScroll/BeatsPerBar", DEFAULT_BEATS_PER_BAR).toInt();
+
+    // Expression pedal settings
+    m_expressionMode = m_settings.value("Expression/Mode", DEFAULT_EXPRESSION_MODE).toInt();
+    m_expressionControl = m_settings.value("Expression/Control", DEFAULT_EXPRESSION_CONTROL).toInt();
+    m_expressionSpeed = m_settings.value("Expression/Speed", DEFAULT_EXPRESSION_SPEED).toInt();
 }
 
 void Settings::resetToDefaults()
@@ -138,10 +358,34 @@ void Settings::resetToDefaults()
     setAutoOpenLast(DEFAULT_AUTO_OPEN_LAST);
     setDefaultZoom(DEFAULT_ZOOM);
     setDefaultViewMode(DEFAULT_VIEW_MODE);
+    setRenderMode(DEFAULT_RENDER_MODE);
+    setNightMode(DEFAULT_NIGHT_MODE);
+    setContrastBoost(DEFAULT_CONTRAST_BOOST);
+    setTrimMargins(DEFAULT_TRIM_MARGINS);
+    setAutoTuneRendering(DEFAULT_AUTO_TUNE_RENDERING);
+
+    // Session
+    setLastDocument("");
+    setLastPage(0);
+    setLastZoom(DEFAULT_ZOOM);
+    setLastViewMode(DEFAULT_VIEW_MODE);
+
+    // Library
+    setLibraryFolders({});
 
     // MIDI settings
     setMidiChannel(DEFAULT_MIDI_CHANNEL);
     setNextPageControl(DEFAULT_NEXT_PAGE_CONTROL);
     setPrevPageControl(DEFAULT_PREV_PAGE_CONTROL);
     setMidiDevice("");
+
+    // Auto-scroll settings
+    setAutoScrollEnabled(DEFAULT_AUTO_SCROLL_ENABLED);
+    setBarsPerPage(DEFAULT_BARS_PER_PAGE);
+    setBeatsPerBar(DEFAULT_BEATS_PER_BAR);
+
+    // Expression pedal settings
+    setExpressionMode(DEFAULT_EXPRESSION_MODE);
+    setExpressionControl(DEFAULT_EXPRESSION_CONTROL);
+    setExpressionSpeed(DEFAULT_EXPRESSION_SPEED);
 }
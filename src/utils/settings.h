@@ -15,6 +15,20 @@ class Settings : public QObject
     Q_PROPERTY(bool autoOpenLast READ autoOpenLast WRITE setAutoOpenLast NOTIFY autoOpenLastChanged)
     Q_PROPERTY(int defaultZoom READ defaultZoom WRITE setDefaultZoom NOTIFY defaultZoomChanged)
     Q_PROPERTY(int defaultViewMode READ defaultViewMode WRITE setDefaultViewMode NOTIFY defaultViewModeChanged)
+    Q_PROPERTY(int renderMode READ renderMode WRITE setRenderMode NOTIFY renderModeChanged)
+    Q_PROPERTY(bool nightMode READ nightMode WRITE setNightMode NOTIFY nightModeChanged)
+    Q_PROPERTY(int contrastBoost READ contrastBoost WRITE setContrastBoost NOTIFY contrastBoostChanged)
+    Q_PROPERTY(bool trimMargins READ trimMargins WRITE setTrimMargins NOTIFY trimMarginsChanged)
+    Q_PROPERTY(bool autoTuneRendering READ autoTuneRendering WRITE setAutoTuneRendering NOTIFY autoTuneRenderingChanged)
+
+    // Last session, restored on launch when autoOpenLast is set
+    Q_PROPERTY(QString lastDocument READ lastDocument WRITE setLastDocument NOTIFY lastDocumentChanged)
+    Q_PROPERTY(int lastPage READ lastPage WRITE setLastPage NOTIFY lastPageChanged)
+    Q_PROPERTY(int lastZoom READ lastZoom WRITE setLastZoom NOTIFY lastZoomChanged)
+    Q_PROPERTY(int lastViewMode READ lastViewMode WRITE setLastViewMode NOTIFY lastViewModeChanged)
+
+    // Library: folders scanned for PDFs
+    Q_PROPERTY(QStringList libraryFolders READ libraryFolders WRITE setLibraryFolders NOTIFY libraryFoldersChanged)
 
     // MIDI Settings
     Q_PROPERTY(int midiChannel READ midiChannel WRITE setMidiChannel NOTIFY midiChannelChanged)
@@ -22,6 +36,16 @@ class Settings : public QObject
     Q_PROPERTY(int prevPageControl READ prevPageControl WRITE setPrevPageControl NOTIFY prevPageControlChanged)
     Q_PROPERTY(QString midiDevice READ midiDevice WRITE setMidiDevice NOTIFY midiDeviceChanged)
 
+    // Auto-scroll Settings
+    Q_PROPERTY(bool autoScrollEnabled READ autoScrollEnabled WRITE setAutoScrollEnabled NOTIFY autoScrollEnabledChanged)
+    Q_PROPERTY(int barsPerPage READ barsPerPage WRITE setBarsPerPage NOTIFY barsPerPageChanged)
+    Q_PROPERTY(int beatsPerBar READ beatsPerBar WRITE setBeatsPerBar NOTIFY beatsPerBarChanged)
+
+    // Expression pedal Settings
+    Q_PROPERTY(int expressionMode READ expressionMode WRITE setExpressionMode NOTIFY expressionModeChanged)
+    Q_PROPERTY(int expressionControl READ expressionControl WRITE setExpressionControl NOTIFY expressionControlChanged)
+    Q_PROPERTY(int expressionSpeed READ expressionSpeed WRITE setExpressionSpeed NOTIFY expressionSpeedChanged)
+
 public:
     explicit Settings(QObject *parent = nullptr);
     ~Settings();
@@ -30,6 +54,20 @@ public:
     bool autoOpenLast() const;
     int defaultZoom() const;
     int defaultViewMode() const;
+    int renderMode() const;
+    bool nightMode() const;
+    int contrastBoost() const;
+    bool trimMargins() const;
+    bool autoTuneRendering() const;
+
+    // Session getters
+    QString lastDocument() const;
+    int lastPage() const;
+    int lastZoom() const;
+    int lastViewMode() const;
+
+    // Library getters
+    QStringList libraryFolders() const;
 
     // MIDI getters
     int midiChannel() const;
@@ -37,10 +75,34 @@ public:
     int prevPageControl() const;
     QString midiDevice() const;
 
+    // Auto-scroll getters
+    bool autoScrollEnabled() const;
+    int barsPerPage() const;
+    int beatsPerBar() const;
+
+    // Expression pedal getters
+    int expressionMode() const;
+    int expressionControl() const;
+    int expressionSpeed() const;
+
     // General setters
     void setAutoOpenLast(bool value);
     void setDefaultZoom(int value);
     void setDefaultViewMode(int value);
+    void setRenderMode(int value);
+    void setNightMode(bool value);
+    void setContrastBoost(int value);
+    void setTrimMargins(bool value);
+    void setAutoTuneRendering(bool value);
+
+    // Session setters
+    void setLastDocument(const QString &path);
+    void setLastPage(int value);
+    void setLastZoom(int value);
+    void setLastViewMode(int value);
+
+    // Library setters
+    void setLibraryFolders(const QStringList &folders);
 
     // MIDI setters
     void setMidiChannel(int value);
@@ -48,6 +110,16 @@ public:
     void setPrevPageControl(int value);
     void setMidiDevice(const QString &device);
 
+    // Auto-scroll setters
+    void setAutoScrollEnabled(bool value);
+    void setBarsPerPage(int value);
+    void setBeatsPerBar(int value);
+
+    // Expression pedal setters
+    void setExpressionMode(int value);
+    void setExpressionControl(int value);
+    void setExpressionSpeed(int value);
+
     // Load/Save methods
     Q_INVOKABLE void load();
     Q_INVOKABLE void resetToDefaults();
@@ -57,6 +129,20 @@ signals:
     void autoOpenLastChanged();
     void defaultZoomChanged();
     void defaultViewModeChanged();
+    void renderModeChanged();
+    void nightModeChanged();
+    void contrastBoostChanged();
+    void trimMarginsChanged();
+    void autoTuneRenderingChanged();
+
+    // Session signals
+    void lastDocumentChanged();
+    void lastPageChanged();
+    void lastZoomChanged();
+    void lastViewModeChanged();
+
+    // Library signals
+    void libraryFoldersChanged();
 
     // MIDI signals
     void midiChannelChanged();
@@ -64,13 +150,40 @@ signals:
     void prevPageControlChanged();
     void midiDeviceChanged();
 
+    // Auto-scroll signals
+    void autoScrollEnabledChanged();
+    void barsPerPageChanged();
+    void beatsPerBarChanged();
+
+    // Expression pedal signals
+    void expressionModeChanged();
+    void expressionControlChanged();
+    void expressionSpeedChanged();
+
 private:
+    // Writes the file, counted in the settings.flushes metric
+    void flush();
+
     QSettings m_settings;
 
     // General settings
     bool m_autoOpenLast;
     int m_defaultZoom;
     int m_defaultViewMode;
+    int m_renderMode;
+    bool m_nightMode;
+    int m_contrastBoost;
+    bool m_trimMargins;
+    bool m_autoTuneRendering;
+
+    // Session
+    QString m_lastDocument;
+    int m_lastPage;
+    int m_lastZoom;
+    int m_lastViewMode;
+
+    // Library
+    QStringList m_libraryFolders;
 
     // MIDI settings
     int m_midiChannel;
@@ -78,13 +191,34 @@ private:
     int m_prevPageControl;
     QString m_midiDevice;
 
+    // Auto-scroll settings
+    bool m_autoScrollEnabled;
+    int m_barsPerPage;
+    int m_beatsPerBar;
+
+    // Expression pedal settings
+    int m_expressionMode;
+    int m_expressionControl;
+    int m_expressionSpeed;
+
     // Constants for default values
     static const bool DEFAULT_AUTO_OPEN_LAST = false;
     static const int DEFAULT_ZOOM = 100;
     static const int DEFAULT_VIEW_MODE = 0;
+    static const int DEFAULT_RENDER_MODE = 0;  // 0: Color, 1: Grayscale, 2: Black & White
+    static const bool DEFAULT_NIGHT_MODE = false;
+    static const int DEFAULT_CONTRAST_BOOST = 0; // 0 (off) to 100
+    static const bool DEFAULT_TRIM_MARGINS = false;
+    static const bool DEFAULT_AUTO_TUNE_RENDERING = false;
     static const int DEFAULT_MIDI_CHANNEL = 1;
     static const int DEFAULT_NEXT_PAGE_CONTROL = 64;
     static const int DEFAULT_PREV_PAGE_CONTROL = 67;
+    static const bool DEFAULT_AUTO_SCROLL_ENABLED = false;
+    static const int DEFAULT_BARS_PER_PAGE = 8;
+    static const int DEFAULT_BEATS_PER_BAR = 4;
+    static const int DEFAULT_EXPRESSION_MODE = 0;     // 0: Off, 1: Position, 2: Velocity
+    static const int DEFAULT_EXPRESSION_CONTROL = 11; // Expression
+    static const int DEFAULT_EXPRESSION_SPEED = 50;   // Percent of the view height per second
 };
 
 #endif // SETTINGS_H
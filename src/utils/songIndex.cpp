@@ -0,0 +1,162 @@
+// songIndex.cpp
+#include "songIndex.h"
+#include <QVariantMap>
+#include <algorithm>
+#include <vector>
+
+static const int EXACT_SCORE = 1000;
+static const int PREFIX_SCORE = 800;
+static const int WORD_PREFIX_SCORE = 600;
+static const int FUZZY_MAX_SCORE = 500;
+
+void SongIndex::build(const QList<OutlineEntry>& outline)
+{
+    build(outline, QList<int>());
+}
+
+void SongIndex::build(const QList<OutlineEntry>& outline, const QList<int>& documents)
+{
+    entries.reserve(outline.size());
+    for (qsizetype i = 0; i < outline.size(); ++i)
+    {
+        const OutlineEntry& item = outline[i];
+        if (item.page < 0 || item.title.trimmed().isEmpty())
+            continue;
+
+        entries.append({item.title.trimmed(), normalize(item.title), item.page,
+                        i < documents.size() ? documents[i] : -1});
+    }
+    ready.store(true, std::memory_order_release);
+}
+
+int SongIndex::size() const
+{
+    return isReady() ? entries.size() : 0;
+}
+
+QString SongIndex::normalize(const QString& text)
+{
+    // Decompose so accents become separate marks that can be dropped
+    const QString decomposed = text.normalized(QString::NormalizationForm_KD);
+
+    QString result;
+    result.reserve(decomposed.size());
+    bool afterSpace = true;
+    for (const QChar c : decomposed)
+    {
+        if (c.isLetterOrNumber())
+        {
+            result.append(c.toLower());
+            afterSpace = false;
+        }
+        else if (c.category() == QChar::Mark_NonSpacing || c == u'\'' || c == u'’')
+        {
+            continue;
+        }
+        else if (!afterSpace)
+        {
+            result.append(u' ');
+            afterSpace = true;
+        }
+    }
+    if (result.endsWith(u' '))
+        result.chop(1);
+    return result;
+}
+
+// Every query word starts a word of the title, in the same order
+static bool matchesWordPrefixes(const QString& title, const QString& query)
+{
+    qsizetype from = 0;
+    for (const auto word : QStringView(query).split(u' ', Qt::SkipEmptyParts))
+    {
+        qsizetype at = title.indexOf(word, from);
+        while (at > 0 && title[at - 1] != u' ')
+            at = title.indexOf(word, at + 1);
+        if (at < 0)
+            return false;
+        from = at + word.size();
+    }
+    return true;
+}
+
+// Query characters found in order, rewarding runs and word starts
+static int fuzzyScore(const QString& title, const QString& query)
+{
+    int result = 0;
+    qsizetype q = 0;
+    qsizetype lastMatch = -1;
+    for (qsizetype i = 0; i < title.size() && q < query.size(); ++i)
+    {
+        if (title[i] != query[q])
+            continue;
+
+        result += 10;
+        if (i == 0 || title[i - 1] == u' ')
+            result += 15;
+        if (lastMatch >= 0)
+            result += i == lastMatch + 1 ? 5 : -qMin<int>(i - lastMatch - 1, 5);
+        lastMatch = i;
+        ++q;
+    }
+    return q == query.size() ? qBound(1, result, FUZZY_MAX_SCORE) : 0;
+}
+
+int SongIndex::score(const Entry& entry, const QString& query)
+{
+    const QString& title = entry.normalized;
+    if (title == query)
+        return EXACT_SCORE;
+    if (title.startsWith(query))
+        return PREFIX_SCORE;
+    if (matchesWordPrefixes(title, query))
+        return WORD_PREFIX_SCORE;
+    return fuzzyScore(title, query);
+}
+
+QVariantList SongIndex::search(const QString& query, int limit) const
+{
+    QVariantList result;
+    const QString normalizedQuery = normalize(query);
+    if (!isReady() || normalizedQuery.isEmpty() || limit <= 0)
+        return result;
+
+    struct Match
+    {
+        int score;
+        int entry;
+    };
+    std::vector<Match> matches;
+    for (int i = 0; i < entries.size(); ++i)
+    {
+        const int s = score(entries[i], normalizedQuery);
+        if (s > 0)
+            matches.push_back({s, i});
+    }
+
+    // Better score first, then shorter titles, then document order
+    const auto better = [this](const Match& a, const Match& b) {
+        if (a.score != b.score)
+            return a.score > b.score;
+        const qsizetype lengthA = entries[a.entry].normalized.size();
+        const qsizetype lengthB = entries[b.entry].normalized.size();
+        if (lengthA != lengthB)
+            return lengthA < lengthB;
+        return a.entry < b.entry;
+    };
+    const auto last = matches.begin() + qMin<qsizetype>(limit, matches.size());
+    std::partial_sort(matches.begin(), last, matches.end(), better);
+
+    for (auto it = matches.begin(); it != last; ++it)
+    {
+        const Entry& entry = entries[it->entry];
+        QVariantMap item;
+        item["title"] = entry.title;
+        item["page"] = entry.page;
+        item["score"] = it->score;
+        if (entry.document >= 0)
+            item["document"] = entry.document;
+        result.append(item);
+    }
+    return result;
+}
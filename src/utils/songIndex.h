@@ -0,0 +1,46 @@
+// songIndex.h
+#ifndef SONGINDEX_H
+#define SONGINDEX_H
+
+#include <QList>
+#include <QString>
+#include <QVariantList>
+#include "documentMetadata.h"
+#include <atomic>
+
+// Titles from the document outline (songs in a fake book) mapped to their
+// pages, searchable as-you-type. Titles are normalized once when the index
+// is built, a query is then matched against each of them in one pass:
+// whole-title prefix, word prefixes and finally in-order fuzzy matching.
+class SongIndex
+{
+public:
+    // Called once, from a background thread
+    void build(const QList<OutlineEntry>& outline);
+    // Titles from several documents: matches of outline[i] also carry
+    // documents[i] as "document"
+    void build(const QList<OutlineEntry>& outline, const QList<int>& documents);
+    bool isReady() const { return ready.load(std::memory_order_acquire); }
+    int size() const;
+
+    // Best matches first, as { title, page, score } maps
+    QVariantList search(const QString& query, int limit) const;
+
+    static QString normalize(const QString& text);
+
+private:
+    struct Entry
+    {
+        QString title;
+        QString normalized;
+        int page = -1;
+        int document = -1;
+    };
+
+    static int score(const Entry& entry, const QString& query);
+
+    QList<Entry> entries;
+    std::atomic_bool ready{false};
+};
+
+#endif // SONGINDEX_H
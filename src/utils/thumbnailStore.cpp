@@ -0,0 +1,406 @@
+// thumbnailStore.cpp
+#include "thumbnailStore.h"
+#include "documentMetadata.h"
+#include "pdfModel.h"
+#include "pageFingerprint.h"
+#include <QDataStream>
+#include <QSaveFile>
+#include <QDir>
+#include <QMutexLocker>
+#include <QPainter>
+#include <QStandardPaths>
+#include <QDebug>
+#include <algorithm>
+
+static const int BUSY_BACKOFF_MS = 50;
+
+// Checked while rendering too, a page can take long enough for the view to
+// need the render thread in the meantime
+bool ThumbnailStore::shouldAbort(const QVariant& closure)
+{
+    const ThumbnailStore* store = static_cast<const ThumbnailStore*>(closure.value<void*>());
+    return store->stopping || (store->scheduler && store->scheduler->isBusy());
+}
+
+ThumbnailStore::ThumbnailStore(const QString& documentPath, const QList<QSizeF>& pageSizes,
+                               std::shared_ptr<RenderScheduler> renderScheduler)
+    : path(documentPath)
+    , sizes(pageSizes)
+    , scheduler(std::move(renderScheduler))
+    , ready(pageSizes.size())
+    , hashes(pageSizes.size())
+{
+    const int atlasCount = (sizes.size() + PAGES_PER_ATLAS - 1) / PAGES_PER_ATLAS;
+    adoptedAtlases.resize(atlasCount);
+    for (int i = 0; i < atlasCount; ++i)
+        atlases.append(emptyAtlas(i));
+}
+
+ThumbnailStore::~ThumbnailStore()
+{
+    stop();
+}
+
+int ThumbnailStore::addProgressListener(std::function<void(int)> listener)
+{
+    QMutexLocker locker(&listenersMutex);
+    listeners.insert(nextListener, std::move(listener));
+    return nextListener++;
+}
+
+void ThumbnailStore::removeProgressListener(int id)
+{
+    QMutexLocker locker(&listenersMutex);
+    listeners.remove(id);
+}
+
+void ThumbnailStore::notifyProgress()
+{
+    const int count = readyCount();
+    QMutexLocker locker(&listenersMutex);
+    for (const auto& listener : std::as_const(listeners))
+        listener(count);
+}
+
+void ThumbnailStore::start()
+{
+    if (generator)
+        return;
+
+    generator.reset(QThread::create([this] { run(); }));
+    generator->start(QThread::IdlePriority);
+}
+
+void ThumbnailStore::stop()
+{
+    stopping = true;
+    if (generator)
+        generator->wait();
+}
+
+QImage ThumbnailStore::thumbnail(int page) const
+{
+    QMutexLocker locker(&mutex);
+    if (page < 0 || page >= sizes.size() || !ready.testBit(page))
+        return QImage();
+
+    return atlases[page / PAGES_PER_ATLAS].copy(thumbnailRect(page));
+}
+
+int ThumbnailStore::readyCount() const
+{
+    QMutexLocker locker(&mutex);
+    return readyPages;
+}
+
+QList<QByteArray> ThumbnailStore::fingerprints() const
+{
+    QMutexLocker locker(&mutex);
+    return hashes;
+}
+
+void ThumbnailStore::setFingerprints(const QList<QByteArray>& pageHashes)
+{
+    if (pageHashes.size() != sizes.size())
+        return;
+
+    {
+        QMutexLocker locker(&mutex);
+        hashes = pageHashes;
+        hashedPages = int(std::count_if(hashes.cbegin(), hashes.cend(),
+                                        [](const QByteArray& hash) { return !hash.isEmpty(); }));
+    }
+    // Possibly before the generator has worked out the directory
+    saveFingerprints(cacheDirectory());
+}
+
+int ThumbnailStore::adoptThumbnails(const ThumbnailStore& previous, const QMultiHash<int, int>& pages)
+{
+    int adopted = 0;
+    for (auto it = pages.cbegin(); it != pages.cend(); ++it)
+    {
+        const QImage image = previous.thumbnail(it.key());
+        const int page = it.value();
+        if (image.isNull() || page < 0 || page >= sizes.size())
+            continue;
+
+        QMutexLocker locker(&mutex);
+        const QRect rect = thumbnailRect(page);
+        if (ready.testBit(page) || image.size() != rect.size())
+            continue;
+        QPainter painter(&atlases[page / PAGES_PER_ATLAS]);
+        painter.drawImage(rect.topLeft(), image);
+        painter.end();
+        ready.setBit(page);
+        ++readyPages;
+        adoptedAtlases.setBit(page / PAGES_PER_ATLAS);
+        ++adopted;
+    }
+    return adopted;
+}
+
+bool ThumbnailStore::isComplete() const
+{
+    QMutexLocker locker(&mutex);
+    return readyPages == sizes.size() && hashedPages == sizes.size();
+}
+
+double ThumbnailStore::thumbnailDpi(const QSizeF& pageSize)
+{
+    if (pageSize.isEmpty())
+        return 72.0;
+
+    return 72.0 * qMin(CELL_WIDTH / pageSize.width(), CELL_HEIGHT / pageSize.height());
+}
+
+QImage ThumbnailStore::emptyAtlas(int atlas) const
+{
+    const int pages = qMin(PAGES_PER_ATLAS, int(sizes.size()) - atlas * PAGES_PER_ATLAS);
+    const int rows = (pages + ATLAS_COLUMNS - 1) / ATLAS_COLUMNS;
+
+    // 16 bits per pixel is plenty for a thumbnail and halves the memory
+    QImage image(ATLAS_COLUMNS * CELL_WIDTH, rows * CELL_HEIGHT, QImage::Format_RGB16);
+    image.fill(Qt::white);
+    return image;
+}
+
+QRect ThumbnailStore::thumbnailRect(int page) const
+{
+    const int cell = page % PAGES_PER_ATLAS;
+    const QPoint cellOrigin((cell % ATLAS_COLUMNS) * CELL_WIDTH, (cell / ATLAS_COLUMNS) * CELL_HEIGHT);
+
+    QSize size = sizes[page].scaled(CELL_WIDTH, CELL_HEIGHT, Qt::KeepAspectRatio).toSize();
+    size = size.expandedTo(QSize(1, 1)).boundedTo(QSize(CELL_WIDTH, CELL_HEIGHT));
+
+    return QRect(cellOrigin + QPoint((CELL_WIDTH - size.width()) / 2, (CELL_HEIGHT - size.height()) / 2),
+                 size);
+}
+
+QString ThumbnailStore::cacheDirectory() const
+{
+    // Keyed by file identity so an edited document gets new thumbnails
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation)
+        + "/thumbnails/" + DocumentMetadata::fileKey(path);
+}
+
+void ThumbnailStore::loadFingerprints()
+{
+    QFile file(QDir(directory).filePath("fingerprints.bin"));
+    if (!file.open(QIODevice::ReadOnly))
+        return;
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_6_5);
+    QList<QByteArray> loaded;
+    in >> loaded;
+    if (in.status() != QDataStream::Ok || loaded.size() != sizes.size())
+        return;
+
+    QMutexLocker locker(&mutex);
+    for (int page = 0; page < loaded.size(); ++page)
+    {
+        // Older versions hashed the page as a whole, without the text part
+        if (hashes[page].isEmpty() && loaded[page].size() == PageFingerprint::SIZE)
+        {
+            hashes[page] = loaded[page];
+            ++hashedPages;
+        }
+    }
+}
+
+void ThumbnailStore::saveFingerprints(const QString& dir) const
+{
+    const QList<QByteArray> pageHashes = fingerprints();
+    QDir().mkpath(dir);
+
+    QSaveFile file(QDir(dir).filePath("fingerprints.bin"));
+    if (!file.open(QIODevice::WriteOnly))
+    {
+        qWarning() << "Can't write page fingerprints to" << dir;
+        return;
+    }
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_6_5);
+    out << pageHashes;
+    file.commit();
+}
+
+void ThumbnailStore::loadAtlases()
+{
+    const QDir dir(directory);
+    if (!dir.exists())
+        return;
+
+    for (int atlas = 0; atlas < atlases.size(); ++atlas)
+    {
+        QImage image(dir.filePath(QString("atlas-%1.png").arg(atlas)));
+        if (image.isNull() || image.size() != atlases[atlas].size())
+            continue;
+
+        QMutexLocker locker(&mutex);
+        atlases[atlas] = image.convertToFormat(QImage::Format_RGB16);
+        const int first = atlas * PAGES_PER_ATLAS;
+        const int last = qMin(first + PAGES_PER_ATLAS, int(sizes.size()));
+        for (int page = first; page < last; ++page)
+        {
+            if (!ready.testBit(page))
+            {
+                ready.setBit(page);
+                ++readyPages;
+            }
+        }
+    }
+
+    DEBUG << "Loaded" << readyPages << "thumbnails from" << dir.path();
+}
+
+void ThumbnailStore::saveAtlas(int atlas) const
+{
+    QImage image;
+    {
+        QMutexLocker locker(&mutex);
+        image = atlases[atlas];
+    }
+
+    QDir().mkpath(directory);
+    if (!image.save(directory + QString("/atlas-%1.png").arg(atlas)))
+        qWarning() << "Failed to save thumbnail atlas" << atlas << "to" << directory;
+}
+
+void ThumbnailStore::saveAdoptedAtlases() const
+{
+    for (int atlas = 0; atlas < atlases.size(); ++atlas)
+    {
+        bool adopted;
+        {
+            QMutexLocker locker(&mutex);
+            adopted = adoptedAtlases.testBit(atlas);
+        }
+        if (adopted)
+            saveAtlas(atlas);
+    }
+}
+
+void ThumbnailStore::run()
+{
+    directory = cacheDirectory();
+    loadAtlases();
+    loadFingerprints();
+    notifyProgress();
+    if (isComplete())
+    {
+        // Every page was unchanged, their thumbnails came from the previous
+        // version and haven't been written for this one yet
+        saveAdoptedAtlases();
+        return;
+    }
+
+    std::unique_ptr<Poppler::Document> document = Poppler::Document::load(path);
+    if (!document || document->isLocked())
+    {
+        qWarning() << "Can't open the document for thumbnails:" << path;
+        return;
+    }
+    document->setRenderHint(Poppler::Document::Antialiasing, true);
+    document->setRenderHint(Poppler::Document::TextAntialiasing, true);
+
+    bool atlasDirty = false;
+    bool fingerprintsDirty = false;
+    for (int page = 0; page < sizes.size() && !stopping; ++page)
+    {
+        const int atlas = page / PAGES_PER_ATLAS;
+        const bool lastOfAtlas = page % PAGES_PER_ATLAS == PAGES_PER_ATLAS - 1
+            || page == sizes.size() - 1;
+        if (page % PAGES_PER_ATLAS == 0)
+        {
+            // Saved once the rest of the atlas is done, a partial atlas on
+            // disk would be taken for a complete one
+            QMutexLocker locker(&mutex);
+            atlasDirty = adoptedAtlases.testBit(atlas);
+        }
+
+        bool done;
+        bool hashed;
+        {
+            QMutexLocker locker(&mutex);
+            done = ready.testBit(page);
+            hashed = !hashes[page].isEmpty();
+        }
+
+        if (!done || !hashed)
+        {
+            // Pages on screen always come first
+            while (!stopping && scheduler && scheduler->isBusy())
+                QThread::msleep(BUSY_BACKOFF_MS);
+            if (stopping)
+                break;
+        }
+
+        std::unique_ptr<Poppler::Page> p(done && hashed ? nullptr : document->page(page));
+        if (!hashed)
+        {
+            const QByteArray hash = PageFingerprint::compute(p.get());
+            if (!hash.isEmpty())
+            {
+                QMutexLocker locker(&mutex);
+                if (hashes[page].isEmpty())
+                {
+                    hashes[page] = hash;
+                    ++hashedPages;
+                }
+                fingerprintsDirty = true;
+            }
+        }
+
+        if (!done)
+        {
+            const double dpi = thumbnailDpi(sizes[page]);
+            QImage image = p ? p->renderToImage(dpi, dpi, -1, -1, -1, -1, Poppler::Page::Rotate0,
+                                                nullptr, nullptr, &ThumbnailStore::shouldAbort,
+                                                QVariant::fromValue(static_cast<void*>(this)))
+                             : QImage();
+            if (stopping)
+                break;
+            if (p && image.isNull() && scheduler && scheduler->isBusy())
+            {
+                // Aborted for the pages on screen, this page again once
+                // they are done. A render that finished is kept even if
+                // they came in meanwhile.
+                --page;
+                continue;
+            }
+
+            if (image.isNull())
+            {
+                qWarning() << "Failed to render thumbnail of page" << page + 1;
+            }
+            else
+            {
+                const QRect rect = thumbnailRect(page);
+                image = image.scaled(rect.size(), Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+
+                QMutexLocker locker(&mutex);
+                QPainter painter(&atlases[atlas]);
+                painter.drawImage(rect.topLeft(), image);
+                painter.end();
+                ready.setBit(page);
+                ++readyPages;
+                atlasDirty = true;
+            }
+        }
+
+        if (lastOfAtlas && atlasDirty)
+        {
+            saveAtlas(atlas);
+            atlasDirty = false;
+            notifyProgress();
+        }
+        if (lastOfAtlas && fingerprintsDirty)
+        {
+            saveFingerprints(directory);
+            fingerprintsDirty = false;
+        }
+    }
+
+    DEBUG << "Thumbnails ready:" << readyCount() << "of" << sizes.size();
+}
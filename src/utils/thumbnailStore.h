@@ -0,0 +1,95 @@
+// thumbnailStore.h
+#ifndef THUMBNAILSTORE_H
+#define THUMBNAILSTORE_H
+
+#include <QBitArray>
+#include <QHash>
+#include <QImage>
+#include <QList>
+#include <QMutex>
+#include <QSizeF>
+#include <QString>
+#include <QThread>
+#include <poppler-qt6.h>
+#include "renderScheduler.h"
+#include <atomic>
+#include <functional>
+#include <memory>
+
+// Very low resolution page thumbnails, generated on an idle-priority thread
+// from a document instance of its own so it never competes with the render
+// scheduler for Poppler. Thumbnails are packed into atlases of
+// PAGES_PER_ATLAS pages and saved next to the other cached data of the
+// document, so reopening it doesn't regenerate them.
+//
+// The same pass computes a content fingerprint of every page (see
+// PageFingerprint), which tells a reload which cached renders still hold.
+class ThumbnailStore
+{
+public:
+    ThumbnailStore(const QString& documentPath, const QList<QSizeF>& pageSizes,
+                   std::shared_ptr<RenderScheduler> renderScheduler);
+    ~ThumbnailStore();
+
+    // Listeners are called from the generator thread with the number of
+    // thumbnails ready; every view showing the document adds one
+    int addProgressListener(std::function<void(int)> listener);
+    void removeProgressListener(int id);
+    void start();
+    void stop();
+
+    // Null until the thumbnail has been generated
+    QImage thumbnail(int page) const;
+    int readyCount() const;
+
+    // One entry per page, empty where not computed yet
+    QList<QByteArray> fingerprints() const;
+    // For fingerprints computed elsewhere, so the generator doesn't repeat them
+    void setFingerprints(const QList<QByteArray>& hashes);
+    // Takes the thumbnails of unchanged pages from the store of the previous
+    // version of the file, pages maps a previous page to its pages here.
+    // Before start(). Returns how many pages got one.
+    int adoptThumbnails(const ThumbnailStore& previous, const QMultiHash<int, int>& pages);
+
+    // Resolution that fits a page of this size in a thumbnail cell
+    static double thumbnailDpi(const QSizeF& pageSize);
+
+    static const int PAGES_PER_ATLAS = 64;
+    static const int ATLAS_COLUMNS = 8;
+    static const int CELL_WIDTH = 80;
+    static const int CELL_HEIGHT = 104;
+
+private:
+    static bool shouldAbort(const QVariant& closure);
+    void run();
+    void notifyProgress();
+    void loadAtlases();
+    void saveAtlas(int atlas) const;
+    void saveAdoptedAtlases() const;
+    void loadFingerprints();
+    void saveFingerprints(const QString& dir) const;
+    bool isComplete() const;
+    QImage emptyAtlas(int atlas) const;
+    QRect thumbnailRect(int page) const;
+    QString cacheDirectory() const;
+
+    QString path;
+    QString directory;
+    QList<QSizeF> sizes;
+    std::shared_ptr<RenderScheduler> scheduler;
+    QMutex listenersMutex;
+    QHash<int, std::function<void(int)>> listeners;
+    int nextListener = 0;
+    std::unique_ptr<QThread> generator;
+    std::atomic_bool stopping{false};
+
+    mutable QMutex mutex;
+    QList<QImage> atlases;
+    QBitArray ready;
+    int readyPages = 0;
+    QBitArray adoptedAtlases; // Holding adopted thumbnails not saved yet
+    QList<QByteArray> hashes;
+    int hashedPages = 0;
+};
+
+#endif // THUMBNAILSTORE_H